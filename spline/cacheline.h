@@ -0,0 +1,82 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef CACHELINE_H_
+#define CACHELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/** The size of the cache lines, the unit of the prefetches and of the padding of the data
+ * that threads write concurrently */
+constexpr int CacheLineSize = 64;
+
+/* CacheLineArray holds n default constructed T at an address aligned to CacheLineSize.
+ * The new of C++14 only aligns to alignof(std::max_align_t), thus an array of a T with
+ * alignas(CacheLineSize) would not start on a cache line. It allocates a cache line more
+ * with new (and throws like it) and starts the elements at the first cache line in it.
+ */
+template <typename T> class CacheLineArray
+{
+public:
+    explicit CacheLineArray(std::size_t n)
+        : fN(n)
+        , fAllocation(new char[n * sizeof(T) + CacheLineSize])
+        , fData(align(fAllocation))
+    {
+        for (std::size_t i = 0; i < fN; ++i) {
+            new (fData + i) T();
+        }
+    }
+    ~CacheLineArray()
+    {
+        for (std::size_t i = 0; i < fN; ++i) {
+            fData[i].~T();
+        }
+        delete[] fAllocation;
+    }
+
+    T &operator[](std::size_t i) { return fData[i]; }
+    const T &operator[](std::size_t i) const { return fData[i]; }
+
+private:
+    /** copy constructor prohibited */
+    CacheLineArray(const CacheLineArray &);
+    /** assignment operator prohibited */
+    CacheLineArray &operator=(const CacheLineArray &);
+
+    /** the first cache line in the allocation, which has a cache line to spare */
+    static T *align(char *allocation)
+    {
+        const std::uintptr_t misalignment =
+            reinterpret_cast<std::uintptr_t>(allocation) % CacheLineSize;
+        return reinterpret_cast<T *>(allocation + CacheLineSize - misalignment);
+    }
+
+    const std::size_t fN;
+    char *const fAllocation;  // new[] of the elements and up to a cache line in front
+    T *const fData;
+};
+
+#endif  // CACHELINE_H_
@@ -21,27 +21,60 @@
 
 }}}*/
 // includes {{{1
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 #include "../tsc.h"
 #include "spline.h"
 #include "spline2.h"
 #include "spline3.h"
+#include "spline4.h"
+#include "spline5.h"
+#include "spline6.h"
+#include "spline7.h"
+#include "spline8.h"
+#include "spline9.h"
+#include "spline3d.h"
+#include "maphandle.h"
+#include "perfcounters.h"
+#include "pointbinning.h"
+#include "splineinterface.h"
+#include "tunedspline.h"
 
-// settings {{{1
-constexpr int NumberOfEvaluations = 10000;
-constexpr int FirstMapSize = 4;
-constexpr int MaxMapSize = 256;
-constexpr int Repetitions = 100;
-constexpr auto StepMultiplier = 1.25;
+// tolerances {{{1
+// evaluating the expanded polynomial of the cell rounds differently than the knot based
+// evaluation, most visible where the edge cells extrapolate
+constexpr float CoefficientsTolerance = 0.0001f;
+// the 16 bit knots are off by up to half a quantization step, the extrapolating edge cells
+// amplify that by the sum of |weights| squared (9 * 9)
+constexpr float Int16Tolerance = 81 * 0.5f / 32767 + 0.00001f;
+constexpr float HalfTolerance = 81 * 0.5f / 2048 + 0.00001f;
+// the derivative weights of the extrapolating edge cells sum up to 24 per axis (instead
+// of 9), i.e. 24 * 9 = 8/3 * 81; times the scale of the axis, see verifyGradient
+constexpr float GradientGain = 8.f / 3;
+// central differences with a step of 1/1000 cell, in units of the cell
+constexpr float DifferencesStep = 0.001f;
+constexpr float DifferencesTolerance = 0.01f;
 
-enum DisabledTests {
-    DisabledTestsBegin = -999999,
-    Horizontal3,
-    DisabledTestsEnd
-};
 enum EnabledTests {
     Scalar,
     Alice,
@@ -51,7 +84,60 @@ enum EnabledTests {
     Float12Interleaved,
     Horizontal1,
     Horizontal2,
+    Horizontal3,
     Autovectorized,
+    Bulk1,
+    Bulk2,
+    Bulk3,
+    Parallel1,
+    Parallel2,
+    Parallel3,
+    CoefficientsLayout,
+    Horizontal4,
+    Float12Tiled,
+    Horizontal5,
+    Int16,
+    HorizontalInt16,
+    Half,
+    HorizontalHalf,
+    Binned1,
+    Binned2,
+    Dispatched,
+    Tuned,
+    Gradient,
+    HorizontalGradient,
+    Packed1,
+    HorizontalPacked1,
+    Packed3,
+    Packed8,
+    HorizontalPacked8,
+    Volume,
+    HorizontalVolume,
+    Volume2,
+    HorizontalVolume2,
+    Bulk1NoPrefetch,
+    Bulk1FarPrefetch,
+    PlanesFloat,
+    HorizontalPlanesFloat,
+    PlanesMixed,
+    HorizontalPlanesMixed,
+    PlanesDouble,
+    HorizontalPlanesDouble,
+    Separate4,
+    HorizontalSeparate4,
+    Group4,
+    HorizontalGroup4,
+    Packed12,
+    HorizontalPacked12,
+    Linear,
+    HorizontalLinear,
+    Quadratic,
+    HorizontalQuadratic,
+    HorizontalLinear2,
+    HorizontalQuadratic2,
+    Fixed2,
+    HorizontalFixed2,
+    HorizontalWide2,
     NBenchmarks
 };
 
@@ -68,10 +154,388 @@ std::string testName(int i)
     case Horizontal2:        return "Horiz.2";
     case Horizontal3:        return "Horiz.3";
     case Autovectorized:     return "Autovec";
+    case Bulk1:              return "Bulk1";
+    case Bulk2:              return "Bulk2";
+    case Bulk3:              return "Bulk3";
+    case Parallel1:          return "Parallel1";
+    case Parallel2:          return "Parallel2";
+    case Parallel3:          return "Parallel3";
+    case CoefficientsLayout: return "Coeff.";
+    case Horizontal4:        return "Horiz.4";
+    case Float12Tiled:       return "F12Tiled";
+    case Horizontal5:        return "Horiz.5";
+    case Int16:              return "Int16";
+    case HorizontalInt16:    return "Horiz.I16";
+    case Half:               return "Half";
+    case HorizontalHalf:     return "Horiz.F16";
+    case Binned1:            return "Binned1";
+    case Binned2:            return "Binned2";
+    case Dispatched:         return "Dispatch";
+    case Tuned:              return "Tuned";
+    case Gradient:           return "Gradient";
+    case HorizontalGradient: return "Horiz.Grad";
+    case Packed1:            return "Packed1";
+    case HorizontalPacked1:  return "Horiz.P1";
+    case Packed3:            return "Packed3";
+    case Packed8:            return "Packed8";
+    case HorizontalPacked8:  return "Horiz.P8";
+    case Volume:             return "Volume";
+    case HorizontalVolume:   return "Horiz.Vol";
+    case Volume2:            return "Volume2";
+    case HorizontalVolume2:  return "Horiz.Vol2";
+    case Bulk1NoPrefetch:    return "Bulk1-D0";
+    case Bulk1FarPrefetch:   return "Bulk1-D16";
+    case PlanesFloat:        return "PlanesF";
+    case HorizontalPlanesFloat:  return "Horiz.PF";
+    case PlanesMixed:        return "PlanesM";
+    case HorizontalPlanesMixed:  return "Horiz.PM";
+    case PlanesDouble:       return "PlanesD";
+    case HorizontalPlanesDouble: return "Horiz.PD";
+    case Separate4:          return "Separ.4";
+    case HorizontalSeparate4: return "Horiz.S4";
+    case Group4:             return "Group4";
+    case HorizontalGroup4:   return "Horiz.G4";
+    case Packed12:           return "Packed12";
+    case HorizontalPacked12: return "Horiz.P12";
+    case Linear:             return "Linear";
+    case HorizontalLinear:   return "Horiz.Lin";
+    case Quadratic:          return "Quadr.";
+    case HorizontalQuadratic: return "Horiz.Quad";
+    case HorizontalLinear2:  return "Horiz.Lin2";
+    case HorizontalQuadratic2: return "Horiz.Quad2";
+    case Fixed2:             return "Fixed2";
+    case HorizontalFixed2:   return "Horiz.Fix2";
+    case HorizontalWide2:    return "Horiz.Wide2";
     default:                 return "<unknown>";
     }
 }
 
+/** The interpolation order of the benchmarks that report the error of their order (see
+ * orderErrors), 0 for the others */
+int testOrder(int i)
+{
+    switch (i) {
+    case Linear:
+    case HorizontalLinear:
+    case HorizontalLinear2:
+        return 1;
+    case Quadratic:
+    case HorizontalQuadratic:
+    case HorizontalQuadratic2:
+        return 2;
+    case Float4:
+    case Horizontal1:
+    case Horizontal2:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+/** true for the benchmarks that evaluate on all workers of the ThreadPool */
+bool testPooled(int i) { return i == Parallel1 || i == Parallel2 || i == Parallel3; }
+
+// search point patterns {{{1
+/* The patterns of the search points, all in coordinates of the maps, i.e. independent of
+ * the map size:
+ *   uniform   uniformly distributed over the grid
+ *   walk      tracks of 100 steps of 0.002 from a random start, with a random curvature,
+ *             ending at the edge of the grid: consecutive points share or neighbor cells
+ *   clusters  16 Gaussian clusters with a sigma of 0.02
+ *   sorted    uniform, in the order of the cells of the finest default map (A major)
+ *   outside   uniform, half of them outside of the grid by up to 0.25, i.e. in the
+ *             extrapolated edge cells
+ * The first two points are the corners of the grid in every pattern but sorted, which
+ * sorts them in.
+ */
+enum class Pattern { Uniform, Walk, Clusters, Sorted, Outside };
+const char *const PatternNames[] = {"uniform", "walk", "clusters", "sorted", "outside"};
+
+std::vector<Point2> makeSearchPoints(Pattern pattern, int n,
+                                     std::default_random_engine &engine)
+{
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    const auto inside = [](const Point2 &p) {
+        return std::abs(p[0]) <= 1.f && std::abs(p[1]) <= 1.f;
+    };
+    std::vector<Point2> points = {{{-1.f, -1.f}}, {{+1.f, +1.f}}};
+    points.reserve(n);
+    switch (pattern) {
+    case Pattern::Uniform:
+    case Pattern::Sorted:
+        while (int(points.size()) < n) {
+            points.push_back({{uniform(engine), uniform(engine)}});
+        }
+        break;
+    case Pattern::Walk: {
+        std::uniform_real_distribution<float> angle(-3.1415927f, 3.1415927f);
+        std::uniform_real_distribution<float> curvature(-0.05f, 0.05f);
+        while (int(points.size()) < n) {
+            Point2 p = {{uniform(engine), uniform(engine)}};
+            float direction = angle(engine);
+            const float turn = curvature(engine);
+            for (int k = 0; k < 100 && inside(p) && int(points.size()) < n; ++k) {
+                points.push_back(p);
+                p[0] += 0.002f * std::cos(direction);
+                p[1] += 0.002f * std::sin(direction);
+                direction += turn;
+            }
+        }
+    } break;
+    case Pattern::Clusters: {
+        std::array<Point2, 16> centers;
+        for (auto &c : centers) {
+            c = {{uniform(engine), uniform(engine)}};
+        }
+        std::uniform_int_distribution<int> cluster(0, centers.size() - 1);
+        std::normal_distribution<float> offset(0.f, 0.02f);
+        while (int(points.size()) < n) {
+            const Point2 &c = centers[cluster(engine)];
+            const Point2 p = {{c[0] + offset(engine), c[1] + offset(engine)}};
+            if (inside(p)) {
+                points.push_back(p);
+            }
+        }
+    } break;
+    case Pattern::Outside: {
+        std::uniform_real_distribution<float> wide(-1.25f, 1.25f);
+        while (int(points.size()) < n) {
+            const Point2 p = {{wide(engine), wide(engine)}};
+            if (!inside(p)) {
+                points.push_back(p);
+            }
+            if (int(points.size()) < n) {
+                points.push_back({{uniform(engine), uniform(engine)}});
+            }
+        }
+    } break;
+    }
+    if (pattern == Pattern::Sorted) {
+        const auto cell = [](const Point2 &p) { return int((p[0] + 1.f) * 128.f); };
+        std::sort(points.begin(), points.end(), [&](const Point2 &x, const Point2 &y) {
+            return cell(x) != cell(y) ? cell(x) < cell(y) : x[1] < y[1];
+        });
+    }
+    points.resize(n);
+    return points;
+}
+
+// Settings {{{1
+/* The settings of a run, the defaults can be changed on the command line (see usage).
+ * The map sizes are the N knots of the A axis, the B axis has aspect times as many.
+ */
+struct Settings
+{
+    int evaluations = 10000;       // N search points
+    int repetitions = 100;         // timed runs per benchmark and map size
+    int firstMapSize = 4;
+    int maxMapSize = 256;
+    double stepMultiplier = 1.25;  // from one map size to the next
+    double aspect = 1;
+    Pattern pattern = Pattern::Uniform;  // of the search points
+    std::vector<bool> tests = std::vector<bool>(NBenchmarks, true);  // the ones to run
+    bool verify = true;            // compare the kernels after the benchmarks
+    bool counters = false;         // count the hardware events of the benchmarks
+    bool latency = false;          // print the percentiles of the samples
+    int batch = 0;                 // evaluations per sample, 0 for one per repetition
+    std::string csvPath;           // machine-readable output, empty for none
+    std::string jsonPath;
+    std::vector<int> threads;      // the thread counts of the thread mode, see runThreads
+    std::vector<int> cpus;         // to pin the threads to, empty for all
+    bool help = false;
+    bool listTests = false;
+
+    int mapSizeB(int mapSize) const
+    {
+        return std::max(4, int(std::lround(mapSize * aspect)));
+    }
+};
+
+void usage(std::ostream &s, const char *name)
+{
+    const Settings d;
+    s << "Usage: " << name << " [options]\n"
+      << "  --evaluations N     search points (" << d.evaluations << ")\n"
+      << "  --repetitions N     timed runs per benchmark (" << d.repetitions << ")\n"
+      << "  --first-map-size N  knots of the A axis of the first map ("
+      << d.firstMapSize << ")\n"
+      << "  --max-map-size N    knots of the A axis of the last map (" << d.maxMapSize
+      << ")\n"
+      << "  --step F            map size factor from one map to the next ("
+      << d.stepMultiplier << ")\n"
+      << "  --aspect F          knots of the B axis per knot of the A axis (" << d.aspect
+      << ")\n"
+      << "  --points PATTERN    the search points: uniform, walk, clusters, sorted or\n"
+      << "                      outside (" << PatternNames[int(d.pattern)] << ")\n"
+      << "  --tests A,B,...     run only these benchmarks, see --list-tests\n"
+      << "  --list-tests        print the names of the benchmarks\n"
+      << "  --no-verify         skip the verification of the kernels\n"
+      << "  --latency           print the percentiles of the cycles per evaluation\n"
+      << "  --batch N           time batches of N evaluations instead of repetitions,\n"
+      << "                      for the percentiles of the single evaluations ("
+      << d.batch << ")\n"
+      << "  --counters          count the instructions, cycles, L1D, LLC and dTLB\n"
+      << "                      misses per evaluation (Linux perf_event_open)\n"
+      << "  --csv FILE          write the results to FILE as CSV\n"
+      << "  --json FILE         write the results to FILE as JSON\n"
+      << "  --threads N,M,...   instead of the benchmarks, the throughput of all\n"
+      << "                      layouts with N, M, ... threads on one map\n"
+      << "  --cpus A-B,C,...    pin the threads to these CPUs, in this order (all)\n";
+}
+
+/** Parse the number in arg, false if it is none or does not fit T */
+template <typename T> bool parseNumber(const std::string &arg, T &value)
+{
+    const char *begin = arg.c_str();
+    char *end = nullptr;
+    const double x = std::strtod(begin, &end);
+    if (end == begin || *end != '\0' || !(std::abs(x) <= std::numeric_limits<T>::max()) ||
+        T(x) != x) {
+        return false;
+    }
+    value = T(x);
+    return true;
+}
+
+/** Parse a list of numbers and ranges, e.g. 0-3,8, false if it is empty or invalid */
+bool parseList(const std::string &arg, std::vector<int> &values)
+{
+    values.clear();
+    std::istringstream list(arg);
+    for (std::string item; std::getline(list, item, ',');) {
+        const auto dash = item.find('-', 1);
+        int first = 0;
+        int last = 0;
+        const std::string lastItem =
+            dash == std::string::npos ? item : item.substr(dash + 1);
+        if (!parseNumber(item.substr(0, dash), first) || !parseNumber(lastItem, last) ||
+            last < first) {
+            return false;
+        }
+        for (int v = first; v <= last; ++v) {
+            values.push_back(v);
+        }
+    }
+    return !values.empty();
+}
+
+/** Parse the options of options --name value or --name=value, false on an unknown
+ * option or an invalid value */
+bool parseSettings(int argc, char **argv, Settings &settings)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (std::size_t k = 0; k < args.size(); ++k) {
+        std::string name = args[k];
+        std::string value;
+        const auto eq = name.find('=');
+        const bool inlineValue = eq != std::string::npos;
+        if (inlineValue) {
+            value = name.substr(eq + 1);
+            name.resize(eq);
+        }
+        const auto next = [&]() {
+            if (!inlineValue) {
+                if (k + 1 == args.size()) {
+                    return false;
+                }
+                value = args[++k];
+            }
+            return true;
+        };
+        bool ok = true;
+        if (name == "--help" || name == "-h") {
+            settings.help = true;
+        } else if (name == "--list-tests") {
+            settings.listTests = true;
+        } else if (name == "--no-verify") {
+            settings.verify = false;
+        } else if (name == "--counters") {
+            settings.counters = true;
+        } else if (name == "--latency") {
+            settings.latency = true;
+        } else if (name == "--batch") {
+            ok = next() && parseNumber(value, settings.batch);
+        } else if (name == "--evaluations") {
+            ok = next() && parseNumber(value, settings.evaluations);
+        } else if (name == "--repetitions") {
+            ok = next() && parseNumber(value, settings.repetitions);
+        } else if (name == "--first-map-size") {
+            ok = next() && parseNumber(value, settings.firstMapSize);
+        } else if (name == "--max-map-size") {
+            ok = next() && parseNumber(value, settings.maxMapSize);
+        } else if (name == "--step") {
+            ok = next() && parseNumber(value, settings.stepMultiplier);
+        } else if (name == "--aspect") {
+            ok = next() && parseNumber(value, settings.aspect);
+        } else if (name == "--points") {
+            ok = next();
+            const auto pattern = std::find(std::begin(PatternNames),
+                                           std::end(PatternNames), value);
+            ok = ok && pattern != std::end(PatternNames);
+            settings.pattern = Pattern(pattern - std::begin(PatternNames));
+        } else if (name == "--csv") {
+            ok = next() && !value.empty();
+            settings.csvPath = value;
+        } else if (name == "--json") {
+            ok = next() && !value.empty();
+            settings.jsonPath = value;
+        } else if (name == "--threads") {
+            ok = next() && parseList(value, settings.threads) &&
+                 *std::min_element(settings.threads.begin(), settings.threads.end()) > 0;
+        } else if (name == "--cpus") {
+            ok = next() && parseList(value, settings.cpus) &&
+                 *std::min_element(settings.cpus.begin(), settings.cpus.end()) >= 0;
+        } else if (name == "--tests") {
+            ok = next();
+            std::fill(settings.tests.begin(), settings.tests.end(), false);
+            std::istringstream list(value);
+            for (std::string test; ok && std::getline(list, test, ',');) {
+                int i = 0;
+                while (i < NBenchmarks && testName(i) != test) {
+                    ++i;
+                }
+                ok = i < NBenchmarks;
+                if (ok) {
+                    settings.tests[i] = true;
+                } else {
+                    std::cerr << "unknown benchmark " << test << '\n';
+                }
+            }
+        } else {
+            std::cerr << "unknown option " << name << '\n';
+            return false;
+        }
+        if (!ok) {
+            std::cerr << "invalid value for " << name << '\n';
+            return false;
+        }
+    }
+    // the first two search points are the corners, the maps have at least 4 knots
+    if (settings.evaluations < 2 || settings.repetitions < 1 ||
+        settings.firstMapSize < 4 || settings.maxMapSize < settings.firstMapSize ||
+        !(settings.stepMultiplier > 1) || !(settings.aspect > 0) || settings.batch < 0) {
+        std::cerr << "settings out of range\n";
+        return false;
+    }
+    return true;
+}
+
+// SplineLayout tolerances {{{1
+const SplineLayout AllLayouts[] = {SplineLayout::AoS4,  SplineLayout::SoA,
+                                   SplineLayout::AoS3,  SplineLayout::Coefficients,
+                                   SplineLayout::Morton, SplineLayout::Int16,
+                                   SplineLayout::Half};
+
+float layoutTolerance(SplineLayout l)
+{
+    switch (l) {
+    case SplineLayout::Coefficients: return CoefficientsTolerance;
+    case SplineLayout::Int16:        return Int16Tolerance;
+    case SplineLayout::Half:         return HalfTolerance;
+    default:                         return 0.00001f;
+    }
+}
+
 // EnabledTests::operator++ {{{1
 EnabledTests &operator++(EnabledTests &x)
 {
@@ -99,6 +563,43 @@ std::ostream &operator<<(std::ostream &s, const Point3V &xyz)
     return s << '[' << xyz[0] << ", " << xyz[1] << ", " << xyz[2] << ']';
 }
 
+// verifyFill {{{1
+/** Fill one map with the scalar and two with the (parallel) vector Fill and compare */
+template <typename Layout>
+bool verifyFill(const char *name, int mapSize, const std::vector<Point2> &points,
+                ThreadPool &pool, float tolerance = 0.00001f)
+{
+    // a non-square grid
+    Spline<Layout> scalar(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize + 5);
+    Spline<Layout> vector(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize + 5);
+    Spline<Layout> parallel(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize + 5);
+    scalar.Fill([](float a, float b) {
+        return std::array<float, 3>{{a * b, a * a - b, 0.5f * a + b * b * b}};
+    });
+    const auto field = [](const Point2V &ab) {
+        Point3V xyz;
+        xyz[0] = ab[0] * ab[1];
+        xyz[1] = ab[0] * ab[0] - ab[1];
+        xyz[2] = 0.5f * ab[0] + ab[1] * ab[1] * ab[1];
+        return xyz;
+    };
+    vector.Fill(field);
+    parallel.Fill(field, pool);
+    for (const auto &p : points) {
+        const auto &ps = scalar.GetValue(p);
+        const auto &pv = vector.GetValue(p);
+        const auto &pp = parallel.GetValue(p);
+        for (int i = 0; i < 3; ++i) {
+            if (std::abs(ps[i] - pv[i]) > tolerance || std::abs(ps[i] - pp[i]) > tolerance) {
+                std::cout << '\n' << name << " vector Fill not equal at " << p << ": " << ps
+                          << " vs. " << pv << " / " << pp;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 // VectorizeBuffer {{{1
 template <typename Input> struct VectorizeBuffer
 {
@@ -113,343 +614,2479 @@ template <typename Input> struct VectorizeBuffer
     }
 };
 
-// TestInfo {{{1
-struct TestInfo
-{
-    bool enabled = false;
-    int id = -1;
-    TestInfo(EnabledTests t) : enabled(true), id(t) {}
-    TestInfo(EnabledTests t, EnabledTests) : enabled(true), id(t) {}
-    TestInfo(EnabledTests t, EnabledTests, EnabledTests) : enabled(true), id(t) {}
-    TestInfo(EnabledTests t, EnabledTests, DisabledTests) : enabled(true), id(t) {}
-    TestInfo(EnabledTests t, DisabledTests) : enabled(true), id(t) {}
-    TestInfo(EnabledTests t, DisabledTests, EnabledTests) : enabled(true), id(t) {}
-    TestInfo(EnabledTests t, DisabledTests, DisabledTests) : enabled(true), id(t) {}
-
-    TestInfo(DisabledTests) : enabled(false) {}
-    TestInfo(DisabledTests, EnabledTests t) : enabled(true), id(t) {}
-    TestInfo(DisabledTests, DisabledTests) : enabled(false) {}
-    TestInfo(DisabledTests, EnabledTests t, EnabledTests) : enabled(true), id(t) {}
-    TestInfo(DisabledTests, DisabledTests, EnabledTests t) : enabled(true), id(t) {}
-    TestInfo(DisabledTests, DisabledTests, DisabledTests) : enabled(false) {}
-
-    TestInfo(DisabledTests, EnabledTests t, DisabledTests) : enabled(true), id(t) {}
-
-    operator bool() const { return enabled; }
-    operator int() const { return id; }
-    operator long() const { return id; }
-    operator long long() const { return id; }
-};
-// Runner Lambda {{{1
-struct Runner
+// verifyGradient {{{1
+/** Check the gradient of the AoS4 map against central differences of its values */
+bool verifyDifferences(const Spline<AoS4> &spline, const std::vector<Point2> &points,
+                       float scale)
 {
-    // data members{{{2
-    TimeStampCounter tsc;
-    double mean[NBenchmarks] = {};
-    double stddev[NBenchmarks] = {};
-    const std::vector<Point2> &searchPoints;
-
-    // Runner::Runner{{{2
-    Runner(const std::vector<Point2> &p) : searchPoints(p) {}
-
-    void recordTsc(int Test, double norm)  //{{{2
-    {
-        const double x = tsc.cycles() / norm;
-        mean[Test] += x;
-        stddev[Test] += x * x;
-    }
-    template <typename I, typename J> void printRatio(I i, J j)  //{{{2
-    {
-        if (TestInfo(i) && TestInfo(j)) {
-            const auto ratio = mean[i] / mean[j];
-            std::cout << std::setprecision(3) << std::setw(9) << ratio;
-            std::cout << std::setprecision(3) << std::setw(9)
-                      << ratio * std::sqrt(stddev[i] * stddev[i] / (mean[i] * mean[i]) +
-                                           stddev[j] * stddev[j] / (mean[j] * mean[j]));
+    const float h = DifferencesStep / scale;
+    // relative to the gradient: the rounding of the values grows with them
+    const auto differs = [scale](float diff, float d) {
+        return std::abs(diff - d) > DifferencesTolerance * (scale + std::abs(d));
+    };
+    for (const auto &p : points) {
+        Point3 xyz, dA, dB;
+        std::tie(xyz, dA, dB) = spline.GetValueAndGradient(p);
+        const auto &a0 = spline.GetValue({{p[0] - h, p[1]}});
+        const auto &a1 = spline.GetValue({{p[0] + h, p[1]}});
+        const auto &b0 = spline.GetValue({{p[0], p[1] - h}});
+        const auto &b1 = spline.GetValue({{p[0], p[1] + h}});
+        for (int i = 0; i < 3; ++i) {
+            const float diffA = (a1[i] - a0[i]) / (2 * h);
+            const float diffB = (b1[i] - b0[i]) / (2 * h);
+            if (differs(diffA, dA[i]) || differs(diffB, dB[i])) {
+                std::cout << "\nGradient not equal to the differences at " << p << ": "
+                          << dA << ", " << dB;
+                return false;
+            }
         }
     }
-    // benchmarkSearch{{{2
-    template <typename F> void benchmark(const TestInfo Test, F &&fun, double err = 20)
-    {
-        do {
-            mean[Test] = 0;
-            stddev[Test] = 0;
-
-            for (const auto &p : searchPoints) {
-                fun(p);
-            }  // one cache warm-up run to remove one outlier
-            for (auto rep = Repetitions; rep; --rep) {
-                tsc.start();
-                for (const auto &p : searchPoints) {
-                    fun(p);
+    return true;
+}
+
+/** Compare value and gradient of the scalar and the vector kernel with the reference,
+ * the gradients with a tolerance of tolerance * GradientGain * scale */
+template <typename Map>
+bool verifyGradient(const std::string &name, const Spline<AoS4> &reference,
+                    const Map &map, const std::vector<Point2> &points, float scale,
+                    float tolerance)
+{
+    const float gradientTolerance = tolerance * GradientGain * scale;
+    VectorizeBuffer<Point2> vectorizer;
+    std::array<VectorizeBuffer<Point3>, 3> expected;
+    for (const auto &p : points) {
+        std::array<Point3, 3> ps, pm;
+        std::tie(ps[0], ps[1], ps[2]) = reference.GetValueAndGradient(p);
+        std::tie(pm[0], pm[1], pm[2]) = map.GetValueAndGradient(p);
+        for (int k = 0; k < 3; ++k) {
+            const float tol = k == 0 ? tolerance : gradientTolerance;
+            for (int i = 0; i < 3; ++i) {
+                if (std::abs(ps[k][i] - pm[k][i]) > tol) {
+                    std::cout << '\n' << name << " gradient not equal at " << p << ": "
+                              << ps[k] << " vs. " << pm[k];
+                    return false;
                 }
-                tsc.stop();
-                recordTsc(Test, NumberOfEvaluations);
             }
-
-            mean[Test] /= Repetitions;
-            stddev[Test] /= Repetitions;
-            stddev[Test] = std::sqrt(stddev[Test] - mean[Test] * mean[Test]);
-        } while (stddev[Test] * err > mean[Test]);
-        std::cout << std::setw(9) << std::setprecision(3) << mean[Test];
-        std::cout << std::setw(9) << std::setprecision(3) << stddev[Test];
-        std::cout << std::flush;
+            expected[k](ps[k]);
+        }
+        if (0 == vectorizer(p)) {
+            std::array<Point3V, 3> pv;
+            std::tie(pv[0], pv[1], pv[2]) = map.GetValueAndGradient(vectorizer.input);
+            for (int k = 0; k < 3; ++k) {
+                const float tol = k == 0 ? tolerance : gradientTolerance;
+                for (int i = 0; i < 3; ++i) {
+                    if (any_of(abs(expected[k].input[i] - pv[k][i]) > tol)) {
+                        std::cout << "\nHorizontal " << name << " gradient not equal at "
+                                  << vectorizer.input << ":\n" << expected[k].input
+                                  << " vs.\n" << pv[k];
+                        return false;
+                    }
+                }
+            }
+        }
     }
-    //}}}2
-};
-template <typename T> void fakeRead(T &&x)
-{
-#ifdef Vc_GNU_ASM
-    asm("" ::"m"(x));
-#else
-    (void)(&x == &x);
-#endif
+    return true;
 }
-int Vc_CDECL main()  // {{{1
+
+// verifyComponents {{{1
+/** Fill the knot ind of a map of N components: component k is the knot component k % 3
+ * plus k, i.e. its spline is the one of component k % 3 plus k */
+template <typename Map> void fillComponents(Map &map, int ind, const Point3 &xyz)
 {
-    // output header {{{2
-    using std::cout;
-    using std::setw;
-    using std::setprecision;
-    cout << "NumberOfEvaluations: " << NumberOfEvaluations << '\n';
-    cout << "Repetitions: " << Repetitions << '\n';
-    cout << setw(8) << "MapSize";
-    for (int i = 0; i < NBenchmarks; ++i) {
-        cout << setw(18) << testName(i);
+    typename Map::Value values;
+    for (int k = 0; k < Map::Components; ++k) {
+        values[k] = xyz[k % 3] + k;
     }
-    if (TestInfo(Scalar)) {
-        for (int i = 0; i < NBenchmarks; ++i) {
-            if (i != Scalar) {
-                cout << setw(18) << "Scalar/" + testName(i);
+    map.Fill(ind, values.data());
+}
+
+/** Compare the scalar, vector, bulk and gradient kernels of a map filled by
+ * fillComponents with the reference */
+template <typename Map>
+bool verifyComponents(const std::string &name, const Spline<AoS4> &reference,
+                      const Map &map, const std::vector<Point2> &points, float scale)
+{
+    // the offsets of up to 7 round by a few more ulp
+    const float tolerance = 0.0001f;
+    const float gradientTolerance = tolerance * GradientGain * scale;
+    // N - 1 points, so that the masked tail is exercised
+    std::vector<typename Map::Value> bulk(points.size() - 1);
+    map.GetValues(points.data(), bulk.data(), bulk.size());
+    VectorizeBuffer<Point2> vectorizer;
+    VectorizeBuffer<Point3> expected;
+    for (std::size_t n = 0; n < points.size(); ++n) {
+        const auto &p = points[n];
+        Point3 xyz, xyzA, xyzB;
+        std::tie(xyz, xyzA, xyzB) = reference.GetValueAndGradient(p);
+        typename Map::Value value, dA, dB;
+        std::tie(value, dA, dB) = map.GetValueAndGradient(p);
+        const auto &ps = map.GetValue(p);
+        for (int k = 0; k < Map::Components; ++k) {
+            const float r = xyz[k % 3] + k;
+            if (std::abs(ps[k] - r) > tolerance || std::abs(value[k] - r) > tolerance ||
+                (n < bulk.size() && std::abs(bulk[n][k] - r) > tolerance) ||
+                std::abs(dA[k] - xyzA[k % 3]) > gradientTolerance ||
+                std::abs(dB[k] - xyzB[k % 3]) > gradientTolerance) {
+                std::cout << '\n' << name << " not equal at " << p << " in component "
+                          << k << ": " << r << " vs. " << ps[k];
+                return false;
+            }
+        }
+        expected(xyz);
+        if (0 == vectorizer(p)) {
+            const auto &pv = map.GetValue(vectorizer.input);
+            for (int k = 0; k < Map::Components; ++k) {
+                if (any_of(abs(expected.input[k % 3] + float(k) - pv[k]) > tolerance)) {
+                    std::cout << "\nHorizontal " << name << " not equal at "
+                              << vectorizer.input << " in component " << k << ":\n"
+                              << expected.input[k % 3] + float(k) << " vs.\n" << pv[k];
+                    return false;
+                }
             }
         }
     }
-    cout << std::endl;
+    return true;
+}
 
-    // random number generator {{{2
-    std::default_random_engine randomEngine(1);
-    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+// verifyOrders {{{1
+/** The linear and quadratic kernels reproduce the bilinear and biquadratic functions, the
+ * horizontal kernels agree with the scalar ones. The functions are scaled by scale, e.g.
+ * into the value range of Quantized, the default tolerance is the one of float knots of
+ * values of up to 10 plus the component offsets of Packed. */
+template <typename Layout>
+bool verifyOrders(const char *name, int mapSize, const std::vector<Point2> &points,
+                  float scale = 1.f, float tolerance = 0.0001f)
+{
+    typedef Spline<Layout> Map;
+    const auto bilinear = [](float a, float b) {
+        return Point3{{a * b + a, 2 - b + 0.5f * a * b, 3 * a - b}};
+    };
+    const auto biquadratic = [](float a, float b) {
+        return Point3{{a * a * b - b * b, a * b * b + a * a, 0.5f * a * a * b * b + 1}};
+    };
+    // component k of the maps is component k % 3 of the function plus k, scaled
+    const auto components = [scale](const Point3 &f) {
+        typename Map::Value v;
+        for (int k = 0; k < Map::Components; ++k) {
+            v[k] = scale * (f[k % 3] + k);
+        }
+        return v;
+    };
+    Map linear(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize + 5);
+    Map quadratic(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize + 5);
+    linear.Fill([&](float a, float b) { return components(bilinear(a, b)); });
+    quadratic.Fill([&](float a, float b) { return components(biquadratic(a, b)); });
+    VectorizeBuffer<Point2> vectorizer;
+    for (const auto &p : points) {
+        const auto &f1 = components(bilinear(p[0], p[1]));
+        const auto &f2 = components(biquadratic(p[0], p[1]));
+        const auto &p1 = linear.template GetValue<LinearKernel>(p);
+        const auto &p2 = quadratic.template GetValue<QuadraticKernel>(p);
+        for (int k = 0; k < Map::Components; ++k) {
+            if (std::abs(p1[k] - f1[k]) > tolerance ||
+                std::abs(p2[k] - f2[k]) > tolerance) {
+                std::cout << '\n' << name << " linear / quadratic not equal at " << p
+                          << " in component " << k << ": " << f1[k] << " vs. " << p1[k]
+                          << " / " << f2[k] << " vs. " << p2[k];
+                return false;
+            }
+        }
+        if (0 == vectorizer(p)) {
+            const auto &input = vectorizer.input;
+            const auto &v1 = linear.template GetValue<LinearKernel>(input);
+            const auto &v2 = quadratic.template GetValue<QuadraticKernel>(input);
+            for (std::size_t l = 0; l < float_v::Size; ++l) {
+                const Point2 q = {{input[0][l], input[1][l]}};
+                const auto &q1 = linear.template GetValue<LinearKernel>(q);
+                const auto &q2 = quadratic.template GetValue<QuadraticKernel>(q);
+                for (int k = 0; k < Map::Components; ++k) {
+                    if (std::abs(v1[k][l] - q1[k]) > tolerance ||
+                        std::abs(v2[k][l] - q2[k]) > tolerance) {
+                        std::cout << "\nHorizontal " << name
+                                  << " linear / quadratic not equal at " << q
+                                  << " in component " << k << ": " << q1[k] << " vs. "
+                                  << v1[k][l] << " / " << q2[k] << " vs. " << v2[k][l];
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
 
-    // random search points {{{2
-    std::vector<Point2> searchPoints;
-    searchPoints.reserve(NumberOfEvaluations);
-    searchPoints.emplace_back(Point2{{-1.f, -1.f}});
-    searchPoints.emplace_back(Point2{{+1.f, +1.f}});
-    for (int i = 2; i < NumberOfEvaluations; ++i) {
-        searchPoints.emplace_back(Point2{{uniform(randomEngine), uniform(randomEngine)}});
+// orderErrors {{{1
+/** The largest deviations of the linear, quadratic and cubic kernels at the points from
+ * a smooth field, on a map of its knots on a grid of the size of the benchmark maps: the
+ * first three over all points, the last three over the points of the interior cells. The
+ * one of the cubic over all points is usually that of its extrapolating edge cells, the
+ * interior cells are the ones off the edge cells of both axes. */
+std::array<double, 6> orderErrors(int mapSizeA, int mapSizeB,
+                                  const std::vector<Point2> &points)
+{
+    const auto field = [](float a, float b) {
+        return Point3{{std::sin(3 * a + b), std::cos(2 * a * b),
+                       std::exp(0.5f * (a - b))}};
+    };
+    Spline<AoS4> map(-1.f, 1.f, mapSizeA, -1.f, 1.f, mapSizeB);
+    map.Fill(field);
+    // the interior cells span [step - 1, 1 - step], with the knot step of the axis
+    const float innerA = 1 - 2.f / (mapSizeA - 1);
+    const float innerB = 1 - 2.f / (mapSizeB - 1);
+    std::array<double, 6> errors = {{0, 0, 0, 0, 0, 0}};
+    for (const auto &p : points) {
+        const Point3 f = field(p[0], p[1]);
+        const Point3 v[3] = {map.GetValue<LinearKernel>(p),
+                             map.GetValue<QuadraticKernel>(p), map.GetValue(p)};
+        const bool interior = std::abs(p[0]) <= innerA && std::abs(p[1]) <= innerB;
+        for (int k = 0; k < 3; ++k) {
+            for (int c = 0; c < 3; ++c) {
+                const double e = std::abs(v[k][c] - f[c]);
+                errors[k] = std::max(errors[k], e);
+                if (interior) {
+                    errors[k + 3] = std::max(errors[k + 3], e);
+                }
+            }
+        }
     }
+    return errors;
+}
 
-    // MapSize loop {{{2
-    for (int MapSize = FirstMapSize; MapSize <= MaxMapSize; MapSize *= StepMultiplier) {
-        Runner runner(searchPoints);
-        cout << setw(8) << MapSize * MapSize << std::flush;
+// verifyGroup {{{1
+/** The maps of a group evaluate like the separate maps of its members */
+template <typename Map, typename Group>
+bool verifyGroup(const std::vector<std::unique_ptr<Map>> &members, const Group &group,
+                 const std::vector<Point2> &points)
+{
+    // the offsets of up to 11, see verifyComponents
+    const float tolerance = 0.0001f;
+    VectorizeBuffer<Point2> vectorizer;
+    for (const auto &p : points) {
+        const auto &pg = group.GetValue(p);
+        for (std::size_t m = 0; m < members.size(); ++m) {
+            const auto &pm = members[m]->GetValue(p);
+            for (int c = 0; c < 3; ++c) {
+                if (std::abs(pg[3 * m + c] - pm[c]) > tolerance) {
+                    std::cout << "\nGroup not equal at " << p << " in map " << m
+                              << " component " << c << ": " << pm[c] << " vs. "
+                              << pg[3 * m + c];
+                    return false;
+                }
+            }
+        }
+        if (0 == vectorizer(p)) {
+            const auto &pv = group.GetValue(vectorizer.input);
+            for (std::size_t m = 0; m < members.size(); ++m) {
+                const auto &pm = members[m]->GetValue(vectorizer.input);
+                for (int c = 0; c < 3; ++c) {
+                    if (any_of(abs(pv[3 * m + c] - pm[c]) > tolerance)) {
+                        std::cout << "\nHorizontal Group not equal at "
+                                  << vectorizer.input << " in map " << m << " component "
+                                  << c << ":\n" << pm[c] << " vs.\n" << pv[3 * m + c];
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
 
-        // initialize map with random values {{{2
-        Spline spline(-1.f, 1.f, MapSize, -1.f, 1.f, MapSize);
-        Spline2 spline2(-1.f, 1.f, MapSize, -1.f, 1.f, MapSize);
-        Spline3 spline3(-1.f, 1.f, MapSize, -1.f, 1.f, MapSize);
-        for (int i = 0; i < spline.GetNPoints(); ++i) {
-            const float xyz[3] = {uniform(randomEngine), uniform(randomEngine),
-                                  uniform(randomEngine)};
-            spline.Fill(i, xyz);
-            spline2.Fill(i, xyz);
-            spline3.Fill(i, xyz);
+// fixed grids {{{1
+/** Call f(grid) with the FixedGrid of na x nb knots on [-1, 1]^2, if it is one of the
+ * compiled sizes (e.g. of --first-map-size 8 --step 2, --aspect 2 for the 64x128 one).
+ * False for the other sizes. */
+template <typename F> bool withFixedGrid(int na, int nb, F &&f)
+{
+    const auto call = [&](const auto &grid) {
+        if (grid.fNA != na || grid.fNB != nb) {
+            return false;
         }
+        f(grid);
+        return true;
+    };
+    return call(FixedGrid<8, 8>(-1.f, 1.f, -1.f, 1.f)) ||
+           call(FixedGrid<16, 16>(-1.f, 1.f, -1.f, 1.f)) ||
+           call(FixedGrid<32, 32>(-1.f, 1.f, -1.f, 1.f)) ||
+           call(FixedGrid<64, 64>(-1.f, 1.f, -1.f, 1.f)) ||
+           call(FixedGrid<64, 128>(-1.f, 1.f, -1.f, 1.f)) ||
+           call(FixedGrid<128, 128>(-1.f, 1.f, -1.f, 1.f)) ||
+           call(FixedGrid<256, 256>(-1.f, 1.f, -1.f, 1.f));
+}
 
-        // run Benchmarks {{{2
-        for (EnabledTests i = EnabledTests(0); i < NBenchmarks; ++i) {
-            VectorizeBuffer<Point2> vectorizer;
-            switch (int(i)) {
-            case Scalar:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline.GetValueScalar(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Alice:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline.GetValueAlice(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Autovectorized:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline.GetValueAutovec(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Float4:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline.GetValue(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Float16:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline.GetValue16(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Float12:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline2.GetValue(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Float12Interleaved:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    const auto &p2 = spline3.GetValue(p);
-                    fakeRead(p2);
-                });
-                break;
-            case Horizontal1:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    if (0 == vectorizer(p)) {
-                        const auto &p2 = spline.GetValue(vectorizer.input);
-                        fakeRead(p2);
-                    }
-                });
-                break;
-            case Horizontal2:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    if (0 == vectorizer(p)) {
-                        const auto &p2 = spline2.GetValue(vectorizer.input);
-                        fakeRead(p2);
-                    }
-                });
-                break;
-            case Horizontal3:  // {{{3
-                runner.benchmark(i, [&](const Point2 &p) {
-                    if (0 == vectorizer(p)) {
-                        const auto &p2 = spline3.GetValue(vectorizer.input);
-                        fakeRead(p2);
-                    }
-                });
-                break;
-            default:  // {{{3
-                break;
+/** The map of grid with the knots, SoA unless Layout is given */
+template <typename Layout = SoA, typename G>
+std::unique_ptr<Spline<Layout, G>> makeFixedSpline(const G &grid,
+                                                   const std::vector<Point3> &knots)
+{
+    std::unique_ptr<Spline<Layout, G>> map(new Spline<Layout, G>(grid));
+    for (int i = 0; i < map->GetNPoints(); ++i) {
+        map->Fill(i, knots[i].data());
+    }
+    return map;
+}
+
+// verifyFixed {{{1
+/** The map of a fixed grid evaluates like the one of the runtime grid */
+template <typename Layout, typename Fixed>
+bool verifyFixed(const char *name, const Spline<Layout> &reference, const Fixed &fixed,
+                 const std::vector<Point2> &points)
+{
+    const float tolerance = 0.00001f;
+    VectorizeBuffer<Point2> vectorizer;
+    for (const auto &p : points) {
+        const auto &r = reference.GetValue(p);
+        const auto &f = fixed.GetValue(p);
+        const auto &r1 = reference.template GetValue<LinearKernel>(p);
+        const auto &f1 = fixed.template GetValue<LinearKernel>(p);
+        for (int c = 0; c < 3; ++c) {
+            if (std::abs(f[c] - r[c]) > tolerance ||
+                std::abs(f1[c] - r1[c]) > tolerance) {
+                std::cout << "\nFixed " << name << " not equal at " << p
+                          << " in component " << c << ": " << r[c] << " vs. " << f[c]
+                          << " / linear " << r1[c] << " vs. " << f1[c];
+                return false;
             }
         }
-        // print search timings {{{2
-        if (TestInfo(Scalar)) {
-            for (EnabledTests i = EnabledTests(0); i < NBenchmarks; ++i) {
-                if (i != Scalar) {
-                    runner.printRatio(Scalar, i);
+        if (0 == vectorizer(p)) {
+            const auto &input = vectorizer.input;
+            const auto &rv = reference.GetValue(input);
+            const auto &fv = fixed.GetValue(input);
+            const auto &rg = reference.GetValueAndGradient(input);
+            const auto &fg = fixed.GetValueAndGradient(input);
+            // relative to the gradient, of up to 0.5 * map size per unit of the values
+            const auto differs = [tolerance](const float_v &x, const float_v &y) {
+                return any_of(abs(x - y) > tolerance * (1.f + abs(y)));
+            };
+            for (int c = 0; c < 3; ++c) {
+                if (differs(fv[c], rv[c]) ||
+                    differs(std::get<1>(fg)[c], std::get<1>(rg)[c]) ||
+                    differs(std::get<2>(fg)[c], std::get<2>(rg)[c])) {
+                    std::cout << "\nHorizontal Fixed " << name << " not equal at "
+                              << input << " in component " << c << ":\n" << rv[c]
+                              << " vs.\n" << fv[c];
+                    return false;
                 }
             }
         }
-        cout << std::flush;
+    }
+    return true;
+}
 
-        // verify equivalence {{{2
-        {
-            bool failed = false;
-            VectorizeBuffer<Point2> vectorizer2;
-            VectorizeBuffer<Point3> vectorizer3;
-            for (const auto &p : searchPoints) {
-                const auto &ps = spline.GetValueScalar(p);
-                if (TestInfo(Alice)) {  //{{{3
-                    const auto &pv = spline.GetValueAlice(p);
-                    for (int i = 0; i < 3; ++i) {
-                        if (std::abs(ps[i] - pv[i]) > 0.00001f) {
-                            std::cout << "\nAlice not equal at " << p << ": " << ps
-                                      << " vs. " << pv;
-                            failed = true;
-                            break;
-                        }
-                    }
+// verifyWideIndex {{{1
+/** The SoA kernel of the maps beyond the index range evaluates like the default one */
+bool verifyWideIndex(const Spline<SoA> &map, const std::vector<Point2> &points)
+{
+    const float tolerance = 0.00001f;
+    VectorizeBuffer<Point2> vectorizer;
+    for (const auto &p : points) {
+        if (0 == vectorizer(p)) {
+            const auto &input = vectorizer.input;
+            const auto &pv = map.GetValue(input);
+            const auto &pw = map.GetValue<SoA::WideIndexKernel>(input);
+            for (int c = 0; c < 3; ++c) {
+                if (any_of(abs(pw[c] - pv[c]) > tolerance)) {
+                    std::cout << "\nWide index SoA not equal at " << input
+                              << " in component " << c << ":\n" << pv[c] << " vs.\n"
+                              << pw[c];
+                    return false;
                 }
-                if (TestInfo(Autovectorized)) {  //{{{3
-                    const auto &pv = spline.GetValueAutovec(p);
-                    for (int i = 0; i < 3; ++i) {
-                        if (std::abs(ps[i] - pv[i]) > 0.00001f) {
-                            std::cout << "\nAutovectorized not equal at " << p << ": " << ps
-                                      << " vs. " << pv;
-                            failed = true;
-                            break;
-                        }
+            }
+        }
+    }
+    return true;
+}
+
+// verifyPrecision {{{1
+/** Compare the scalar, vector, bulk and gradient kernels of a Planes map with the float
+ * reference, then measure the precision of the layout on a linear function, which the
+ * splines reproduce: with the knots at multiples of 1/16 only the rounding of the knot
+ * values to Knot and of the evaluation in T remains. */
+template <typename Knot, typename T>
+bool verifyPrecision(const std::string &name, const Spline<AoS4> &reference,
+                     const Spline<Planes<Knot, T>> &map,
+                     const std::vector<Point2> &points, float scale)
+{
+    typedef typename Spline<Planes<Knot, T>>::Value Value;
+    const double tolerance = 0.00001;
+    const double gradientTolerance = tolerance * GradientGain * scale;
+    // the float position of the reference rounds differently: on top of the relative
+    // tolerance the values may differ by the gradient times a few ulp of the position
+    const double positionError = 4 * std::numeric_limits<float>::epsilon();
+    const auto differs = [](double x, double y, double tol) {
+        return std::abs(x - y) > tol * (1 + std::abs(y));
+    };
+    // N - 1 points, so that the masked tails are exercised
+    const std::size_t n = points.size() - 1;
+    std::vector<Value> bulk(n);
+    map.GetValues(points.data(), bulk.data(), n);
+    std::vector<float> a(n), b(n);
+    std::vector<T> x(n), y(n), z(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        a[k] = points[k][0];
+        b[k] = points[k][1];
+    }
+    map.GetValues(a.data(), b.data(), x.data(), y.data(), z.data(), n);
+    VectorizeBuffer<Point2> vectorizer;
+    for (std::size_t k = 0; k < points.size(); ++k) {
+        const auto &p = points[k];
+        Point3 r, rA, rB;
+        std::tie(r, rA, rB) = reference.GetValueAndGradient(p);
+        Value v, dA, dB;
+        std::tie(v, dA, dB) = map.GetValueAndGradient(p);
+        const Value ps = map.GetValue(p);
+        for (int c = 0; c < 3; ++c) {
+            const T soa = c == 0 ? x[k % n] : c == 1 ? y[k % n] : z[k % n];
+            const double slope = std::abs(rA[c]) + std::abs(rB[c]);
+            if (differs(ps[c], r[c], tolerance + positionError * slope) ||
+                differs(v[c], ps[c], tolerance) ||
+                (k < n && (differs(bulk[k][c], ps[c], tolerance) ||
+                           differs(soa, ps[c], tolerance))) ||
+                differs(dA[c], rA[c], gradientTolerance) ||
+                differs(dB[c], rB[c], gradientTolerance)) {
+                std::cout << '\n' << name << " not equal at " << p << " in component "
+                          << c << ": " << r[c] << " vs. " << ps[c];
+                return false;
+            }
+        }
+        if (0 == vectorizer(p)) {
+            const auto &pv = map.GetValue(vectorizer.input);
+            const auto &gv = map.GetValueAndGradient(vectorizer.input);
+            for (std::size_t l = 0; l < float_v::Size; ++l) {
+                Value e, eA, eB;
+                const Point2 q = {{vectorizer.input[0][l], vectorizer.input[1][l]}};
+                std::tie(e, eA, eB) = map.GetValueAndGradient(q);
+                for (int c = 0; c < 3; ++c) {
+                    if (differs(pv[c][l], e[c], tolerance) ||
+                        differs(std::get<0>(gv)[c][l], e[c], tolerance) ||
+                        differs(std::get<1>(gv)[c][l], eA[c], gradientTolerance) ||
+                        differs(std::get<2>(gv)[c][l], eB[c], gradientTolerance)) {
+                        std::cout << "\nHorizontal " << name << " not equal at " << q
+                                  << " in component " << c << ": " << e[c] << " vs. "
+                                  << pv[c][l];
+                        return false;
                     }
                 }
-                if (TestInfo(Float4)) {  //{{{3
-                    const auto &pv = spline.GetValue(p);
-                    for (int i = 0; i < 3; ++i) {
-                        if (std::abs(ps[i] - pv[i]) > 0.00001f) {
-                            std::cout << "\nFloat4 not equal at " << p << ": " << ps
-                                      << " vs. " << pv;
-                            failed = true;
-                            break;
+            }
+        }
+    }
+
+    const auto linear = [](double a, double b) {
+        return std::array<double, 3>{{a / 3 + b / 7 + 0.1, 1.1 * b - 0.3 * a,
+                                      2 * a - b / 9}};
+    };
+    Spline<Planes<Knot, T>> exact(-1.f, 1.f, 33, -1.f, 1.f, 33);
+    exact.Fill([&](float a, float b) {
+        const auto f = linear(a, b);
+        return Value{{T(f[0]), T(f[1]), T(f[2])}};
+    });
+    // |f| < 3: the knots round by 1/2 ulp and the 16 weights add up to less than 4, the
+    // evaluation rounds by a few ulp of T per step
+    const double precision = 3 * (4 * std::numeric_limits<Knot>::epsilon() +
+                                  16 * std::numeric_limits<T>::epsilon());
+    for (const auto &p : points) {
+        const auto &f = linear(p[0], p[1]);
+        const auto &v = exact.GetValue(p);
+        for (int c = 0; c < 3; ++c) {
+            if (std::abs(v[c] - f[c]) > precision) {
+                std::cout << '\n' << name << " imprecise at " << p << " in component "
+                          << c << ": " << f[c] << " vs. " << v[c];
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// temporaryPath {{{1
+/** The path of a file of the given name in a directory of this process in $TMPDIR (or
+ * /tmp), which is removed at exit if its files were removed. In $TMPDIR itself if the
+ * directory cannot be created. Elsewhere than Linux a name from std::tmpnam. */
+std::string temporaryPath(const std::string &name)
+{
+#ifdef __linux__
+    struct Directory {
+        std::string path;
+        bool created;
+        Directory()
+        {
+            const char *tmp = std::getenv("TMPDIR");
+            path = tmp && *tmp ? tmp : "/tmp";
+            std::string pattern = path + "/spline-XXXXXX";
+            created = mkdtemp(&pattern[0]) != nullptr;
+            if (created) {
+                path = pattern;
+            }
+        }
+        ~Directory()
+        {
+            if (created) {
+                rmdir(path.c_str());
+            }
+        }
+    };
+    static const Directory directory;
+    return directory.path + '/' + name;
+#else
+    char path[L_tmpnam];
+    return std::tmpnam(path) ? std::string(path) + '-' + name : name;
+#endif
+}
+
+// verifyMapFile {{{1
+/** Write the map to a file and map it back, the kernels of both must agree bitwise. A
+ * Fill copies the read-only loaded map, i.e. a second load still yields the original. A
+ * map of the Other layout must not load from the file. The same for the map from a copy
+ * of the file in a buffer, which has to be aligned and which a Fill must not change. */
+template <typename Other, typename Layout>
+bool verifyMapFile(const std::string &name, const Spline<Layout> &map,
+                   const std::vector<Point2> &points)
+{
+    const std::string path = temporaryPath("spline-" + name + ".map");
+    const typename Spline<Layout>::Value zero = {};
+    std::unique_ptr<Spline<Layout>> loaded, reloaded;
+    if (map.Write(path)) {
+        loaded = loadSpline<Layout>(path);
+    }
+    if (loaded) {
+        loaded->Fill(0, zero.data());
+        reloaded = loadSpline<Layout>(path);
+    }
+    const bool loadedOther = loadSpline<Other>(path) != nullptr;
+    // the buffer of a loader, e.g. a shared memory segment
+    std::ifstream file(path, std::ios::binary);
+    const std::vector<char> bytes((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+    std::vector<char> storage(bytes.size() + 2 * MapFileAlignment), misaligned(storage);
+    // the copy at offset bytes from the first aligned byte of to
+    const auto copy = [&](std::vector<char> &to, std::size_t offset) {
+        const std::size_t skew =
+            reinterpret_cast<std::uintptr_t>(to.data()) % MapFileAlignment;
+        char *begin = to.data() + (MapFileAlignment - skew) % MapFileAlignment + offset;
+        std::copy(bytes.begin(), bytes.end(), begin);
+        return begin;
+    };
+    const char *const buffer = copy(storage, 0);
+    const auto shared = loadSpline<Layout>(buffer, bytes.size());
+    // a Fill of another map of the buffer fills a copy of the knots
+    if (const auto filled = loadSpline<Layout>(buffer, bytes.size())) {
+        filled->Fill(0, zero.data());
+    }
+    const bool bufferChanged = !std::equal(bytes.begin(), bytes.end(), buffer);
+    const bool loadedMisaligned =
+        loadSpline<Layout>(copy(misaligned, 8), bytes.size()) != nullptr;
+    std::remove(path.c_str());
+    if (!reloaded || loadedOther || !shared || loadedMisaligned || bufferChanged) {
+        std::cout << '\n' << name << " map file did not load"
+                  << (loadedOther ? " as the expected layout" : "")
+                  << (reloaded && !shared ? " from a buffer" : "")
+                  << (loadedMisaligned ? " only from aligned buffers" : "")
+                  << (bufferChanged ? " without writing to the buffer" : "");
+        return false;
+    }
+    VectorizeBuffer<Point2> vectorizer;
+    for (const auto &p : points) {
+        const auto &ps = map.GetValue(p);
+        const auto &pl = reloaded->GetValue(p);
+        const auto &pb = shared->GetValue(p);
+        for (int k = 0; k < Spline<Layout>::Components; ++k) {
+            if (ps[k] != pl[k] || ps[k] != pb[k]) {
+                std::cout << '\n' << name << " map file not equal at " << p
+                          << " in component " << k << ": " << ps[k] << " vs. " << pl[k]
+                          << " / " << pb[k];
+                return false;
+            }
+        }
+        if (0 == vectorizer(p)) {
+            const auto &pv = map.GetValue(vectorizer.input);
+            const auto &plv = reloaded->GetValue(vectorizer.input);
+            const auto &pbv = shared->GetValue(vectorizer.input);
+            for (int k = 0; k < Spline<Layout>::Components; ++k) {
+                if (any_of(pv[k] != plv[k]) || any_of(pv[k] != pbv[k])) {
+                    std::cout << "\nHorizontal " << name << " map file not equal at "
+                              << vectorizer.input << " in component " << k << ":\n"
+                              << pv[k] << " vs.\n" << plv[k] << " /\n" << pbv[k];
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// verifyMapHandle {{{1
+/** Publish versions 1 to nVersions of a map (all knots {k, k, k} in version k) while
+ * two threads keep evaluating it. Every read must see one whole version, and the
+ * versions a reader sees must not decrease. */
+bool verifyMapHandle(int mapSize, const std::vector<Point2> &points, int nVersions = 50)
+{
+    const auto makeMap = [mapSize](float k) {
+        std::unique_ptr<Spline<AoS4>> map(
+            new Spline<AoS4>(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize));
+        map->Fill([k](float, float) { return Point3{{k, k, k}}; });
+        return map;
+    };
+    MapHandle<Spline<AoS4>> handle(makeMap(0));
+    std::atomic<bool> done(false);
+    std::atomic<bool> torn(false);
+    const auto evaluate = [&] {
+        MapHandle<Spline<AoS4>>::Reader reader(handle);
+        float last = 0;
+        for (std::size_t i = 0; !done.load(std::memory_order_relaxed); ++i) {
+            const Point2 &p = points[i % points.size()];
+            const Point3 xyz =
+                reader.read([&](const Spline<AoS4> &map) { return map.GetValue(p); });
+            const float k = std::round(xyz[0]);
+            if (k < last || std::abs(xyz[0] - k) > 0.0001f ||
+                std::abs(xyz[1] - k) > 0.0001f || std::abs(xyz[2] - k) > 0.0001f) {
+                torn.store(true);
+            }
+            last = k;
+        }
+    };
+    std::thread reader1(evaluate), reader2(evaluate);
+    for (int k = 1; k <= nVersions; ++k) {
+        handle.publish(makeMap(k));
+    }
+    done.store(true);
+    reader1.join();
+    reader2.join();
+    if (torn.load() || handle.version() != std::uint64_t(nVersions)) {
+        std::cout << "\nMapHandle reader saw a torn or older version";
+        return false;
+    }
+    return true;
+}
+
+// verifyThreadPool {{{1
+/** Two threads run their jobs on the pool at the same time, each must see all of its
+ * chunks. An exception of a chunk reaches the caller, and the pool still works after. */
+bool verifyThreadPool(ThreadPool &pool)
+{
+    constexpr std::size_t N = 100000;
+    std::atomic<std::size_t> sums[2] = {{0}, {0}};
+    const auto sum = [&](int caller) {
+        for (int i = 0; i < 20; ++i) {
+            pool.forEachChunk(N, 1000, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t k = begin; k < end; ++k) {
+                    sums[caller] += k;
+                }
+            });
+        }
+    };
+    std::thread other(sum, 1);
+    sum(0);
+    other.join();
+    bool failed = false;
+    for (const auto &s : sums) {
+        if (s != 20 * (N * (N - 1) / 2)) {
+            std::cerr << "ThreadPool: the chunks of concurrent callers sum to " << s
+                      << " instead of " << 20 * (N * (N - 1) / 2) << '\n';
+            failed = true;
+        }
+    }
+    bool caught = false;
+    try {
+        pool.forEachChunk(N, 1000, [&](std::size_t begin, std::size_t) {
+            if (begin == N / 2) {
+                throw std::runtime_error("chunk");
+            }
+        });
+    } catch (const std::runtime_error &) {
+        caught = true;
+    }
+    std::atomic<unsigned> workers(0);
+    pool.forEachWorker([&](unsigned) { ++workers; });
+    if (!caught || workers != pool.size()) {
+        std::cerr << "ThreadPool: the exception of a chunk did not reach the caller\n";
+        failed = true;
+    }
+    return !failed;
+}
+
+// verifyNonUniform {{{1
+/** n knots on [-1, 1], dense towards the edges */
+std::vector<float> edgeKnots(int n)
+{
+    std::vector<float> knots(n);
+    for (int i = 0; i < n; ++i) {
+        knots[i] = std::sin(1.5707964f * (2.f * i / (n - 1) - 1.f));
+    }
+    return knots;
+}
+
+/** Check that the map of a linear field evaluates the field and its gradient, in the
+ * scalar and the vector kernels */
+template <typename Map>
+bool verifyLinearField(const std::string &name, Map &map,
+                       const std::vector<Point2> &points, float tolerance,
+                       float gradientTolerance)
+{
+    const auto linear = [](float a, float b) {
+        return Point3{{a + 2 * b, 3 * a - b, 0.5f}};
+    };
+    const Point3 dA = {{1, 3, 0}}, dB = {{2, -1, 0}};
+    map.Fill(linear);
+    const auto differs = [&](const Point3 &expected, const Point3 &value, float tol) {
+        for (int i = 0; i < 3; ++i) {
+            if (std::abs(expected[i] - value[i]) > tol) {
+                return true;
+            }
+        }
+        return false;
+    };
+    VectorizeBuffer<Point2> vectorizer;
+    for (const auto &p : points) {
+        std::array<Point3, 3> v;
+        std::tie(v[0], v[1], v[2]) = map.GetValueAndGradient(p);
+        if (0 == vectorizer(p)) {
+            std::array<Point3V, 3> vv;
+            std::tie(vv[0], vv[1], vv[2]) = map.GetValueAndGradient(vectorizer.input);
+            for (std::size_t l = 0; l < float_v::Size; ++l) {
+                const Point2 q = {{vectorizer.input[0][l], vectorizer.input[1][l]}};
+                const Point3 x = {{vv[0][0][l], vv[0][1][l], vv[0][2][l]}};
+                const Point3 xA = {{vv[1][0][l], vv[1][1][l], vv[1][2][l]}};
+                const Point3 xB = {{vv[2][0][l], vv[2][1][l], vv[2][2][l]}};
+                if (differs(linear(q[0], q[1]), x, tolerance) ||
+                    differs(dA, xA, gradientTolerance) ||
+                    differs(dB, xB, gradientTolerance)) {
+                    std::cout << "\nHorizontal " << name << " linear field not equal at "
+                              << q << ": " << x << ", " << xA << ", " << xB;
+                    return false;
+                }
+            }
+        }
+        if (differs(linear(p[0], p[1]), v[0], tolerance) ||
+            differs(dA, v[1], gradientTolerance) ||
+            differs(dB, v[2], gradientTolerance)) {
+            std::cout << '\n' << name << " linear field not equal at " << p << ": "
+                      << v[0] << ", " << v[1] << ", " << v[2];
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Check the maps on non-uniform grids: the evenly spaced knots of the reference must
+ * give the uniform map. The maps on edgeKnots must reproduce a linear field with its
+ * gradient, interpolate the knots, resolve peaks at the edges better than the uniform
+ * map, agree with AoS4 in every layout, and survive a map file. */
+bool verifyNonUniform(const Spline<AoS4> &reference, int mapSizeA, int mapSizeB,
+                      const std::vector<Point3> &knots, const std::vector<Point2> &points)
+{
+    const auto fill = [&](auto &map) {
+        for (int i = 0; i < map.GetNPoints(); ++i) {
+            map.Fill(i, knots[i].data());
+        }
+    };
+    std::vector<float> evenA(mapSizeA), evenB(mapSizeB);
+    for (int i = 0; i < mapSizeA; ++i) {
+        evenA[i] = reference.GetAB(i * mapSizeB).first;
+    }
+    for (int i = 0; i < mapSizeB; ++i) {
+        evenB[i] = reference.GetAB(i).second;
+    }
+    Spline<AoS4> evenAoS4(evenA, evenB);
+    Spline<SoA> evenSoA(evenA, evenB);
+    fill(evenAoS4);
+    fill(evenSoA);
+    // the positions round differently, which the extrapolation of the edge cells would
+    // amplify, thus only the inner cells
+    std::vector<Point2> inner;
+    for (const auto &p : points) {
+        if (std::abs(p[0]) < evenA[mapSizeA - 2] &&
+            std::abs(p[1]) < evenB[mapSizeB - 2]) {
+            inner.push_back(p);
+        }
+    }
+    const float scale = 0.5f * (std::max(mapSizeA, mapSizeB) - 1);
+    if (!verifyGradient("Even AoS4", reference, evenAoS4, inner, scale, 0.00001f) ||
+        !verifyGradient("Even SoA", reference, evenSoA, inner, scale, 0.00001f)) {
+        return false;
+    }
+
+    const std::vector<float> edgeA = edgeKnots(mapSizeA), edgeB = edgeKnots(mapSizeB);
+    {
+        // the tangents of the knot distances: the rounding of the positions amplifies
+        // with the inverse of the narrowest step
+        Spline<AoS4> linearAoS4(edgeA, edgeB);
+        Spline<SoA> linearSoA(edgeA, edgeB);
+        if (!verifyLinearField("Non-uniform AoS4", linearAoS4, points, 0.0001f, 0.01f) ||
+            !verifyLinearField("Non-uniform SoA", linearSoA, points, 0.0001f, 0.01f)) {
+            return false;
+        }
+    }
+    Spline<AoS4> edgeAoS4(edgeA, edgeB);
+    fill(edgeAoS4);
+    for (int iA = 1; iA + 1 < mapSizeA; ++iA) {
+        for (int iB = 1; iB + 1 < mapSizeB; ++iB) {
+            const Point3 &xyz = knots[iA * mapSizeB + iB];
+            const Point3 value = edgeAoS4.GetValue({{edgeA[iA], edgeB[iB]}});
+            for (int i = 0; i < 3; ++i) {
+                if (std::abs(value[i] - xyz[i]) > 0.00001f) {
+                    std::cout << "\nNon-uniform AoS4 does not interpolate the knot " << iA
+                              << ", " << iB << ": " << xyz << " vs. " << value;
+                    return false;
+                }
+            }
+        }
+    }
+    // a field with peaks at the edges of A: the knots at the edges resolve them better
+    // than the same number of evenly spaced knots
+    const auto peaks = [](float a, float b) {
+        return Point3{{std::exp(30 * (a - 1)) + std::exp(-30 * (a + 1)), b, 0}};
+    };
+    Spline<AoS4> peaksEven(evenA, evenB), peaksEdge(edgeA, edgeB);
+    peaksEven.Fill(peaks);
+    peaksEdge.Fill(peaks);
+    // on a line across A, the search points of some patterns miss the edges
+    float errorEven = 0, errorEdge = 0;
+    for (int k = 0; k <= 2000; ++k) {
+        const Point2 p = {{k / 1000.f - 1.f, 0.25f}};
+        const float x = peaks(p[0], p[1])[0];
+        errorEven = std::max(errorEven, std::abs(peaksEven.GetValue(p)[0] - x));
+        errorEdge = std::max(errorEdge, std::abs(peaksEdge.GetValue(p)[0] - x));
+    }
+    if (mapSizeA >= 16 && !(errorEdge < 0.5f * errorEven)) {  // too coarse below
+        std::cout << "\nNon-uniform AoS4 error " << errorEdge << " not below the uniform "
+                  << errorEven;
+        return false;
+    }
+    // knots that are not increasing (a broken writer, the maps assert them) must not
+    // load: the file of peaksEdge with the knots 1 and 2 of A swapped
+    const std::string swappedPath = temporaryPath("spline-swapped.map");
+    bool loadedSwapped = true;
+    if (peaksEdge.Write(swappedPath)) {
+        std::string bytes;
+        {
+            std::ifstream in(swappedPath, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), {});
+        }
+        const char *knots = reinterpret_cast<const char *>(&edgeA[1]);
+        const std::size_t at = bytes.find(std::string(knots, 2 * sizeof(float)));
+        if (at != std::string::npos) {
+            const std::size_t size = sizeof(float);
+            std::swap_ranges(&bytes[at], &bytes[at + size], &bytes[at + size]);
+            std::ofstream(swappedPath, std::ios::binary) << bytes;
+            loadedSwapped = loadSpline<AoS4>(swappedPath) != nullptr;
+        }
+    }
+    std::remove(swappedPath.c_str());
+    if (loadedSwapped) {
+        std::cout << "\nNon-uniform AoS4 map file of decreasing knots loaded";
+        return false;
+    }
+    // the gradient grows with the inverse of the narrowest step
+    const float edgeScale = 1.f / std::min(edgeA[1] - edgeA[0], edgeB[1] - edgeB[0]);
+    const auto verify = [&](const char *name, auto &&map, float tolerance = 0.00001f) {
+        fill(map);
+        return verifyGradient(name, edgeAoS4, map, points, edgeScale, tolerance) &&
+               verifyMapFile<AoS4>(name, map, points);
+    };
+    return verify("Non-uniform SoA", Spline<SoA>(edgeA, edgeB)) &&
+           verify("Non-uniform AoS3", Spline<AoS3>(edgeA, edgeB)) &&
+           verify("Non-uniform Coefficients", Spline<Coefficients>(edgeA, edgeB),
+                  CoefficientsTolerance) &&
+           verify("Non-uniform Morton", Spline<Morton>(edgeA, edgeB)) &&
+           verify("Non-uniform Packed3", Spline<Packed<3>>(edgeA, edgeB));
+}
+
+// verifyVolume {{{1
+/** Check that a trivariate map reproduces a linear field, which Catmull-Rom splines
+ * interpolate (and extrapolate) exactly */
+template <typename Layout>
+bool verifyLinear(const char *name, int mapSize, const std::vector<Point3> &points)
+{
+    // a grid of different sizes per axis
+    Spline3D<Layout> map(-1.f, 1.f, mapSize, -1.f, 1.f, mapSize + 1, -1.f, 1.f,
+                         mapSize + 2);
+    const auto field = [](float a, float b, float c) {
+        return Point3{{a + 2.f * b - c, 0.5f * a - b + 3.f * c, a - b}};
+    };
+    map.Fill([&](float a, float b, float c) { return field(a, b, c); });
+    VectorizeBuffer<Point3> vectorizer;
+    VectorizeBuffer<Point3> expected;
+    for (const auto &p : points) {
+        const Point3 r = field(p[0], p[1], p[2]);
+        const auto &ps = map.GetValue(p);
+        for (int i = 0; i < 3; ++i) {
+            if (std::abs(ps[i] - r[i]) > 0.0001f) {
+                std::cout << '\n' << name << " not linear at " << p << ": " << r
+                          << " vs. " << ps;
+                return false;
+            }
+        }
+        expected(r);
+        if (0 == vectorizer(p)) {
+            const auto &pv = map.GetValue(vectorizer.input);
+            for (int i = 0; i < 3; ++i) {
+                if (any_of(abs(expected.input[i] - pv[i]) > 0.0001f)) {
+                    std::cout << "\nHorizontal " << name << " not linear at "
+                              << vectorizer.input << ":\n" << expected.input << " vs.\n"
+                              << pv;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/** Compare the vector, bulk and parallel kernels of map with the scalar kernel of the
+ * reference */
+template <typename Map>
+bool verifyVolume(const char *name, const Spline3D<AoS4Volume> &reference, const Map &map,
+                  const std::vector<Point3> &points, ThreadPool &pool)
+{
+    // N - 1 points, so that the masked tail is exercised
+    std::vector<Point3> bulk(points.size() - 1), parallel(points.size() - 1);
+    map.GetValues(points.data(), bulk.data(), bulk.size());
+    map.GetValues(points.data(), parallel.data(), parallel.size(), pool);
+    VectorizeBuffer<Point3> vectorizer;
+    VectorizeBuffer<Point3> expected;
+    for (std::size_t n = 0; n < points.size(); ++n) {
+        const auto &p = points[n];
+        const auto &r = reference.GetValue(p);
+        const auto &ps = map.GetValue(p);
+        for (int i = 0; i < 3; ++i) {
+            if (std::abs(ps[i] - r[i]) > 0.00001f ||
+                (n < bulk.size() && (std::abs(bulk[n][i] - r[i]) > 0.00001f ||
+                                     std::abs(parallel[n][i] - r[i]) > 0.00001f))) {
+                std::cout << '\n' << name << " not equal at " << p << ": " << r << " vs. "
+                          << ps;
+                return false;
+            }
+        }
+        expected(r);
+        if (0 == vectorizer(p)) {
+            const auto &pv = map.GetValue(vectorizer.input);
+            for (int i = 0; i < 3; ++i) {
+                if (any_of(abs(expected.input[i] - pv[i]) > 0.00001f)) {
+                    std::cout << "\nHorizontal " << name << " not equal at "
+                              << vectorizer.input << ":\n" << expected.input << " vs.\n"
+                              << pv;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// verifyEvaluations {{{1
+/* An evaluation of the points by one of the kernels, via the bulk interfaces:
+ * aos(ab, xyz, n) and, unless empty, soa(a, b, x, y, z, n). */
+struct Evaluation {
+    std::string name;
+    float tolerance;
+    std::function<void(const Point2 *, Point3 *, std::size_t)> aos;
+    std::function<void(const float *, const float *, float *, float *, float *,
+                       std::size_t)>
+        soa;
+};
+
+/** The evaluation by both bulk interfaces of f, e.g. a generic lambda forwarding its
+ * arguments to GetValues */
+template <typename F>
+Evaluation bulkEvaluation(const std::string &name, F f, float tolerance = 0.00001f)
+{
+    return {name, tolerance, [f](const Point2 *ab, Point3 *xyz, std::size_t n) {
+                f(ab, xyz, n);
+            },
+            [f](const float *a, const float *b, float *x, float *y, float *z,
+                std::size_t n) { f(a, b, x, y, z, n); }};
+}
+
+/** The evaluation of every point by get(Point2), e.g. of a scalar kernel */
+template <typename F>
+Evaluation pointEvaluation(const std::string &name, F get, float tolerance = 0.00001f)
+{
+    return {name, tolerance,
+            [get](const Point2 *ab, Point3 *xyz, std::size_t n) {
+                for (std::size_t k = 0; k < n; ++k) {
+                    const auto &v = get(ab[k]);
+                    xyz[k] = {{v[0], v[1], v[2]}};
+                }
+            },
+            nullptr};
+}
+
+/** Check the evaluations against the scalar kernel of the reference, on N - 1 of the
+ * points, so that the masked tails of the vector kernels are exercised */
+bool verifyEvaluations(const Spline<AoS4> &reference, const std::vector<Point2> &points,
+                       const std::vector<Evaluation> &evaluations)
+{
+    const std::size_t n = points.size() - 1;
+    std::vector<float> a(n), b(n), x(n), y(n), z(n);
+    std::vector<Point3> expected(n), aos(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        a[k] = points[k][0];
+        b[k] = points[k][1];
+        expected[k] = reference.GetValue<AoS4::ScalarKernel>(points[k]);
+    }
+    bool failed = false;
+    for (const auto &e : evaluations) {
+        e.aos(points.data(), aos.data(), n);
+        if (e.soa) {
+            e.soa(a.data(), b.data(), x.data(), y.data(), z.data(), n);
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            const Point3 soa = e.soa ? Point3{{x[k], y[k], z[k]}} : aos[k];
+            for (int i = 0; i < 3; ++i) {
+                if (std::abs(expected[k][i] - aos[k][i]) > e.tolerance ||
+                    std::abs(expected[k][i] - soa[i]) > e.tolerance) {
+                    std::cout << '\n' << e.name << " not equal at " << points[k] << ": "
+                              << expected[k] << " vs. " << aos[k];
+                    if (e.soa) {
+                        std::cout << " / " << soa;
+                    }
+                    failed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return !failed;
+}
+
+// Runner Lambda {{{1
+/* The Runner times every benchmark once over all repetitions and keeps the samples: the
+ * cycles per evaluation of every repetition, or of every batch of evaluations for the
+ * benchmarks of single evaluations (--batch). The samples above the outlier fence (the
+ * third quartile plus 3 interquartile ranges, e.g. of an interrupt or a migration) are
+ * counted but left out of the mean and stddev. The percentiles are over all samples.
+ */
+const double LatencyPercentiles[] = {50, 90, 99, 99.9, 100};
+const char *const LatencyNames[] = {"p50", "p90", "p99", "p99.9", "max"};
+constexpr int NLatencies = sizeof(LatencyPercentiles) / sizeof(LatencyPercentiles[0]);
+
+/** The width of a benchmark column of the table, the mean and stddev (or the ratio and
+ * its error): the longest header, "Scalar/Horiz.Quad2", and a space */
+constexpr int ColumnWidth = 20;
+
+/** the sample at percentile q (0 < q <= 100) of the sorted samples, nearest rank */
+double percentile(const std::vector<double> &sorted, double q)
+{
+    const std::size_t rank = std::ceil(q / 100 * sorted.size());
+    return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+struct Runner
+{
+    // data members{{{2
+    TimeStampCounter tsc;
+    double mean[NBenchmarks] = {};
+    double stddev[NBenchmarks] = {};
+    bool ran[NBenchmarks] = {};
+    std::vector<double> samples[NBenchmarks];             // cycles per evaluation
+    std::array<double, NLatencies> latency[NBenchmarks];  // at LatencyPercentiles
+    int outliers[NBenchmarks] = {};                       // left out of mean and stddev
+    const std::vector<Point2> &searchPoints;
+    const int repetitions;
+    const int batch;  // evaluations per sample of benchmark, 0 for one per repetition
+    PerfCounters *const counters;      // nullptr if the events are not counted
+    PerfCounters *const poolCounters;  // of all workers, for the testPooled benchmarks
+    double events[NBenchmarks][PerfCounters::NEvents] = {};  // per evaluation
+
+    // Runner::Runner{{{2
+    Runner(const std::vector<Point2> &p, int reps, int batchSize, PerfCounters *c,
+           PerfCounters *pc)
+        : searchPoints(p), repetitions(reps), batch(batchSize), counters(c),
+          poolCounters(pc)
+    {
+    }
+
+    /** mean[i] / mean[j] and its error, NaN unless both ran */
+    std::pair<double, double> ratio(int i, int j) const  //{{{2
+    {
+        if (!ran[i] || !ran[j]) {
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            return {nan, nan};
+        }
+        const auto r = mean[i] / mean[j];
+        return {r, r * std::sqrt(stddev[i] * stddev[i] / (mean[i] * mean[i]) +
+                                 stddev[j] * stddev[j] / (mean[j] * mean[j]))};
+    }
+    /** the events per evaluation of Test, NaN if they were not counted */
+    std::array<double, PerfCounters::NEvents> counts(int Test) const  //{{{2
+    {
+        std::array<double, PerfCounters::NEvents> n;
+        for (int e = 0; e < PerfCounters::NEvents; ++e) {
+            n[e] = (testPooled(Test) ? poolCounters : counters)
+                       ? events[Test][e]
+                       : std::numeric_limits<double>::quiet_NaN();
+        }
+        return n;
+    }
+    /** the ratio and its error, a placeholder of the same width if one did not run */
+    template <typename I, typename J> void printRatio(I i, J j)  //{{{2
+    {
+        if (ran[i] && ran[j]) {
+            const auto r = ratio(i, j);
+            std::cout << std::setprecision(3) << std::setw(ColumnWidth - 9) << r.first;
+            std::cout << std::setprecision(3) << std::setw(9) << r.second;
+        } else {
+            std::cout << std::setw(ColumnWidth) << "-";
+        }
+    }
+    // benchmarkSearch{{{2
+    template <typename F> void benchmark(const int Test, F &&fun)
+    {
+        if (batch <= 0) {
+            benchmarkBatch(Test, [&](const std::vector<Point2> &points) {
+                for (const auto &p : points) {
+                    fun(p);
+                }
+            });
+            return;
+        }
+        measure(Test, [&]() {
+            const std::size_t n = searchPoints.size();
+            for (std::size_t i = 0; i < n; i += batch) {
+                const std::size_t end = std::min(n, i + batch);
+                tsc.start();
+                for (std::size_t k = i; k < end; ++k) {
+                    fun(searchPoints[k]);
+                }
+                tsc.stop();
+                samples[Test].push_back(double(tsc.cycles()) / (end - i));
+            }
+        });
+    }
+    // benchmarkBatch{{{2
+    template <typename F> void benchmarkBatch(const int Test, F &&fun)
+    {
+        measure(Test, [&]() {
+            tsc.start();
+            fun(searchPoints);
+            tsc.stop();
+            samples[Test].push_back(double(tsc.cycles()) / searchPoints.size());
+        });
+    }
+    // measure{{{2
+    /** time the repetitions of run, which adds the samples of one repetition */
+    template <typename F> void measure(const int Test, F &&run)
+    {
+        run();  // one cache warm-up run to remove one outlier
+        samples[Test].clear();
+        PerfCounters *const c = testPooled(Test) ? poolCounters : counters;
+        if (c) {
+            c->start();
+        }
+        for (auto rep = repetitions; rep; --rep) {
+            run();
+        }
+        if (c) {
+            c->stop();
+            const double n = double(repetitions) * searchPoints.size();
+            for (int e = 0; e < PerfCounters::NEvents; ++e) {
+                events[Test][e] = c->count(PerfCounters::Event(e)) / n;
+            }
+        }
+
+        std::vector<double> sorted = samples[Test];
+        std::sort(sorted.begin(), sorted.end());
+        for (int k = 0; k < NLatencies; ++k) {
+            latency[Test][k] = percentile(sorted, LatencyPercentiles[k]);
+        }
+        const double q1 = percentile(sorted, 25);
+        const double q3 = percentile(sorted, 75);
+        const double fence = q3 + 3 * (q3 - q1);
+        double sum = 0, square = 0;
+        int n = 0;
+        for (const double x : sorted) {
+            if (x <= fence) {
+                sum += x;
+                square += x * x;
+                ++n;
+            }
+        }
+        outliers[Test] = sorted.size() - n;
+        mean[Test] = sum / n;
+        stddev[Test] = std::sqrt(std::max(0., square / n - mean[Test] * mean[Test]));
+        ran[Test] = true;
+        std::cout << std::setw(ColumnWidth - 9) << std::setprecision(3) << mean[Test];
+        std::cout << std::setw(9) << std::setprecision(3) << stddev[Test];
+        std::cout << std::flush;
+    }
+    //}}}2
+};
+// Report {{{1
+/* The results in the files of --csv and --json: one record per map size and benchmark
+ * with the cycles per evaluation, their stddev, and the speedup over Scalar with its
+ * error (empty or null without the Scalar benchmark). In the thread mode (--threads) a
+ * record is one layout, placement and thread count: the cycles and their stddev are over
+ * the threads, the throughput is the evaluations per second of all threads, and the
+ * scaling is the throughput over the one of the first thread count (the speedup is empty
+ * or null there, the scaling in the benchmark records). The nanoseconds are
+ * the cycles converted with the calibration of the TimeStampCounter, the hardware events
+ * (--counters) are per evaluation, empty or null where they were not counted. The
+ * percentiles and outliers are the ones of the samples of the Runner, in cycles per
+ * evaluation (empty or null in the thread mode).
+ */
+struct Report
+{
+    typedef std::array<double, PerfCounters::NEvents> Events;
+    typedef std::array<double, NLatencies> Latencies;
+
+    struct Record {
+        int mapSizeA;
+        int mapSizeB;
+        std::string benchmark;
+        int threads;
+        double cycles;                      // per evaluation in one thread
+        double stddev;
+        std::pair<double, double> speedup;  // and its error
+        double throughput;                  // M evaluations per second, NaN if unknown
+        double scaling;                     // over the first thread count, NaN if unknown
+        Events events;                      // per evaluation, NaN if not counted
+        Latencies latency;                  // at LatencyPercentiles, NaN if unknown
+        int outliers;                       // samples left out of cycles and stddev
+        double error;  // of the interpolation order (see orderErrors), NaN if unknown
+        double interiorError;  // the error in the interior cells, NaN if unknown
+    };
+
+    std::ofstream csv;
+    std::ofstream json;
+    bool empty = true;   // no JSON record yet
+    std::string prefix;  // the first CSV columns
+    const double nanoseconds;  // per TSC cycle
+
+    Report(const Settings &settings, const std::string &target, double tscNs)
+        : nanoseconds(tscNs)
+    {
+        if (!settings.csvPath.empty()) {
+            csv.open(settings.csvPath);
+            csv << "target,points,evaluations,mapSizeA,mapSizeB,benchmark,threads,cycles,"
+                   "stddev,speedup,speedupError,throughput,scaling,nanoseconds";
+            for (int e = 0; e < PerfCounters::NEvents; ++e) {
+                csv << ',' << eventKey(e);
+            }
+            for (const char *name : LatencyNames) {
+                csv << ',' << name;
+            }
+            csv << ",outliers,maxError,interiorError\n";
+        }
+        if (!settings.jsonPath.empty()) {
+            json.open(settings.jsonPath);
+            json << "{\"target\": \"" << target << "\", \"points\": \""
+                 << PatternNames[int(settings.pattern)]
+                 << "\", \"evaluations\": " << settings.evaluations
+                 << ", \"repetitions\": " << settings.repetitions
+                 << ", \"batch\": " << settings.batch << ", \"tscGHz\": " << 1 / tscNs
+                 << ", \"results\": [";
+        }
+        csv.precision(6);
+        json.precision(6);
+        prefix = target + ',' + PatternNames[int(settings.pattern)] + ',' +
+                 std::to_string(settings.evaluations) + ',';
+    }
+    /** terminates the JSON, also of a run that stopped at a failed verification */
+    ~Report()
+    {
+        if (json.is_open()) {
+            json << "\n]}\n";
+        }
+    }
+    /** false if a file could not be written */
+    bool good() const
+    {
+        return !csv.fail() && !json.fail();
+    }
+
+    void add(const Record &r)
+    {
+        if (csv.is_open()) {
+            csv << prefix << r.mapSizeA << ',' << r.mapSizeB << ',' << r.benchmark << ','
+                << r.threads << ',' << r.cycles << ',' << r.stddev << ',';
+            put(csv, r.speedup.first, "") << ',';
+            put(csv, r.speedup.second, "") << ',';
+            put(csv, r.throughput, "") << ',';
+            put(csv, r.scaling, "") << ',' << r.cycles * nanoseconds;
+            for (const double n : r.events) {
+                put(csv << ',', n, "");
+            }
+            for (const double x : r.latency) {
+                put(csv << ',', x, "");
+            }
+            put(csv << ',' << r.outliers << ',', r.error, "") << ',';
+            put(csv, r.interiorError, "") << '\n';
+        }
+        if (json.is_open()) {
+            json << (empty ? "\n" : ",\n") << "  {\"mapSizeA\": " << r.mapSizeA
+                 << ", \"mapSizeB\": " << r.mapSizeB << ", \"benchmark\": \""
+                 << r.benchmark << "\", \"threads\": " << r.threads
+                 << ", \"cycles\": " << r.cycles << ", \"stddev\": " << r.stddev
+                 << ", \"speedup\": ";
+            put(json, r.speedup.first, "null") << ", \"speedupError\": ";
+            put(json, r.speedup.second, "null") << ", \"throughput\": ";
+            put(json, r.throughput, "null") << ", \"scaling\": ";
+            put(json, r.scaling, "null")
+                << ", \"nanoseconds\": " << r.cycles * nanoseconds;
+            for (int e = 0; e < PerfCounters::NEvents; ++e) {
+                put(json << ", \"" << eventKey(e) << "\": ", r.events[e], "null");
+            }
+            json << ", \"latency\": {";
+            for (int k = 0; k < NLatencies; ++k) {
+                put(json << (k ? ", \"" : "\"") << LatencyNames[k] << "\": ",
+                    r.latency[k], "null");
+            }
+            json << "}, \"outliers\": " << r.outliers << ", \"maxError\": ";
+            put(json, r.error, "null") << ", \"interiorError\": ";
+            put(json, r.interiorError, "null") << '}';
+            empty = false;
+        }
+    }
+
+    /** all NaN, for the records without counters or samples */
+    template <std::size_t N> static std::array<double, N> unknown()
+    {
+        std::array<double, N> n;
+        n.fill(std::numeric_limits<double>::quiet_NaN());
+        return n;
+    }
+
+private:
+    /** the column of the event e */
+    static const char *eventKey(int e)
+    {
+        static const char *const keys[PerfCounters::NEvents] = {
+            "instructions", "coreCycles", "l1dMisses", "llcMisses", "dtlbMisses"};
+        return keys[e];
+    }
+
+    /** x, or none if it is NaN */
+    static std::ostream &put(std::ostream &s, double x, const char *none)
+    {
+        return std::isnan(x) ? s << none : s << x;
+    }
+};
+
+// runThreads {{{1
+/* The thread mode: for every map size, thread count and layout, a pool of that many
+ * threads pinned to the CPUs of --cpus in turn evaluates one map. Every thread has its
+ * own search points, and the timed runs of all threads start at once. The map is one
+ * copy shared by all threads, created by the calling thread, and, if the threads span
+ * several NUMA nodes, one copy per node, created and filled by a thread of the node,
+ * i.e. on the memory of the node (first touch). The throughput is that of all threads
+ * together, from the first start to the last end of the timed runs.
+ */
+struct WorkerTimes
+{
+    double seconds;              // from the first start to the last end of the timed runs
+    std::vector<double> cycles;  // per evaluation, per worker
+};
+
+/** Let every worker evaluate its points on mapOf(id) repetitions times */
+template <typename MapOf>
+WorkerTimes timeWorkers(ThreadPool &pool, int repetitions,
+                        const std::vector<std::vector<Point2>> &points,
+                        std::vector<std::vector<Point3>> &results, MapOf &&mapOf)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<Clock::time_point> begin(pool.size()), end(pool.size());
+    WorkerTimes times = {0, std::vector<double>(pool.size())};
+    std::atomic<unsigned> ready(0);
+    pool.forEachWorker([&](unsigned id) {
+        const SplineInterface &map = mapOf(id);
+        const auto &p = points[id];
+        auto &r = results[id];
+        map.GetValues(p.data(), r.data(), p.size());  // cache warm-up
+        ready.fetch_add(1);
+        while (ready.load() < pool.size()) {
+            std::this_thread::yield();
+        }
+        TimeStampCounter tsc;
+        begin[id] = Clock::now();
+        tsc.start();
+        for (int rep = 0; rep < repetitions; ++rep) {
+            map.GetValues(p.data(), r.data(), p.size());
+        }
+        tsc.stop();
+        end[id] = Clock::now();
+        times.cycles[id] = double(tsc.cycles()) / (double(repetitions) * p.size());
+    });
+    const std::chrono::duration<double> seconds =
+        *std::max_element(end.begin(), end.end()) -
+        *std::min_element(begin.begin(), begin.end());
+    times.seconds = seconds.count();
+    return times;
+}
+
+int runThreads(const Settings &settings, Report &report)
+{
+    using std::cout;
+    using std::setw;
+    const std::vector<int> cpus = settings.cpus.empty() ? availableCpus() : settings.cpus;
+    cout << setw(12) << "MapSize" << setw(8) << "Threads" << setw(8) << "Nodes"
+         << setw(14) << "Layout" << setw(11) << "Copies" << setw(9) << "cycles"
+         << setw(9) << "stddev" << setw(13) << "Mevals/s/thr" << setw(10) << "Mevals/s"
+         << setw(9) << "scaling" << std::endl;
+    std::default_random_engine randomEngine(1);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    for (int MapSize = settings.firstMapSize; MapSize <= settings.maxMapSize;
+         MapSize = std::max(MapSize + 1, int(MapSize * settings.stepMultiplier))) {
+        const int MapSizeB = settings.mapSizeB(MapSize);
+        std::vector<Point3> knots(MapSize * MapSizeB);
+        for (auto &xyz : knots) {
+            xyz = {{uniform(randomEngine), uniform(randomEngine), uniform(randomEngine)}};
+        }
+        const auto makeMap = [&](SplineLayout layout) {
+            auto map = makeSpline(layout, -1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+            for (int i = 0; i < map->GetNPoints(); ++i) {
+                map->Fill(i, knots[i].data());
+            }
+            return map;
+        };
+        std::map<std::string, double> base;  // throughput of the first thread count
+        for (const int nThreads : settings.threads) {
+            std::vector<int> pinned(nThreads), node(nThreads);
+            std::vector<int> owner(nThreads);  // the first worker of the same node
+            int nNodes = 0;
+            for (int id = 0; id < nThreads; ++id) {
+                pinned[id] = cpus[id % cpus.size()];
+                node[id] = cpuNode(pinned[id]);
+                owner[id] = std::find(node.begin(), node.end(), node[id]) - node.begin();
+                nNodes += owner[id] == id;
+            }
+            ThreadPool pool(pinned, true);  // worker 0 on pinned[0] as well
+            // the points and results of a thread are on the memory of its node as well
+            std::vector<std::vector<Point2>> points(nThreads);
+            std::vector<std::vector<Point3>> results(nThreads);
+            pool.forEachWorker([&](unsigned id) {
+                std::default_random_engine engine(id + 2);
+                const int n = settings.evaluations;
+                points[id] = makeSearchPoints(settings.pattern, n, engine);
+                results[id].resize(settings.evaluations);
+            });
+            for (const auto layout : AllLayouts) {
+                const auto record = [&](const char *copies, const WorkerTimes &t) {
+                    const double n = double(settings.evaluations) * settings.repetitions;
+                    const double throughput = 1e-6 * n * nThreads / t.seconds;
+                    double mean = 0, square = 0;
+                    for (int id = 0; id < nThreads; ++id) {
+                        mean += t.cycles[id];
+                        square += t.cycles[id] * t.cycles[id];
+                    }
+                    mean /= nThreads;
+                    const double stddev =
+                        std::sqrt(std::max(0., square / nThreads - mean * mean));
+                    const std::string name =
+                        std::string(splineLayoutName(layout)) + '/' + copies;
+                    double &first = base[name];
+                    if (first == 0) {
+                        first = throughput;
+                    }
+                    const double nan = std::numeric_limits<double>::quiet_NaN();
+                    cout << setw(12)
+                         << std::to_string(MapSize) + 'x' + std::to_string(MapSizeB)
+                         << setw(8) << nThreads << setw(8) << nNodes << setw(14)
+                         << splineLayoutName(layout) << setw(11) << copies
+                         << std::setprecision(3) << setw(9) << mean << setw(9) << stddev
+                         << setw(13) << throughput / nThreads << setw(10) << throughput
+                         << setw(9) << throughput / first << std::endl;
+                    report.add({MapSize, MapSizeB, name, nThreads, mean, stddev,
+                                {nan, nan}, throughput, throughput / first,
+                                Report::unknown<PerfCounters::NEvents>(),
+                                Report::unknown<NLatencies>(), 0, nan, nan});
+                };
+                const auto shared = makeMap(layout);
+                const auto all = [&](unsigned) -> const SplineInterface & {
+                    return *shared;
+                };
+                record("shared",
+                       timeWorkers(pool, settings.repetitions, points, results, all));
+                if (nNodes < 2) {
+                    continue;
+                }
+                std::vector<std::unique_ptr<SplineInterface>> copies(nThreads);
+                pool.forEachWorker([&](unsigned id) {
+                    if (owner[id] == int(id)) {
+                        copies[id] = makeMap(layout);
+                    }
+                });
+                const auto local = [&](unsigned id) -> const SplineInterface & {
+                    return *copies[owner[id]];
+                };
+                const auto times =
+                    timeWorkers(pool, settings.repetitions, points, results, local);
+                if (settings.verify) {
+                    // the copies give the same values as the shared map
+                    std::vector<Point3> expected(settings.evaluations);
+                    for (int id = 0; id < nThreads; ++id) {
+                        shared->GetValues(points[id].data(), expected.data(),
+                                          expected.size());
+                        if (expected != results[id]) {
+                            cout << '\n' << splineLayoutName(layout)
+                                 << " per node copy not equal to the shared map\n";
+                            return 1;
                         }
                     }
-                }
-                if (TestInfo(Float16)) {  //{{{3
-                    const auto &pv = spline.GetValue16(p);
-                    for (int i = 0; i < 3; ++i) {
-                        if (std::abs(ps[i] - pv[i]) > 0.00001f) {
-                            std::cout << "\nFloat16 not equal at " << p << ": " << ps
-                                      << " vs. " << pv;
-                            failed = true;
-                            break;
-                        }
+                }
+                record("per-node", times);
+            }
+        }
+        if (!report.good()) {
+            std::cerr << "cannot write the CSV or JSON file\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+template <typename T> void fakeRead(T &&x)
+{
+#ifdef Vc_GNU_ASM
+    asm("" ::"m"(x));
+#else
+    (void)(&x == &x);
+#endif
+}
+int Vc_CDECL main(int argc, char **argv)  // {{{1
+{
+    // settings {{{2
+    Settings settings;
+    if (!parseSettings(argc, argv, settings)) {
+        usage(std::cerr, argv[0]);
+        return 1;
+    }
+    if (settings.help) {
+        usage(std::cout, argv[0]);
+        return 0;
+    }
+    if (settings.listTests) {
+        for (int i = 0; i < NBenchmarks; ++i) {
+            std::cout << testName(i) << '\n';
+        }
+        return 0;
+    }
+    const int NumberOfEvaluations = settings.evaluations;
+
+    // output header {{{2
+    using std::cout;
+    using std::setw;
+    using std::setprecision;
+    cout << "NumberOfEvaluations: " << NumberOfEvaluations << '\n';
+    cout << "Repetitions: " << settings.repetitions << '\n';
+    ThreadPool pool;
+    cout << "Threads: " << pool.size() << '\n';
+    cout << "Target:  " << supportedSplineTargets().front() << '\n';
+    cout << "Points:  " << PatternNames[int(settings.pattern)] << '\n';
+    const double tscNs = tscNanoseconds(std::chrono::milliseconds(100));
+    cout << "TSC:     " << setprecision(4) << 1 / tscNs << " GHz\n";
+    std::unique_ptr<PerfCounters> counters, poolCounters;
+    if (settings.counters) {
+        counters.reset(new PerfCounters);
+        std::vector<int> workers(pool.size());
+        pool.forEachWorker(
+            [&](unsigned id) { workers[id] = PerfCounters::currentThread(); });
+        poolCounters.reset(new PerfCounters(workers));
+        if (!counters->available()) {
+            std::cerr << "no hardware counters, continuing without --counters\n";
+            counters.reset();
+        }
+        if (!counters || !poolCounters->available()) {
+            poolCounters.reset();  // the Parallel benchmarks report no events
+        }
+    }
+    Report report(settings, supportedSplineTargets().front(), tscNs);
+    if (!report.good()) {
+        std::cerr << "cannot write the CSV or JSON file\n";
+        return 1;
+    }
+    if (!settings.threads.empty()) {
+        return runThreads(settings, report);
+    }
+    cout << setw(12) << "MapSize";
+    for (int i = 0; i < NBenchmarks; ++i) {
+        if (settings.tests[i]) {
+            cout << setw(ColumnWidth) << testName(i);
+        }
+    }
+    if (settings.tests[Scalar]) {
+        for (int i = 0; i < NBenchmarks; ++i) {
+            if (i != Scalar && settings.tests[i]) {
+                cout << setw(ColumnWidth) << "Scalar/" + testName(i);
+            }
+        }
+    }
+    cout << std::endl;
+    if (settings.latency || counters) {
+        cout << setw(30) << "per evaluation:";
+        if (settings.latency) {
+            for (const char *name : LatencyNames) {
+                cout << setw(9) << name;
+            }
+            cout << setw(9) << "outliers";
+        }
+        if (counters) {
+            cout << setw(10) << "ns";
+            for (int e = 0; e < PerfCounters::NEvents; ++e) {
+                cout << setw(14) << PerfCounters::name(PerfCounters::Event(e));
+            }
+        }
+        cout << std::endl;
+    }
+
+    // random number generator {{{2
+    std::default_random_engine randomEngine(1);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+    // search points of the pattern {{{2
+    const std::vector<Point2> searchPoints =
+        makeSearchPoints(settings.pattern, NumberOfEvaluations, randomEngine);
+    // the verification compares inside of the grid only: the extrapolation amplifies the
+    // rounding differences beyond the tolerances
+    std::vector<Point2> verifyPoints;
+    std::copy_if(searchPoints.begin(), searchPoints.end(),
+                 std::back_inserter(verifyPoints), [](const Point2 &p) {
+                     return std::abs(p[0]) <= 1.f && std::abs(p[1]) <= 1.f;
+                 });
+
+    // random search points of the trivariate maps, with their own generator {{{2
+    std::default_random_engine randomEngine3(3);
+    std::vector<Point3> searchPoints3;
+    searchPoints3.reserve(NumberOfEvaluations);
+    searchPoints3.emplace_back(Point3{{-1.f, -1.f, -1.f}});
+    searchPoints3.emplace_back(Point3{{+1.f, +1.f, +1.f}});
+    for (int i = 2; i < NumberOfEvaluations; ++i) {
+        searchPoints3.emplace_back(Point3{
+            {uniform(randomEngine3), uniform(randomEngine3), uniform(randomEngine3)}});
+    }
+
+    // the result buffer of the bulk interfaces {{{2
+    std::vector<Point3> bulkResults(NumberOfEvaluations);
+
+    // MapSize loop {{{2
+    for (int MapSize = settings.firstMapSize; MapSize <= settings.maxMapSize;
+         MapSize = std::max(MapSize + 1, int(MapSize * settings.stepMultiplier))) {
+        const int MapSizeB = settings.mapSizeB(MapSize);
+        Runner runner(searchPoints, settings.repetitions, settings.batch,
+                      counters.get(), poolCounters.get());
+        cout << setw(12) << std::to_string(MapSize) + 'x' + std::to_string(MapSizeB)
+             << std::flush;
+
+        // initialize map with random values {{{2
+        Spline<AoS4> spline(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<SoA> spline2(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<AoS3> spline3(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Coefficients> spline4(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Morton> spline5(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Quantized<Int16Knot>> spline6i(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Quantized<HalfKnot>> spline6h(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Packed<1>> packed1(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Packed<3>> packed3(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Packed<8>> packed8(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Planes<float>> planesF(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Planes<float, double>> planesM(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Planes<double>> planesD(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        // 4 maps of the same points: separately, grouped and interleaved
+        std::vector<std::unique_ptr<Spline<Packed<3>>>> separate;
+        for (int m = 0; m < 4; ++m) {
+            separate.emplace_back(
+                new Spline<Packed<3>>(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB));
+        }
+        Spline<Group<4>> group4(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        Spline<Packed<12>> packed12(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        // about as many knots as the 2D maps
+        const int VolumeSize =
+            std::max(4, int(std::cbrt(double(MapSize) * MapSizeB) + 0.5));
+        Spline3D<AoS4Volume> volume(-1.f, 1.f, VolumeSize, -1.f, 1.f, VolumeSize, -1.f,
+                                    1.f, VolumeSize);
+        Spline3D<SoAVolume> volume2(-1.f, 1.f, VolumeSize, -1.f, 1.f, VolumeSize, -1.f,
+                                    1.f, VolumeSize);
+        for (int i = 0; i < volume.GetNPoints(); ++i) {
+            const float xyz[3] = {uniform(randomEngine3), uniform(randomEngine3),
+                                  uniform(randomEngine3)};
+            volume.Fill(i, xyz);
+            volume2.Fill(i, xyz);
+        }
+        // one bin per interval between knots, i.e. the points of a bin share their cell
+        PointBinning binning(-1.f, 1.f, MapSize - 1, -1.f, 1.f, MapSizeB - 1);
+        const auto dispatched =
+            makeSpline(SplineLayout::SoA, -1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB);
+        // tuned without the profile file: the benchmark neither reads nor writes the
+        // cache of the user
+        TunedSpline tuned(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB,
+                          TunedSpline::FloatLayouts(), std::string());
+        std::vector<Point3> knots(spline.GetNPoints());
+        for (int i = 0; i < spline.GetNPoints(); ++i) {
+            knots[i] = {{uniform(randomEngine), uniform(randomEngine), uniform(randomEngine)}};
+            const float *xyz = knots[i].data();
+            dispatched->Fill(i, xyz);
+            tuned.Fill(i, xyz);
+            spline.Fill(i, xyz);
+            spline2.Fill(i, xyz);
+            spline3.Fill(i, xyz);
+            spline4.Fill(i, xyz);
+            spline5.Fill(i, xyz);
+            spline6i.Fill(i, xyz);
+            spline6h.Fill(i, xyz);
+            fillComponents(packed1, i, knots[i]);
+            fillComponents(packed3, i, knots[i]);
+            fillComponents(packed8, i, knots[i]);
+            const double xyzD[3] = {xyz[0], xyz[1], xyz[2]};
+            planesF.Fill(i, xyz);
+            planesM.Fill(i, xyzD);
+            planesD.Fill(i, xyzD);
+            fillComponents(group4, i, knots[i]);
+            fillComponents(packed12, i, knots[i]);
+            for (int m = 0; m < 4; ++m) {
+                const Point3 member = {{xyz[0] + 3 * m, xyz[1] + 3 * m + 1,
+                                        xyz[2] + 3 * m + 2}};
+                separate[m]->Fill(i, member.data());
+            }
+        }
+
+        // run Benchmarks {{{2
+        for (EnabledTests i = EnabledTests(0); i < NBenchmarks; ++i) {
+            if (!settings.tests[i]) {
+                continue;
+            }
+            VectorizeBuffer<Point2> vectorizer;
+            switch (int(i)) {
+            case Scalar:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue<AoS4::ScalarKernel>(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Alice:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue<AoS4::AliceKernel>(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Autovectorized:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue<AoS4::AutovecKernel>(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Float4:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Float16:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue<AoS4::Float16Kernel>(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Float12:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline2.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Float12Interleaved:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline3.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Horizontal1:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Horizontal2:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline2.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Horizontal3:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline3.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Linear:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue<LinearKernel>(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalLinear:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline.GetValue<LinearKernel>(vectorizer.input);
+                        fakeRead(p2);
                     }
-                }
-                if (TestInfo(Float12)) {  //{{{3
-                    const auto &pv = spline2.GetValue(p);
-                    for (int i = 0; i < 3; ++i) {
-                        if (std::abs(ps[i] - pv[i]) > 0.00001f) {
-                            std::cout << "\nFloat12 not equal at " << p << ": " << ps
-                                      << " vs. " << pv;
-                            failed = true;
-                            break;
+                });
+                break;
+            case Quadratic:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline.GetValue<QuadraticKernel>(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalQuadratic:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 =
+                            spline.GetValue<QuadraticKernel>(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case HorizontalLinear2:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline2.GetValue<LinearKernel>(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case HorizontalQuadratic2:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 =
+                            spline2.GetValue<QuadraticKernel>(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Fixed2:  // {{{3
+            case HorizontalFixed2:
+                // only at the compiled sizes, see withFixedGrid
+                withFixedGrid(MapSize, MapSizeB, [&](const auto &grid) {
+                    const auto fixed = makeFixedSpline(grid, knots);
+                    if (i == Fixed2) {
+                        runner.benchmark(i, [&](const Point2 &p) {
+                            const auto &p2 = fixed->GetValue(p);
+                            fakeRead(p2);
+                        });
+                        return;
+                    }
+                    runner.benchmark(i, [&](const Point2 &p) {
+                        if (0 == vectorizer(p)) {
+                            const auto &p2 = fixed->GetValue(vectorizer.input);
+                            fakeRead(p2);
                         }
+                    });
+                });
+                break;
+            case HorizontalWide2:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 =
+                            spline2.GetValue<SoA::WideIndexKernel>(vectorizer.input);
+                        fakeRead(p2);
                     }
-                }
-                if (TestInfo(Float12Interleaved)) {  //{{{3
-                    const auto &pv = spline3.GetValue(p);
-                    for (int i = 0; i < 3; ++i) {
-                        if (std::abs(ps[i] - pv[i]) > 0.00001f) {
-                            std::cout << "\nFloat12Interleaved not equal at " << p << ": " << ps
-                                      << " vs. " << pv;
-                            failed = true;
-                            break;
+                });
+                break;
+            case Bulk1:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    spline.GetValues(p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Bulk2:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    spline2.GetValues(p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Bulk3:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    spline3.GetValues(p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Bulk1NoPrefetch:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    evaluateBulk(spline, p.data(), bulkResults.data(), p.size(), 0);
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Bulk1FarPrefetch:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    evaluateBulk(spline, p.data(), bulkResults.data(), p.size(), 16);
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Binned1:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    binning.GetValues(spline, p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Binned2:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    binning.GetValues(spline2, p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Dispatched:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    dispatched->GetValues(p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Tuned:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    tuned.GetValues(p.data(), bulkResults.data(), p.size());
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case CoefficientsLayout:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline4.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Horizontal4:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline4.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Float12Tiled:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline5.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Horizontal5:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline5.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Int16:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline6i.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalInt16:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline6i.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Half:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = spline6h.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalHalf:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = spline6h.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Gradient:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &g = spline.GetValueAndGradient(p);
+                    fakeRead(g);
+                });
+                break;
+            case HorizontalGradient:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &g = spline2.GetValueAndGradient(vectorizer.input);
+                        fakeRead(g);
+                    }
+                });
+                break;
+            case Packed1:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = packed1.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalPacked1:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = packed1.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Packed3:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = packed3.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case Packed8:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = packed8.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalPacked8:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = packed8.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case PlanesFloat:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = planesF.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalPlanesFloat:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = planesF.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case PlanesMixed:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = planesM.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalPlanesMixed:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = planesM.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case PlanesDouble:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = planesD.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalPlanesDouble:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = planesD.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Separate4:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    for (const auto &map : separate) {
+                        const auto &p2 = map->GetValue(p);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case HorizontalSeparate4:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        for (const auto &map : separate) {
+                            const auto &p2 = map->GetValue(vectorizer.input);
+                            fakeRead(p2);
                         }
                     }
-                }
-                vectorizer3(ps);
-                if (0 == vectorizer2(p)) {
-                    if (TestInfo(Horizontal1)) {  //{{{3
-                        const auto &pv = spline.GetValue(vectorizer2.input);
-                        for (int i = 0; i < 3; ++i) {
-                            if (any_of(abs(vectorizer3.input[i] - pv[i]) > 0.00001f)) {
-                                cout << "\nHorizontal1 not equal at " << vectorizer2.input
-                                     << ": " << vectorizer3.input << " vs. " << pv;
-                                failed = true;
-                                break;
-                            }
+                });
+                break;
+            case Group4:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = group4.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalGroup4:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = group4.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Packed12:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    const auto &p2 = packed12.GetValue(p);
+                    fakeRead(p2);
+                });
+                break;
+            case HorizontalPacked12:  // {{{3
+                runner.benchmark(i, [&](const Point2 &p) {
+                    if (0 == vectorizer(p)) {
+                        const auto &p2 = packed12.GetValue(vectorizer.input);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case Volume:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &) {
+                    for (const auto &p : searchPoints3) {
+                        const auto &p2 = volume.GetValue(p);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case HorizontalVolume:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &) {
+                    VectorizeBuffer<Point3> vectorizer3;
+                    for (const auto &p : searchPoints3) {
+                        if (0 == vectorizer3(p)) {
+                            const auto &p2 = volume.GetValue(vectorizer3.input);
+                            fakeRead(p2);
                         }
                     }
-                    if (TestInfo(Horizontal2)) {  //{{{3
-                        const auto &pv = spline2.GetValue(vectorizer2.input);
-                        for (int i = 0; i < 3; ++i) {
-                            if (any_of(abs(vectorizer3.input[i] - pv[i]) > 0.00001f)) {
-                                cout << "\nHorizontal2 not equal at \n" << vectorizer2.input
-                                     << ":\n" << vectorizer3.input << " vs.\n" << pv;
-                                failed = true;
-                                break;
-                            }
+                });
+                break;
+            case Volume2:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &) {
+                    for (const auto &p : searchPoints3) {
+                        const auto &p2 = volume2.GetValue(p);
+                        fakeRead(p2);
+                    }
+                });
+                break;
+            case HorizontalVolume2:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &) {
+                    VectorizeBuffer<Point3> vectorizer3;
+                    for (const auto &p : searchPoints3) {
+                        if (0 == vectorizer3(p)) {
+                            const auto &p2 = volume2.GetValue(vectorizer3.input);
+                            fakeRead(p2);
                         }
                     }
-                    if (TestInfo(Horizontal3)) {  //{{{3
-                        const auto &pv = spline3.GetValue(vectorizer2.input);
-                        for (int i = 0; i < 3; ++i) {
-                            if (any_of(abs(vectorizer3.input[i] - pv[i]) > 0.00001f)) {
-                                cout << "\nHorizontal3 not equal at \n" << vectorizer2.input
-                                     << ":\n" << vectorizer3.input << " vs.\n" << pv;
-                                failed = true;
-                                break;
-                            }
+                });
+                break;
+            case Parallel1:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    spline.GetValues(p.data(), bulkResults.data(), p.size(), pool);
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Parallel2:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    spline2.GetValues(p.data(), bulkResults.data(), p.size(), pool);
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            case Parallel3:  // {{{3
+                runner.benchmarkBatch(i, [&](const std::vector<Point2> &p) {
+                    spline3.GetValues(p.data(), bulkResults.data(), p.size(), pool);
+                    fakeRead(bulkResults.back());
+                });
+                break;
+            default:  // {{{3
+                break;
+            }
+            if (!runner.ran[i]) {  // e.g. Fixed2 at a size without a FixedGrid
+                cout << setw(ColumnWidth) << "-";
+            }
+        }
+        // the errors of the interpolation orders {{{2
+        bool orders = false;
+        for (int i = 0; i < NBenchmarks; ++i) {
+            orders = orders || (runner.ran[i] && testOrder(i) > 0);
+        }
+        const auto errors = orders ? orderErrors(MapSize, MapSizeB, verifyPoints)
+                                   : Report::unknown<6>();
+
+        // print search timings {{{2
+        for (EnabledTests i = EnabledTests(0); i < NBenchmarks; ++i) {
+            if (i != Scalar && settings.tests[Scalar] && settings.tests[i]) {
+                runner.printRatio(Scalar, i);
+            }
+            if (runner.ran[i]) {
+                const int threads = testPooled(i) ? pool.size() : 1;
+                const int order = testOrder(i);
+                const double nan = std::numeric_limits<double>::quiet_NaN();
+                report.add({MapSize, MapSizeB, testName(i), threads, runner.mean[i],
+                            runner.stddev[i], runner.ratio(Scalar, i), nan, nan,
+                            runner.counts(i), runner.latency[i], runner.outliers[i],
+                            order ? errors[order - 1] : nan,
+                            order ? errors[order + 2] : nan});
+            }
+        }
+        cout << std::flush;
+
+        // verify equivalence {{{2
+        if (settings.verify) {
+            bool failed = false;
+            // kernels and bulk interfaces {{{3
+            // those selected by --tests, against the scalar AoS4 kernel
+            std::vector<Evaluation> evaluations;
+            const auto add = [&](EnabledTests test, Evaluation evaluation) {
+                if (settings.tests[test]) {
+                    evaluations.push_back(std::move(evaluation));
+                }
+            };
+            const auto pointwise = [&](EnabledTests test, const char *name,
+                                       const auto &map, float tolerance = 0.00001f) {
+                add(test, pointEvaluation(
+                              name, [&map](const Point2 &p) { return map.GetValue(p); },
+                              tolerance));
+            };
+            // the horizontal GetValue(Point2V), without prefetches
+            const auto horizontal = [&](EnabledTests test, const char *name,
+                                        const auto &map, float tolerance = 0.00001f) {
+                add(test, bulkEvaluation(
+                              name, [&map](auto... io) { evaluateBulk(map, io..., 0); },
+                              tolerance));
+            };
+            const auto bulk = [&](EnabledTests test, const char *name, const auto &map) {
+                add(test,
+                    bulkEvaluation(name, [&map](auto... io) { map.GetValues(io...); }));
+            };
+            const auto parallel = [&](EnabledTests test, const std::string &name,
+                                      const auto &map, float tolerance = 0.00001f) {
+                add(test, bulkEvaluation(
+                              name, [&](auto... io) { map.GetValues(io..., pool); },
+                              tolerance));
+            };
+            add(Alice, pointEvaluation("Alice", [&](const Point2 &p) {
+                    return spline.GetValue<AoS4::AliceKernel>(p);
+                }));
+            add(Autovectorized, pointEvaluation("Autovectorized", [&](const Point2 &p) {
+                    return spline.GetValue<AoS4::AutovecKernel>(p);
+                }));
+            add(Float16, pointEvaluation("Float16", [&](const Point2 &p) {
+                    return spline.GetValue<AoS4::Float16Kernel>(p);
+                }));
+            pointwise(Float4, "Float4", spline);
+            pointwise(Float12, "Float12", spline2);
+            pointwise(Float12Interleaved, "Float12Interleaved", spline3);
+            pointwise(CoefficientsLayout, "Coefficients", spline4, CoefficientsTolerance);
+            pointwise(Float12Tiled, "Float12Tiled", spline5);
+            pointwise(Int16, "Int16", spline6i, Int16Tolerance);
+            pointwise(Half, "Half", spline6h, HalfTolerance);
+            horizontal(Horizontal1, "Horizontal1", spline);
+            horizontal(Horizontal2, "Horizontal2", spline2);
+            horizontal(Horizontal3, "Horizontal3", spline3);
+            horizontal(Horizontal4, "Horizontal4", spline4, CoefficientsTolerance);
+            horizontal(Horizontal5, "Horizontal5", spline5);
+            horizontal(HorizontalInt16, "HorizontalInt16", spline6i, Int16Tolerance);
+            horizontal(HorizontalHalf, "HorizontalHalf", spline6h, HalfTolerance);
+            bulk(Bulk1, "Bulk1", spline);
+            bulk(Bulk2, "Bulk2", spline2);
+            bulk(Bulk3, "Bulk3", spline3);
+            horizontal(Bulk1NoPrefetch, "Bulk1 D=0", spline);
+            // further ahead than the n points of a small batch as well
+            for (const std::size_t distance : {1, 16, 1000}) {
+                const auto far = [&, distance](auto... io) {
+                    evaluateBulk(spline, io..., distance);
+                };
+                add(Bulk1FarPrefetch,
+                    bulkEvaluation("Bulk1 D=" + std::to_string(distance), far));
+            }
+            parallel(Parallel1, "Parallel1", spline);
+            parallel(Parallel2, "Parallel2", spline2);
+            parallel(Parallel3, "Parallel3", spline3);
+            add(Binned1, bulkEvaluation("Binned1", [&](auto... io) {
+                    binning.GetValues(spline, io...);
+                }));
+            add(Binned2, bulkEvaluation("Binned2", [&](auto... io) {
+                    binning.GetValues(spline2, io..., pool);
+                }));
+            add(Tuned, bulkEvaluation(
+                           std::string("Tuned ") + splineLayoutName(tuned.GetLayout()),
+                           [&](auto... io) { tuned.GetValues(io...); },
+                           layoutTolerance(tuned.GetLayout())));
+            // every layout with the kernels of every target the CPU supports
+            std::vector<std::unique_ptr<SplineInterface>> targetMaps;
+            if (settings.tests[Dispatched]) {
+                for (const auto &target : supportedSplineTargets()) {
+                    for (const auto layout : AllLayouts) {
+                        targetMaps.push_back(makeSpline(target, layout, -1.f, 1.f,
+                                                        MapSize, -1.f, 1.f, MapSizeB));
+                        SplineInterface &map = *targetMaps.back();
+                        for (int k = 0; k < map.GetNPoints(); ++k) {
+                            map.Fill(k, knots[k].data());
                         }
+                        parallel(Dispatched,
+                                 "Dispatched " + target + ' ' + splineLayoutName(layout),
+                                 map, layoutTolerance(layout));
+                    }
+                }
+            }
+            failed = failed || !verifyEvaluations(spline, verifyPoints, evaluations);
+            // gradient {{{3
+            if (settings.tests[Gradient] || settings.tests[HorizontalGradient]) {
+                const float scale = 0.5f * (std::max(MapSize, MapSizeB) - 1);
+                failed = failed || !verifyDifferences(spline, verifyPoints, scale);
+                const auto verify = [&](const char *name, const auto &map,
+                                        float tolerance = 0.00001f) {
+                    failed = failed || !verifyGradient(name, spline, map, verifyPoints,
+                                                       scale, tolerance);
+                };
+                verify("AoS4", spline);
+                verify("SoA", spline2);
+                verify("AoS3", spline3);
+                verify("Coefficients", spline4, CoefficientsTolerance);
+                verify("Morton", spline5);
+                verify("Int16", spline6i, Int16Tolerance);
+                verify("Half", spline6h, HalfTolerance);
+            }
+            // N components {{{3
+            if (settings.tests[Packed1] || settings.tests[Packed3] ||
+                settings.tests[Packed8]) {
+                const float scale = 0.5f * (std::max(MapSize, MapSizeB) - 1);
+                const auto verify = [&](const char *name, const auto &map) {
+                    failed = failed ||
+                             !verifyComponents(name, spline, map, verifyPoints, scale);
+                };
+                verify("Packed1", packed1);
+                verify("Packed3", packed3);
+                verify("Packed8", packed8);
+            }
+            // interpolation orders {{{3
+            failed = failed || !verifyOrders<AoS4>("AoS4", MapSize, verifyPoints) ||
+                     !verifyOrders<SoA>("SoA", MapSize, verifyPoints) ||
+                     !verifyOrders<AoS3>("AoS3", MapSize, verifyPoints) ||
+                     // the functions of up to 6 scaled into the range of [-1, 1]
+                     !verifyOrders<Quantized<Int16Knot>>("Int16", MapSize, verifyPoints,
+                                                         0.125f) ||
+                     !verifyOrders<Quantized<HalfKnot>>("Half", MapSize, verifyPoints,
+                                                        0.125f, 0.001f) ||
+                     !verifyOrders<Packed<1>>("Packed1", MapSize, verifyPoints) ||
+                     !verifyOrders<Packed<8>>("Packed8", MapSize, verifyPoints);
+            // fixed grids {{{3
+            withFixedGrid(MapSize, MapSizeB, [&](const auto &grid) {
+                const auto fixed = makeFixedSpline(grid, knots);
+                const auto fixedAoS4 = makeFixedSpline<AoS4>(grid, knots);
+                failed = failed || !verifyFixed("SoA", spline2, *fixed, verifyPoints) ||
+                         !verifyFixed("AoS4", spline, *fixedAoS4, verifyPoints);
+            });
+            // map groups {{{3
+            if (settings.tests[Separate4] || settings.tests[Group4] ||
+                settings.tests[Packed12]) {
+                const float scale = 0.5f * (std::max(MapSize, MapSizeB) - 1);
+                const auto verify = [&](const char *name, const auto &map) {
+                    return verifyComponents(name, spline, map, verifyPoints, scale);
+                };
+                failed = failed || !verify("Group4", group4) ||
+                         !verify("Packed12", packed12) ||
+                         !verifyGroup(separate, group4, verifyPoints);
+            }
+            // precision {{{3
+            if (settings.tests[PlanesFloat] || settings.tests[PlanesMixed] ||
+                settings.tests[PlanesDouble]) {
+                const float scale = 0.5f * (std::max(MapSize, MapSizeB) - 1);
+                const auto verify = [&](const char *name, const auto &map) {
+                    failed = failed ||
+                             !verifyPrecision(name, spline, map, verifyPoints, scale);
+                };
+                verify("PlanesF", planesF);
+                verify("PlanesM", planesM);
+                verify("PlanesD", planesD);
+            }
+            // trivariate {{{3
+            if (settings.tests[Volume] || settings.tests[Volume2]) {
+                const auto &points = searchPoints3;
+                failed = failed ||
+                         !verifyLinear<AoS4Volume>("AoS4Volume", VolumeSize, points) ||
+                         !verifyLinear<SoAVolume>("SoAVolume", VolumeSize, points) ||
+                         !verifyVolume("AoS4Volume", volume, volume, points, pool) ||
+                         !verifyVolume("SoAVolume", volume, volume2, points, pool);
+            }
+            // index range and memory footprint {{{3
+            {
+                failed = failed || !verifyWideIndex(spline2, verifyPoints);
+                // the maps beyond the index range of the layout are not created
+                const int wide = (MaxIndex >> 16) / 8;  // the most B knots of Packed8
+                if (createSpline<AoS4>(-1.f, 1.f, 1 << 16, -1.f, 1.f, 1 << 16) ||
+                    createSpline<Packed<8>>(-1.f, 1.f, 1 << 16, -1.f, 1.f, wide + 1) ||
+                    !Spline<Packed<8>>::FitsIndex(1 << 16, wide) ||
+                    makeSpline(SplineLayout::SoA, -1.f, 1.f, 1 << 16, -1.f, 1.f,
+                               1 << 16) ||
+                    !createSpline<AoS4>(-1.f, 1.f, MapSize, -1.f, 1.f, MapSizeB) ||
+                    createSpline<AoS4>(std::vector<float>{0.f, 1.f, 2.f},
+                                       std::vector<float>{0.f, 1.f, 2.f, 3.f}) ||
+                    !Spline<SoA>::FitsIndex(1 << 13, 1 << 13) ||
+                    Spline<Coefficients>::FitsIndex(1 << 13, 1 << 13) ||
+                    Spline<Morton>::FitsIndex(1 << 15, 1 << 15)) {
+                    std::cout << "\nthe index range of the grids is not enforced";
+                    failed = true;
+                }
+                const auto verifyBytes = [&](const char *name, const auto &map,
+                                             std::size_t bytes) {
+                    if (map.GetMapSize() != bytes) {
+                        std::cout << '\n' << name << " map size " << map.GetMapSize()
+                                  << " instead of " << bytes;
+                        failed = true;
                     }
-                }  //{{{3
+                };
+                const auto verify = [&](const char *name, const auto &map,
+                                        std::size_t bytesPerKnot) {
+                    verifyBytes(name, map, bytesPerKnot * map.GetNPoints());
+                };
+                verify("AoS4", spline, 16);
+                verify("SoA", spline2, 12);
+                verify("AoS3", spline3, 12);
+                verify("Int16", spline6i, 6);
+                verify("Half", spline6h, 6);
+                verify("Packed1", packed1, 4);
+                verify("Packed3", packed3, 16);
+                verify("Packed8", packed8, 32);
+                verify("PlanesF", planesF, 12);
+                verify("PlanesD", planesD, 24);
+                verify("Group4", group4, 64);
+                // the knots and the 16 coefficients of every cell; the knots padded to
+                // the 16x16 tiles
+                const std::size_t cells = std::size_t(MapSize - 3) * (MapSizeB - 3);
+                const std::size_t tiles =
+                    std::size_t((MapSize + 15) / 16) * ((MapSizeB + 15) / 16);
+                verifyBytes("Coefficients", spline4,
+                            16 * spline4.GetNPoints() + 256 * cells);
+                verifyBytes("Morton", spline5, 12 * 256 * tiles);
+            }
+            // non-uniform grids {{{3
+            failed = failed ||
+                     !verifyNonUniform(spline, MapSize, MapSizeB, knots, verifyPoints);
+            // map files {{{3
+            {
+                const auto &points = searchPoints;
+                failed = failed || !verifyMapFile<SoA>("AoS4", spline, points) ||
+                         !verifyMapFile<AoS4>("SoA", spline2, points) ||
+                         !verifyMapFile<Packed<3>>("AoS3", spline3, points) ||
+                         !verifyMapFile<Morton>("Coefficients", spline4, points) ||
+                         !verifyMapFile<Coefficients>("Morton", spline5, points) ||
+                         !verifyMapFile<Quantized<HalfKnot>>("Int16", spline6i, points) ||
+                         !verifyMapFile<Quantized<Int16Knot>>("Half", spline6h, points) ||
+                         !verifyMapFile<Packed<3>>("Packed8", packed8, points) ||
+                         !verifyMapFile<AoS3>("Packed3", packed3, points) ||
+                         !verifyMapFile<Packed<12>>("Group4", group4, points);
             }
+            // hot swap {{{3
+            failed = failed || !verifyMapHandle(MapSize, verifyPoints);
+            // thread pool {{{3
+            failed = failed || !verifyThreadPool(pool);
+            // vector Fill {{{3
+            failed = failed ||
+                     !verifyFill<AoS4>("AoS4", MapSize, verifyPoints, pool) ||
+                     !verifyFill<SoA>("SoA", MapSize, verifyPoints, pool) ||
+                     !verifyFill<AoS3>("AoS3", MapSize, verifyPoints, pool) ||
+                     !verifyFill<Coefficients>("Coefficients", MapSize, verifyPoints,
+                                               pool, CoefficientsTolerance) ||
+                     !verifyFill<Morton>("Morton", MapSize, verifyPoints, pool) ||
+                     !verifyFill<Quantized<Int16Knot>>("Int16", MapSize, verifyPoints,
+                                                       pool) ||
+                     !verifyFill<Quantized<HalfKnot>>("Half", MapSize, verifyPoints,
+                                                      pool) ||
+                     !verifyFill<Packed<3>>("Packed3", MapSize, verifyPoints, pool) ||
+                     !verifyFill<Group<1>>("Group1", MapSize, verifyPoints, pool);
+            //}}}3
             if (failed) {
                 //std::cout << '\n' << spline. << '\n';
                 return 1;
@@ -458,6 +3095,36 @@ int Vc_CDECL main()  // {{{1
             }
         }
         cout << std::endl;
+        if (orders) {
+            cout << setw(12) << "" << " max. error linear " << setprecision(3)
+                 << errors[0] << ", quadratic " << errors[1] << ", cubic " << errors[2]
+                 << '\n' << setw(12) << "" << " interior cells linear " << errors[3]
+                 << ", quadratic " << errors[4] << ", cubic " << errors[5] << '\n';
+        }
+        // print the latencies and hardware events {{{2
+        for (int i = 0; i < NBenchmarks && (settings.latency || counters); ++i) {
+            if (!runner.ran[i]) {
+                continue;
+            }
+            cout << setw(30) << testName(i) << setprecision(3);
+            if (settings.latency) {
+                for (const double x : runner.latency[i]) {
+                    cout << setw(9) << x;
+                }
+                cout << setw(9) << runner.outliers[i];
+            }
+            if (counters) {
+                cout << setw(10) << runner.mean[i] * tscNs;
+                for (const double x : runner.counts(i)) {
+                    cout << setw(14) << x;
+                }
+            }
+            cout << '\n';
+        }
+        if (!report.good()) {
+            std::cerr << "cannot write the CSV or JSON file\n";
+            return 1;
+        }
     }
     return 0;
 }  // }}}1
@@ -0,0 +1,202 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#include "mapfile.h"
+#include <cstring>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char MapFileMagic[8] = {'V', 'c', 'S', 'p', 'l', 'i', 'n', 'e'};
+constexpr std::uint32_t MapFileByteOrder = 0x01020304;
+
+/** the array record in front of the data */
+struct ArrayRecord {
+    std::uint64_t fElementSize;
+    std::uint64_t fCount;
+};
+
+std::size_t alignedOffset(std::size_t offset)
+{
+    return (offset + MapFileAlignment - 1) / MapFileAlignment * MapFileAlignment;
+}
+}  // namespace
+
+MapFileHeader makeMapFileHeader(const char *layout, int components)  //{{{1
+{
+    MapFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.fMagic, MapFileMagic, sizeof(MapFileMagic));
+    header.fVersion = MapFileVersion;
+    header.fByteOrder = MapFileByteOrder;
+    std::strncpy(header.fLayout, layout, sizeof(header.fLayout) - 1);
+    header.fComponents = components;
+    return header;
+}
+
+MappedFile::MappedFile(const std::string &path)  //{{{1
+    : fData(nullptr), fSize(0), fAllocation(nullptr), fOwned(true), fReadOnly(true)
+{
+#ifdef __linux__
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            fData = static_cast<char *>(data);
+            fSize = st.st_size;
+#ifdef MADV_HUGEPAGE
+            // fewer TLB misses of the stencil gathers, if the file system supports it
+            madvise(data, fSize, MADV_HUGEPAGE);
+#endif
+        }
+    }
+    close(fd);  // the mapping keeps the file
+#else
+    // no mmap: read the file into a buffer of the alignment of the arrays
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = in ? std::streamoff(in.tellg()) : 0;
+    if (size <= 0) {
+        return;
+    }
+    fAllocation = new char[size + MapFileAlignment];
+    char *data = fAllocation + (MapFileAlignment -
+                                reinterpret_cast<std::uintptr_t>(fAllocation) %
+                                    MapFileAlignment) % MapFileAlignment;
+    if (in.seekg(0) && in.read(data, size)) {
+        fData = data;
+        fSize = size;
+        fReadOnly = false;
+    }
+#endif
+}
+
+MappedFile::MappedFile(const void *data, std::size_t size)  //{{{1
+    : fData(static_cast<char *>(const_cast<void *>(data)))
+    , fSize(size)
+    , fAllocation(nullptr)
+    , fOwned(false)
+    , fReadOnly(true)
+{
+}
+
+MappedFile::~MappedFile()  //{{{1
+{
+#ifdef __linux__
+    if (fData && fOwned) {
+        munmap(fData, fSize);
+    }
+#endif
+    delete[] fAllocation;
+}
+
+MapReader::MapReader(const std::string &path)  //{{{1
+    : fFile(std::make_shared<const MappedFile>(path))
+    , fOffset(alignedOffset(sizeof(MapFileHeader)))
+    , fFailed(true)
+{
+    ReadHeader();
+}
+
+MapReader::MapReader(const void *data, std::size_t size)  //{{{1
+    : fFile(std::make_shared<const MappedFile>(data, size))
+    , fOffset(alignedOffset(sizeof(MapFileHeader)))
+    , fFailed(true)
+{
+    ReadHeader();
+}
+
+void MapReader::ReadHeader()  //{{{1
+{
+    std::memset(&fHeader, 0, sizeof(fHeader));
+    // the arrays are aligned relative to the start (the mappings of files are)
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(fFile->Data());
+    if (!fFile->Data() || begin % MapFileAlignment != 0 || fFile->Size() < fOffset) {
+        return;
+    }
+    std::memcpy(&fHeader, fFile->Data(), sizeof(fHeader));
+    fFailed = std::memcmp(fHeader.fMagic, MapFileMagic, sizeof(MapFileMagic)) != 0 ||
+              fHeader.fVersion != MapFileVersion ||
+              fHeader.fByteOrder != MapFileByteOrder;
+}
+
+void *MapReader::Next(std::size_t elementSize, std::size_t n)  //{{{1
+{
+    if (fFailed || fFile->Size() < fOffset + sizeof(ArrayRecord)) {
+        fFailed = true;
+        return nullptr;
+    }
+    ArrayRecord record;
+    std::memcpy(&record, fFile->Data() + fOffset, sizeof(record));
+    const std::size_t begin = alignedOffset(fOffset + sizeof(record));
+    if (record.fElementSize != elementSize || record.fCount != n ||
+        fFile->Size() < begin + elementSize * n) {
+        fFailed = true;
+        return nullptr;
+    }
+    fOffset = alignedOffset(begin + elementSize * n);
+    return fFile->Data() + begin;
+}
+
+MapWriter::MapWriter(const std::string &path, const MapFileHeader &header)  //{{{1
+    : fOut(path, std::ios::binary | std::ios::trunc)
+{
+    fOut.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    Align();
+}
+
+void MapWriter::Write(const void *data, std::size_t elementSize, std::size_t n)  //{{{1
+{
+    const ArrayRecord record = {elementSize, n};
+    fOut.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    Align();
+    fOut.write(static_cast<const char *>(data), elementSize * n);
+    Align();
+}
+
+void MapWriter::Align()  //{{{1
+{
+    static const char zeros[MapFileAlignment] = {};
+    if (!fOut) {
+        return;
+    }
+    const std::size_t offset = fOut.tellp();
+    fOut.write(zeros, alignedOffset(offset) - offset);
+}
+
+bool MapWriter::Close()  //{{{1
+{
+    fOut.close();
+    return !fOut.fail();
+}
+//}}}1
+
+// vim: foldmethod=marker
@@ -0,0 +1,257 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef MAPFILE_H_
+#define MAPFILE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Vc/Vc>
+#include <Vc/vector>
+
+/* The binary map format: a MapFileHeader, followed by the knots of a non-uniform grid and
+ * the arrays of the layout in the order of its Write. Every array is a record {element
+ * size, count} (two uint64) and its data at the next multiple of MapFileAlignment, thus
+ * the mapped arrays have the alignment of a cache line (and of every SIMD register). All
+ * values are in the byte order of the writer, a reader of the other byte order rejects
+ * the file.
+ */
+constexpr std::uint32_t MapFileVersion = 2;
+constexpr std::size_t MapFileAlignment = 64;
+
+struct MapFileHeader
+{
+    char fMagic[8];             // "VcSpline"
+    std::uint32_t fVersion;     // MapFileVersion
+    std::uint32_t fByteOrder;   // 0x01020304 in the byte order of the writer
+    char fLayout[32];           // Layout::FileTag(), 0 padded
+    std::int32_t fComponents;   // Layout::Components
+    std::int32_t fNA;           // N points A axis
+    std::int32_t fNB;           // N points B axis
+    float fMinA;                // min A axis
+    float fMinB;                // min B axis
+    float fStepA;               // step between points A axis
+    float fStepB;               // step between points B axis
+    std::int32_t fNonUniform;   // 1: the knots of A and B are the first two arrays
+};
+
+/** A header of the current version for the layout, the grid is left 0 */
+MapFileHeader makeMapFileHeader(const char *layout, int components);
+
+// MappedFile {{{1
+/* A read-only mapping of a whole file. The processes mapping the same file share its
+ * pages in the page cache, e.g. of a file in /dev/shm (the POSIX shared memory segments)
+ * written once by a loader. The mapping asks for transparent huge pages, which a tmpfs
+ * mounted with huge=advise (or shmem_enabled) provides.
+ *
+ * Or an external buffer, e.g. a shared memory segment (on huge pages) that the caller
+ * mapped and keeps mapped, of at least the alignment of the arrays (MapFileAlignment).
+ * The maps never write to either, a Fill copies their arrays first (see ReadOnly).
+ *
+ * Without mmap (not Linux) the file is read into an owned buffer of that alignment.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+    /** adopt the size bytes at data, the caller keeps them valid */
+    MappedFile(const void *data, std::size_t size);
+    ~MappedFile();
+
+    /** nullptr if the file could not be mapped */
+    char *Data() const { return fData; }
+    std::size_t Size() const { return fSize; }
+    /** true for the mapping and the buffer of the caller, false for the read buffer */
+    bool ReadOnly() const { return fReadOnly; }
+
+private:
+    /** copy constructor prohibited */
+    MappedFile(const MappedFile &);
+    /** assignment operator prohibited */
+    MappedFile &operator=(const MappedFile &);
+
+    char *fData;
+    std::size_t fSize;
+    char *fAllocation;  // the read buffer holding fData, or nullptr
+    bool fOwned;        // unmap fData
+    bool fReadOnly;
+};
+
+// KnotAllocator {{{1
+/* The allocator of the knot arrays. A default constructed KnotAllocator allocates with
+ * Vc::Allocator. The one of MapReader::Array adopts an array of a mapped file instead:
+ * allocate(n) of its n elements returns the mapped memory, the value initialization of
+ * the elements keeps the values of the file, and the mapping lives as long as the
+ * allocator (and thus the vector).
+ */
+template <typename T> class KnotAllocator
+{
+public:
+    typedef T value_type;
+    template <typename U> struct rebind {
+        typedef KnotAllocator<U> other;
+    };
+
+    KnotAllocator() : fData(nullptr), fN(0) {}
+    KnotAllocator(std::shared_ptr<const MappedFile> file, T *data, std::size_t n)
+        : fFile(std::move(file)), fData(data), fN(n)
+    {
+    }
+    /** the rebound allocators do not adopt the mapped array */
+    template <typename U> KnotAllocator(const KnotAllocator<U> &) : fData(nullptr), fN(0)
+    {
+    }
+
+    T *allocate(std::size_t n)
+    {
+        return fData && n == fN ? fData : Vc::Allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, std::size_t n)
+    {
+        if (p != fData) {
+            Vc::Allocator<T>().deallocate(p, n);
+        }
+    }
+
+    template <typename... Args> void construct(T *p, Args &&... args)
+    {
+        ::new (static_cast<void *>(p)) T(std::forward<Args>(args)...);
+    }
+    void construct(T *p)
+    {
+        if (!Adopts(p)) {
+            ::new (static_cast<void *>(p)) T();
+        }
+    }
+
+    /** a copy of the vector owns its elements */
+    KnotAllocator select_on_container_copy_construction() const { return {}; }
+
+    bool operator==(const KnotAllocator &rhs) const { return fData == rhs.fData; }
+    bool operator!=(const KnotAllocator &rhs) const { return fData != rhs.fData; }
+
+private:
+    bool Adopts(const T *p) const
+    {
+        return fData && !std::less<const T *>()(p, fData) &&
+               std::less<const T *>()(p, fData + fN);
+    }
+
+    std::shared_ptr<const MappedFile> fFile;  // keeps the mapping of fData alive
+    T *fData;                                 // the adopted array, or nullptr
+    std::size_t fN;                           // N elements of fData
+};
+
+template <typename T> using KnotVector = Vc::vector<T, KnotAllocator<T>>;
+
+// MapReader {{{1
+/* MapReader maps a map file (or reads a map in a buffer, see MappedFile) and hands out
+ * its arrays in the order of the layout's Write. A file that is missing, of another
+ * version or byte order, or truncated sets Failed(), as does an array that does not
+ * match the expected element size and count, and a buffer that is not aligned to
+ * MapFileAlignment.
+ */
+class MapReader
+{
+public:
+    explicit MapReader(const std::string &path);
+    MapReader(const void *data, std::size_t size);
+
+    bool Failed() const { return fFailed; }
+    const MapFileHeader &Header() const { return fHeader; }
+    /** the adopted arrays are read-only (see MappedFile) */
+    bool ReadOnly() const { return fFile->ReadOnly(); }
+
+    /** The next array, adopted from the mapping. Empty if it does not have n elements of
+     * type T. */
+    template <typename T> KnotVector<T> Array(std::size_t n);
+    /** Copy the next array to values, false if it does not have n elements of type T */
+    template <typename T> bool Read(T *values, std::size_t n);
+
+private:
+    /** read the header of fFile */
+    void ReadHeader();
+    /** The next array of n elements of the given size, nullptr on a mismatch */
+    void *Next(std::size_t elementSize, std::size_t n);
+
+    std::shared_ptr<const MappedFile> fFile;
+    MapFileHeader fHeader;
+    std::size_t fOffset;  // of the next array record
+    bool fFailed;
+};
+
+template <typename T> inline KnotVector<T> MapReader::Array(std::size_t n)
+{
+    if (T *data = static_cast<T *>(Next(sizeof(T), n))) {
+        return KnotVector<T>(n, KnotAllocator<T>(fFile, data, n));
+    }
+    return KnotVector<T>();
+}
+
+template <typename T> inline bool MapReader::Read(T *values, std::size_t n)
+{
+    if (const T *data = static_cast<const T *>(Next(sizeof(T), n))) {
+        std::copy(data, data + n, values);
+        return true;
+    }
+    return false;
+}
+
+// MapWriter {{{1
+/** MapWriter writes a map file, the layout's Write adds its arrays after the header */
+class MapWriter
+{
+public:
+    MapWriter(const std::string &path, const MapFileHeader &header);
+
+    template <typename T> void Write(const T *values, std::size_t n)
+    {
+        Write(values, sizeof(T), n);
+    }
+    template <typename T, typename A> void Write(const std::vector<T, A> &values)
+    {
+        Write(values.data(), sizeof(T), values.size());
+    }
+
+    /** Close the file, false if any of the writes failed */
+    bool Close();
+
+private:
+    void Write(const void *data, std::size_t elementSize, std::size_t n);
+    /** 0 bytes up to the next multiple of MapFileAlignment */
+    void Align();
+
+    std::ofstream fOut;
+};
+//}}}1
+
+#endif  // MAPFILE_H_
+
+// vim: foldmethod=marker
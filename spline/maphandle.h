@@ -0,0 +1,171 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef MAPHANDLE_H_
+#define MAPHANDLE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "cacheline.h"
+
+/* MapHandle publishes versions of a map to concurrent readers (read-copy-update). A
+ * writer builds and fills the next map off to the side and publishes it with an atomic
+ * pointer swap. Readers never lock or wait: a read pins the version it started on until
+ * it returns. publish waits for the reads that may still use the previous version
+ * (usually single evaluations, i.e. microseconds) and deletes it.
+ *
+ * Every reading thread uses its own Reader, which owns one of the maxReaders slots that
+ * publish scans. A read records the epoch it started in in its slot, publish advances
+ * the epoch after the swap and waits until no slot holds an older epoch.
+ *
+ * Map is any map type, e.g. Spline<Layout>, Spline3D<Layout> or SplineInterface.
+ */
+template <typename Map> class MapHandle
+{
+    struct Slot;
+
+public:
+    /** A handle for up to maxReaders concurrent Readers, starting with map */
+    explicit MapHandle(std::unique_ptr<const Map> map, unsigned maxReaders = 64);
+    /** No Reader may be reading */
+    ~MapHandle() { delete fMap.load(); }
+
+    /** The read side of one thread. Construction claims a slot of the handle, and waits
+     * for one to become free if all are in use. */
+    class Reader
+    {
+    public:
+        explicit Reader(MapHandle &handle);
+        ~Reader() { fSlot->used.store(false, std::memory_order_release); }
+
+        /** Call fun(const Map &) on the current version and return its result. The
+         * version stays valid until fun returns. Not reentrant, and fun must not publish
+         * to the handle (see publish). */
+        template <typename F>
+        auto read(F &&fun) -> decltype(fun(std::declval<const Map &>()));
+
+    private:
+        /** copy constructor prohibited */
+        Reader(const Reader &);
+        /** assignment operator prohibited */
+        Reader &operator=(const Reader &);
+
+        MapHandle &fHandle;
+        Slot *fSlot;
+    };
+
+    /** Replace the map. Returns when no read uses the previous version any more, after
+     * deleting it. Concurrent publishes are serialized. A publish of a thread inside a
+     * read deadlocks, as it waits for that read to return. */
+    void publish(std::unique_ptr<const Map> map);
+
+    /**  Get N of publishes so far */
+    std::uint64_t version() const { return fEpoch.load() - 1; }
+
+private:
+    /** copy constructor prohibited */
+    MapHandle(const MapHandle &);
+    /** assignment operator prohibited */
+    MapHandle &operator=(const MapHandle &);
+
+    struct alignas(CacheLineSize) Slot {  // one per cache line, no false sharing
+        std::atomic<std::uint64_t> epoch;  // of the running read, 0 if idle
+        std::atomic<bool> used;            // claimed by a Reader
+    };
+
+    const unsigned fNSlots;
+    CacheLineArray<Slot> fSlots;
+    std::atomic<const Map *> fMap;
+    std::atomic<std::uint64_t> fEpoch;  // starts at 1, incremented by every publish
+    std::mutex fPublish;
+};
+
+template <typename Map>  //{{{1
+inline MapHandle<Map>::MapHandle(std::unique_ptr<const Map> map, unsigned maxReaders)
+    : fNSlots(std::max(1u, maxReaders))
+    , fSlots(fNSlots)
+    , fMap(map.release())
+    , fEpoch(1)
+{
+    for (unsigned i = 0; i < fNSlots; ++i) {
+        fSlots[i].epoch.store(0, std::memory_order_relaxed);
+        fSlots[i].used.store(false, std::memory_order_relaxed);
+    }
+}
+
+template <typename Map>  //{{{1
+inline MapHandle<Map>::Reader::Reader(MapHandle &handle) : fHandle(handle), fSlot(nullptr)
+{
+    for (unsigned i = 0;; i = (i + 1) % handle.fNSlots) {
+        bool used = false;
+        if (handle.fSlots[i].used.compare_exchange_strong(used, true,
+                                                          std::memory_order_acquire)) {
+            fSlot = &handle.fSlots[i];
+            return;
+        }
+        if (i + 1 == handle.fNSlots) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+template <typename Map>  //{{{1
+template <typename F>
+inline auto MapHandle<Map>::Reader::read(F &&fun)
+    -> decltype(fun(std::declval<const Map &>()))
+{
+    // the slot is published before the map is loaded (both seq_cst): publish either sees
+    // this epoch, or the load of fMap comes after its swap
+    fSlot->epoch.store(fHandle.fEpoch.load());
+    struct Unpin {
+        Slot *slot;
+        ~Unpin() { slot->epoch.store(0, std::memory_order_release); }
+    } unpin = {fSlot};
+    return fun(*fHandle.fMap.load());
+}
+
+template <typename Map>  //{{{1
+inline void MapHandle<Map>::publish(std::unique_ptr<const Map> map)
+{
+    std::lock_guard<std::mutex> lock(fPublish);
+    const Map *old = fMap.exchange(map.release());
+    const std::uint64_t epoch = fEpoch.fetch_add(1) + 1;
+    // wait for the reads that started before the swap
+    for (unsigned i = 0; i < fNSlots; ++i) {
+        for (std::uint64_t e = fSlots[i].epoch.load(); e != 0 && e < epoch;
+             e = fSlots[i].epoch.load()) {
+            std::this_thread::yield();
+        }
+    }
+    delete old;
+}
+//}}}1
+
+#endif  // MAPHANDLE_H_
+
+// vim: foldmethod=marker
@@ -0,0 +1,254 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "../tsc.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/** The nanoseconds per TimeStampCounter cycle, measured against steady_clock over about
+ * the given time */
+inline double tscNanoseconds(std::chrono::milliseconds duration)
+{
+    TimeStampCounter tsc;
+    const auto begin = std::chrono::steady_clock::now();
+    tsc.start();
+    std::this_thread::sleep_for(duration);
+    tsc.stop();
+    const std::chrono::duration<double, std::nano> ns =
+        std::chrono::steady_clock::now() - begin;
+    return ns.count() / tsc.cycles();
+}
+
+/* PerfCounters counts the hardware events of the calling thread between start and stop,
+ * in user space only, with one counter group of perf_event_open (Linux). The counters
+ * the CPU, the kernel (perf_event_paranoid) or a virtual machine do not provide are
+ * missing, their count is NaN. The counts are scaled to the full time if the kernel
+ * multiplexes the group with other users of the counters.
+ *
+ * A counter group only sees its own thread, thus the events of a ThreadPool are counted
+ * with one group per worker, PerfCounters(threads), which sums the counts of the groups.
+ */
+class PerfCounters
+{
+public:
+    enum Event { Instructions, Cycles, L1DMisses, LLCMisses, DTLBMisses, NEvents };
+
+    /** count the events of the calling thread */
+    PerfCounters();
+    /** count the events of the threads, by their currentThread(), e.g. of the workers of
+     * a ThreadPool */
+    explicit PerfCounters(const std::vector<int> &threads);
+    ~PerfCounters();
+
+    /** the id of the calling thread for PerfCounters(threads), 0 where it is unknown */
+    static int currentThread();
+
+    /** false if none of the counters of one of the threads could be opened */
+    bool available() const;
+    static const char *name(Event e)
+    {
+        static const char *const names[NEvents] = {"instructions", "cycles", "L1D misses",
+                                                   "LLC misses", "dTLB misses"};
+        return names[e];
+    }
+
+    /** reset and start counting */
+    void start();
+    /** stop counting and read the counts */
+    void stop();
+    /** the count of e between start and stop, NaN if the counter is missing */
+    double count(Event e) const { return fCount[e]; }
+
+private:
+    /** copy constructor prohibited */
+    PerfCounters(const PerfCounters &);
+    /** assignment operator prohibited */
+    PerfCounters &operator=(const PerfCounters &);
+
+    /** open the counter group of the thread, 0 for the calling thread */
+    void open(int thread);
+
+    struct Group {
+        int fd[NEvents];  // -1 if missing
+        int leader;       // fd of the first counter opened, -1 if none
+    };
+    std::vector<Group> fGroups;  // one per thread
+    double fCount[NEvents];      // of the last start-stop, the sum over the threads
+};
+
+inline PerfCounters::PerfCounters()  //{{{1
+{
+    open(0);
+}
+
+inline PerfCounters::PerfCounters(const std::vector<int> &threads)  //{{{1
+{
+    for (int e = 0; e < NEvents; ++e) {
+        fCount[e] = std::numeric_limits<double>::quiet_NaN();
+    }
+    for (int thread : threads) {
+        open(thread);
+    }
+}
+
+inline bool PerfCounters::available() const  //{{{1
+{
+    for (const auto &group : fGroups) {
+        if (group.leader < 0) {
+            return false;
+        }
+    }
+    return !fGroups.empty();
+}
+
+#ifdef __linux__
+inline int PerfCounters::currentThread()  //{{{1
+{
+    return int(syscall(SYS_gettid));
+}
+
+inline void PerfCounters::open(int thread)  //{{{1
+{
+    const auto miss = [](std::uint64_t id, std::uint64_t op) {
+        return id | op << 8 | std::uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16;
+    };
+    const auto l1d = miss(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ);
+    const auto dtlb = miss(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ);
+    const struct {
+        std::uint32_t type;
+        std::uint64_t config;
+    } events[NEvents] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HW_CACHE, l1d},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, dtlb}};
+    Group group;
+    group.leader = -1;
+    for (int e = 0; e < NEvents; ++e) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[e].type;
+        attr.config = events[e].config;
+        attr.disabled = group.leader < 0;  // the members follow the leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        group.fd[e] = syscall(__NR_perf_event_open, &attr, thread, -1, group.leader, 0);
+        if (group.leader < 0) {
+            group.leader = group.fd[e];
+        }
+        fCount[e] = std::numeric_limits<double>::quiet_NaN();
+    }
+    fGroups.push_back(group);
+}
+
+inline PerfCounters::~PerfCounters()  //{{{1
+{
+    for (const auto &group : fGroups) {
+        for (int fd : group.fd) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+}
+
+inline void PerfCounters::start()  //{{{1
+{
+    for (const auto &group : fGroups) {
+        if (group.leader >= 0) {
+            ioctl(group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+inline void PerfCounters::stop()  //{{{1
+{
+    for (const auto &group : fGroups) {
+        if (group.leader >= 0) {
+            ioctl(group.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+    // the sum over the groups, NaN where a counter of one of them is missing
+    for (int e = 0; e < NEvents; ++e) {
+        fCount[e] = fGroups.empty() ? std::numeric_limits<double>::quiet_NaN() : 0;
+    }
+    for (const auto &group : fGroups) {
+        // {nr, time enabled, time running, the values in the order the counters were
+        // opened}
+        std::uint64_t data[3 + NEvents];
+        const auto size = group.leader >= 0 ? read(group.leader, data, sizeof(data)) : 0;
+        const std::size_t n = size > 0 ? size / sizeof(data[0]) : 0;
+        std::size_t k = 3;
+        for (int e = 0; e < NEvents; ++e) {
+            if (group.fd[e] >= 0 && k < n && data[2] > 0) {
+                fCount[e] += double(data[k]) * data[1] / data[2];
+            } else {
+                fCount[e] = std::numeric_limits<double>::quiet_NaN();
+            }
+            if (group.fd[e] >= 0) {
+                ++k;
+            }
+        }
+    }
+}
+#else
+inline int PerfCounters::currentThread() { return 0; }
+inline void PerfCounters::open(int)  //{{{1
+{
+    Group group;
+    group.leader = -1;
+    for (int e = 0; e < NEvents; ++e) {
+        group.fd[e] = -1;
+        fCount[e] = std::numeric_limits<double>::quiet_NaN();
+    }
+    fGroups.push_back(group);
+}
+inline PerfCounters::~PerfCounters() {}
+inline void PerfCounters::start() {}
+inline void PerfCounters::stop() {}
+#endif
+//}}}1
+
+#endif  // PERFCOUNTERS_H_
+
+// vim: foldmethod=marker
@@ -0,0 +1,207 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef POINTBINNING_H_
+#define POINTBINNING_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+#include "spline.h"
+
+/* PointBinning is an optional stage in front of the bulk GetValues of the maps: it sorts
+ * the query points by bin with a counting sort, evaluates the map on the sorted points and
+ * scatters the results back into the order of the input. With one bin per cell of the map,
+ * consecutive points then share their knots, which trades an O(n) sort for the cache
+ * misses of random queries on maps that do not fit into the cache.
+ * The sorted copies of the points and results are kept between calls, thus an object must
+ * not be used by several threads at the same time.
+ */
+class PointBinning
+{
+public:
+    /** nBinsA x nBinsB bins of equal size, points outside of the range go to the nearest
+     * bin at the edge */
+    PointBinning(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB);
+
+    /** Same as map.GetValues(...), but evaluated on the points sorted by bin */
+    template <typename Map>
+    void GetValues(const Map &map, const Point2 *ab, Point3 *xyz, std::size_t n);
+    template <typename Map>
+    void GetValues(const Map &map, const float *a, const float *b, float *x, float *y,
+                   float *z, std::size_t n);
+    template <typename Map>
+    void GetValues(const Map &map, const Point2 *ab, Point3 *xyz, std::size_t n,
+                   ThreadPool &pool);
+    template <typename Map>
+    void GetValues(const Map &map, const float *a, const float *b, float *x, float *y,
+                   float *z, std::size_t n, ThreadPool &pool);
+
+    /**  Get N of bins */
+    int GetNBins() const { return fNA * fNB; }
+
+private:
+    /** copy constructor prohibited */
+    PointBinning(const PointBinning &);
+    /** assignment operator prohibited */
+    PointBinning &operator=(const PointBinning &);
+
+    int Bin(float a, float b) const;
+    template <typename F> void SortOrder(std::size_t n, F &&pointBin);
+    void Sort(const Point2 *ab, std::size_t n);
+    void Sort(const float *a, const float *b, std::size_t n);
+    void Scatter(Point3 *xyz, std::size_t n) const;
+    void Scatter(float *x, float *y, float *z, std::size_t n) const;
+
+    const int fNA;        // N bins A axis
+    const int fNB;        // N bins B axis
+    const float fMinA;    // min A axis
+    const float fMinB;    // min B axis
+    const float fScaleA;  // inverse bin size A axis
+    const float fScaleB;  // inverse bin size B axis
+    std::vector<std::size_t> fStart;  // first sorted index of every bin, N bins + 1
+    std::vector<int> fBin;            // bin of every input point
+    std::vector<std::size_t> fOrder;  // input index of every sorted point
+    std::vector<Point2> fAB;          // sorted points, AoS
+    std::vector<Point3> fXYZ;         // results of the sorted points, AoS
+    std::vector<float> fA, fB;        // sorted points, SoA
+    std::vector<float> fX, fY, fZ;    // results of the sorted points, SoA
+};
+
+inline PointBinning::PointBinning(float minA, float maxA, int nBinsA, float minB,  //{{{1
+                                  float maxB, int nBinsB)
+    : fNA(nBinsA < 1 ? 1 : nBinsA)
+    , fNB(nBinsB < 1 ? 1 : nBinsB)
+    , fMinA(minA)
+    , fMinB(minB)
+    , fScaleA(fNA / ((maxA <= minA ? minA + 1 : maxA) - minA))
+    , fScaleB(fNB / ((maxB <= minB ? minB + 1 : maxB) - minB))
+    , fStart(fNA * fNB + 1)
+{
+}
+
+inline int PointBinning::Bin(float a, float b) const  //{{{1
+{
+    const int iA = std::min(std::max((a - fMinA) * fScaleA, 0.f), fNA - 1.f);
+    const int iB = std::min(std::max((b - fMinB) * fScaleB, 0.f), fNB - 1.f);
+    return iA * fNB + iB;
+}
+
+template <typename F>  //{{{1
+inline void PointBinning::SortOrder(std::size_t n, F &&pointBin)
+{
+    fBin.resize(n);
+    fOrder.resize(n);
+    std::fill(fStart.begin(), fStart.end(), 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        fBin[i] = pointBin(i);
+        ++fStart[fBin[i] + 1];
+    }
+    std::partial_sum(fStart.begin(), fStart.end(), fStart.begin());
+    for (std::size_t i = 0; i < n; ++i) {
+        fOrder[fStart[fBin[i]]++] = i;
+    }
+}
+
+inline void PointBinning::Sort(const Point2 *ab, std::size_t n)  //{{{1
+{
+    SortOrder(n, [&](std::size_t i) { return Bin(ab[i][0], ab[i][1]); });
+    fAB.resize(n);
+    fXYZ.resize(n);
+    for (std::size_t j = 0; j < n; ++j) {
+        fAB[j] = ab[fOrder[j]];
+    }
+}
+
+inline void PointBinning::Sort(const float *a, const float *b, std::size_t n)  //{{{1
+{
+    SortOrder(n, [&](std::size_t i) { return Bin(a[i], b[i]); });
+    fA.resize(n);
+    fB.resize(n);
+    fX.resize(n);
+    fY.resize(n);
+    fZ.resize(n);
+    for (std::size_t j = 0; j < n; ++j) {
+        fA[j] = a[fOrder[j]];
+        fB[j] = b[fOrder[j]];
+    }
+}
+
+inline void PointBinning::Scatter(Point3 *xyz, std::size_t n) const  //{{{1
+{
+    for (std::size_t j = 0; j < n; ++j) {
+        xyz[fOrder[j]] = fXYZ[j];
+    }
+}
+
+inline void PointBinning::Scatter(float *x, float *y, float *z, std::size_t n) const  //{{{1
+{
+    for (std::size_t j = 0; j < n; ++j) {
+        x[fOrder[j]] = fX[j];
+        y[fOrder[j]] = fY[j];
+        z[fOrder[j]] = fZ[j];
+    }
+}
+
+template <typename Map>  //{{{1
+inline void PointBinning::GetValues(const Map &map, const Point2 *ab, Point3 *xyz,
+                                    std::size_t n)
+{
+    Sort(ab, n);
+    map.GetValues(fAB.data(), fXYZ.data(), n);
+    Scatter(xyz, n);
+}
+
+template <typename Map>  //{{{1
+inline void PointBinning::GetValues(const Map &map, const float *a, const float *b,
+                                    float *x, float *y, float *z, std::size_t n)
+{
+    Sort(a, b, n);
+    map.GetValues(fA.data(), fB.data(), fX.data(), fY.data(), fZ.data(), n);
+    Scatter(x, y, z, n);
+}
+
+template <typename Map>  //{{{1
+inline void PointBinning::GetValues(const Map &map, const Point2 *ab, Point3 *xyz,
+                                    std::size_t n, ThreadPool &pool)
+{
+    Sort(ab, n);
+    map.GetValues(fAB.data(), fXYZ.data(), n, pool);
+    Scatter(xyz, n);
+}
+
+template <typename Map>  //{{{1
+inline void PointBinning::GetValues(const Map &map, const float *a, const float *b,
+                                    float *x, float *y, float *z, std::size_t n,
+                                    ThreadPool &pool)
+{
+    Sort(a, b, n);
+    map.GetValues(fA.data(), fB.data(), fX.data(), fY.data(), fZ.data(), n, pool);
+    Scatter(x, y, z, n);
+}
+//}}}1
+
+#endif  // POINTBINNING_H_
+
+// vim: foldmethod=marker
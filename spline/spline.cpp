@@ -46,75 +46,50 @@ This work is derived from a class in ALICE with the following copyright notice:
 
 using namespace std;
 
-Spline::Spline(float minA, float maxA, int nBinsA, float minB, float maxB,  //{{{1
-               int nBinsB)
-    : fNA(nBinsA < 4 ? 4 : nBinsA)
-    , fNB(nBinsB < 4 ? 4 : nBinsB)
-    , fN(fNA * fNB)
-    , fMinA(minA)
-    , fMinB(minB)
-    , fStepA(((maxA <= minA ? minA + 1 : maxA) - minA) / (fNA - 1))
-    , fStepB(((maxB <= minB ? minB + 1 : maxB) - minB) / (fNB - 1))
-    , fScaleA(1.f / fStepA)
-    , fScaleB(1.f / fStepB)
-    , fXYZ(fN, DataPoint::Zero())
-{
-}
+AoS4::AoS4(const Grid &grid) : fXYZ(grid.fN, DataPoint::Zero()) {}  //{{{1
 
-// spline 3-st order,  4 points, da = a - point 1 {{{1
-template <typename T> static inline T GetSpline3(T v0, T v1, T v2, T v3, T x)
+AoS4::AoS4(const Grid &grid, MapReader &reader)  //{{{1
+    : fXYZ(reader.Array<DataPoint>(grid.fN))
 {
-    const T dv = v2 - v1;
-    const T z0 = 0.5f * (v2 - v0);
-    const T z1 = 0.5f * (v3 - v1);
-    return (x * x) * ((z1 - dv) * (x - 1) + (z0 - dv) * (x - 2)) + (z0 * x + v1);
-    //return x * x * ((z1 - dv + z0 - dv) * (x - 1) - (z0 - dv)) + z0 * x + v1;
 }
 
-template <typename T> static inline T GetSpline3(const T *v, T x)
+Point3 AoS4::GetValue(const Grid &grid, Point2 ab) const  //{{{1
 {
-    return GetSpline3(v[0], v[1], v[2], v[3], x);
-}
-
-Point3 Spline::GetValue(Point2 ab) const  //{{{1
-{
-    float da1, db1;
+    StencilPosition<float> da1, db1;
     int iA, iB;
-    std::tie(iA, iB, da1, db1) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
-    int ind = iA * fNB + iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+    int ind = iA * grid.fNB + iB;
 
     typedef Vc::SimdArray<float, 4> float4;
-    const float4 da = da1;
-    const float4 db = db1;
+    const StencilPosition<float4> da = da1;
+    const StencilPosition<float4> db = db1;
 
     float4 v[4];
     const float4 *m = &fXYZ[0];
 
     for (int i = 0; i < 4; i++) {
         v[i] = GetSpline3(m[ind + 0], m[ind + 1], m[ind + 2], m[ind + 3], db);
-        ind += fNB;
+        ind += grid.fNB;
     }
     float4 res = GetSpline3(v[0], v[1], v[2], v[3], da);
     return {{res[0], res[1], res[2]}};
 }
 
-Point3 Spline::GetValue16(Point2 ab) const  //{{{1
+Point3 AoS4::GetValue(Float16Kernel, const Grid &grid, Point2 ab) const  //{{{1
 {
-    float da1, db1;
+    StencilPosition<float> da1, db1;
     int iA, iB;
-    std::tie(iA, iB, da1, db1) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
 
     typedef Vc::SimdArray<float, 4> float4;
     typedef Vc::SimdArray<float, 16> float16;
-    const float4 da = da1;
-    const float16 db = db1;
+    const StencilPosition<float4> da = da1;
+    const StencilPosition<float16> db = db1;
 
-    const float4 *m0 = &fXYZ[iA * fNB + iB];
-    const float4 *m1 = m0 + fNB;
-    const float4 *m2 = m1 + fNB;
-    const float4 *m3 = m2 + fNB;
+    const float4 *m0 = &fXYZ[iA * grid.fNB + iB];
+    const float4 *m1 = m0 + grid.fNB;
+    const float4 *m2 = m1 + grid.fNB;
+    const float4 *m3 = m2 + grid.fNB;
     const float16 v0123 =
         GetSpline3(Vc::simd_cast<float16>(m0[0], m1[0], m2[0], m3[0]),
                    Vc::simd_cast<float16>(m0[1], m1[1], m2[1], m3[1]),
@@ -126,13 +101,12 @@ Point3 Spline::GetValue16(Point2 ab) const  //{{{1
     return {{res[0], res[1], res[2]}};
 }
 
-Point3 Spline::GetValueScalar(Point2 ab) const  //{{{1
+Point3 AoS4::GetValue(ScalarKernel, const Grid &grid, Point2 ab) const  //{{{1
 {
-    float da, db;
+    StencilPosition<float> da, db;
     int iA, iB;
-    std::tie(iA, iB, da, db) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
-    int ind = iA * fNB + iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    int ind = iA * grid.fNB + iB;
 
     float vx[4];
     float vy[4];
@@ -144,18 +118,17 @@ Point3 Spline::GetValueScalar(Point2 ab) const  //{{{1
                            fXYZ[ind + 3][1], db);
         vz[i] = GetSpline3(fXYZ[ind][2], fXYZ[ind + 1][2], fXYZ[ind + 2][2],
                            fXYZ[ind + 3][2], db);
-        ind += fNB;
+        ind += grid.fNB;
     }
     return {{GetSpline3(vx, da), GetSpline3(vy, da), GetSpline3(vz, da)}};
 }
 
-Point3 Spline::GetValueAutovec(Point2 ab) const  //{{{1
+Point3 AoS4::GetValue(AutovecKernel, const Grid &grid, Point2 ab) const  //{{{1
 {
-    float da, db;
+    StencilPosition<float> da, db;
     int iA, iB;
-    std::tie(iA, iB, da, db) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
-    int ind = iA * fNB + iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    int ind = iA * grid.fNB + iB;
 
     float vx[4];
     float vy[4];
@@ -166,57 +139,89 @@ Point3 Spline::GetValueAutovec(Point2 ab) const  //{{{1
         vx[i] = GetSpline3(m[ind4 + 0], m[ind4 + 4], m[ind4 + 8], m[ind4 + 12], db);
         vy[i] = GetSpline3(m[ind4 + 1], m[ind4 + 5], m[ind4 + 9], m[ind4 + 13], db);
         vz[i] = GetSpline3(m[ind4 + 2], m[ind4 + 6], m[ind4 + 10], m[ind4 + 14], db);
-        ind += fNB;
+        ind += grid.fNB;
     }
     return {{GetSpline3(vx, da), GetSpline3(vy, da), GetSpline3(vz, da)}};
 }
 
-Point3V Spline::GetValue(const Point2V &ab) const  //{{{1
+Point3 AoS4::GetValue(LinearKernel, const Grid &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    const float4 x = b.second;
+    const float4 *m0 = &fXYZ[a.first * grid.fNB + b.first];
+    const float4 *m1 = m0 + grid.fNB;
+    const float4 res = GetSpline1(GetSpline1(m0[0], m0[1], x),
+                                  GetSpline1(m1[0], m1[1], x), float4(a.second));
+    return {{res[0], res[1], res[2]}};
+}
+
+Point3 AoS4::GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    const float4 x = b.second;
+    const float4 *m = &fXYZ[a.first * grid.fNB + b.first];
+    float4 v[3];
+    for (int i = 0; i < 3; i++) {
+        v[i] = GetSpline2(m, x);
+        m += grid.fNB;
+    }
+    const float4 res = GetSpline2(v, float4(a.second));
+    return {{res[0], res[1], res[2]}};
+}
+
+std::tuple<Point3, Point3, Point3> AoS4::GetValueAndGradient(const Grid &grid,  //{{{1
+                                                             Point2 ab) const
 {
-    index_v iA, iB;
-    float_v da, db;
-    std::tie(iA, iB, da, db) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
-
-    float_v vx[4];
-    float_v vy[4];
-    float_v vz[4];
-    auto ind = iA * fNB + iB;
-    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    const float4 *m = &fXYZ[iA * grid.fNB + iB];
+    float4 v[4][4];
     for (int i = 0; i < 4; i++) {
-        float_v x[4], y[4], z[4];
-        Vc::tie(x[0], y[0], z[0]) = map[ind];
-        Vc::tie(x[1], y[1], z[1]) = map[ind + 1];
-        Vc::tie(x[2], y[2], z[2]) = map[ind + 2];
-        Vc::tie(x[3], y[3], z[3]) = map[ind + 3];
-        vx[i] = GetSpline3<float_v>(x[0], x[1], x[2], x[3], db);
-        vy[i] = GetSpline3<float_v>(y[0], y[1], y[2], y[3], db);
-        vz[i] = GetSpline3<float_v>(z[0], z[1], z[2], z[3], db);
-        ind += fNB;
+        for (int j = 0; j < 4; j++) {
+            v[i][j] = m[j];
+        }
+        m += grid.fNB;
     }
-    Point3V XYZ;
-    XYZ[0] = GetSpline3<float_v>(vx, da);
-    XYZ[1] = GetSpline3<float_v>(vy, da);
-    XYZ[2] = GetSpline3<float_v>(vz, da);
-    return XYZ;
+    const std::array<float4, 3> g = GetSpline3Gradient<float4>(v, da, db);
+    return std::make_tuple(Point3{{g[0][0], g[0][1], g[0][2]}},
+                           Point3{{g[1][0], g[1][1], g[1][2]}},
+                           Point3{{g[2][0], g[2][1], g[2][2]}});
 }
 
-// Point3 Spline::GetValueAlice(Point2 ab) const {{{1
+// Point3 AoS4::GetValue(AliceKernel, const Grid &grid, Point2 ab) const {{{1
 #ifdef Vc_GCC
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 __attribute__((optimize("no-tree-vectorize")))
 #endif
-Point3 Spline::GetValueAlice(Point2 ab) const
+Point3 AoS4::GetValue(AliceKernel, const Grid &grid, Point2 ab) const
 {
-    float lA = (ab[0] - fMinA) * fScaleA - 1.f;
+    if (!grid.IsUniform()) {  // the original computes the position of a uniform grid
+        return GetValue(grid, ab);
+    }
+    float lA = (ab[0] - grid.fMinA) * grid.fScaleA - 1.f;
     int iA = (int)lA;
     if (lA < 0) iA = 0;
-    else if (iA > fNA - 4) iA = fNA - 4;
+    else if (iA > grid.fNA - 4) iA = grid.fNA - 4;
 
-    float lB = (ab[1] - fMinB) * fScaleB - 1.f;
+    float lB = (ab[1] - grid.fMinB) * grid.fScaleB - 1.f;
     int iB = (int)lB;
     if (lB < 0) iB = 0;
-    else if (iB > fNB - 4) iB = fNB - 4;
+    else if (iB > grid.fNB - 4) iB = grid.fNB - 4;
 
     Point3 XYZ;
     if (Vc::float_v::Size == 4) {
@@ -224,12 +229,12 @@ Point3 Spline::GetValueAlice(Point2 ab) const
         Vc::float_v db = lB - iB;
 
         Vc::float_v v[4];
-        int ind = iA * fNB + iB;
+        int ind = iA * grid.fNB + iB;
         const Vc::float_v *m = reinterpret_cast<const Vc::float_v *>(&fXYZ[0]);
 
         for (int i = 0; i < 4; i++) {
             v[i] = GetSpline3(m[ind + 0], m[ind + 1], m[ind + 2], m[ind + 3], db);
-            ind += fNB;
+            ind += grid.fNB;
         }
         Vc::float_v res = GetSpline3(v[0], v[1], v[2], v[3], da);
         XYZ[0] = res[0];
@@ -242,14 +247,14 @@ Point3 Spline::GetValueAlice(Point2 ab) const
         float vx[4];
         float vy[4];
         float vz[4];
-        int ind = iA * fNB + iB;
+        int ind = iA * grid.fNB + iB;
         const float *m = reinterpret_cast<const float *>(&fXYZ[0]);
         for (int i = 0; i < 4; i++) {
             int ind4 = ind * 4;
             vx[i] = GetSpline3(m[ind4 + 0], m[ind4 + 4], m[ind4 + 8], m[ind4 + 12], db);
             vy[i] = GetSpline3(m[ind4 + 1], m[ind4 + 5], m[ind4 + 9], m[ind4 + 13], db);
             vz[i] = GetSpline3(m[ind4 + 2], m[ind4 + 6], m[ind4 + 10], m[ind4 + 14], db);
-            ind += fNB;
+            ind += grid.fNB;
         }
         XYZ[0] = GetSpline3(vx, da);
         XYZ[1] = GetSpline3(vy, da);
@@ -42,10 +42,24 @@ This work is derived from a class in ALICE with the following copyright notice:
 #define SPLINE_H_
 
 #include <utility>
+#include <algorithm>
 #include <array>
 #include <tuple>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
 #include <Vc/simdize>
 #include <Vc/vector>
+#include "cacheline.h"
+#include "threadpool.h"
+#include "mapfile.h"
 
 //* This file is property of and copyright by the ALICE HLT Project        *
 //* ALICE Experiment at CERN, All rights reserved.                         *
@@ -57,46 +71,172 @@ typedef std::array<float, 3> Point3;
 typedef Vc::simdize<Point2> Point2V;
 typedef Vc::simdize<Point3> Point3V;
 
-class Spline
+using Vc::float_v;
+typedef float_v::IndexType index_v;
+
+// index range {{{1
+/* The knot indexes of the stencils are int and index_v (32 bits), thus the N points of a
+ * grid are below 2^31. The layouts size their arrays and offset their planes in
+ * std::size_t, their gathers index the elements relative to a base with index_v: the
+ * interleaved layouts from the start of their array, i.e. up to 2^31 elements (e.g. 8
+ * GiB of floats for Packed). The vector kernels of SoA and SoAVolume gather all planes
+ * with one index vector while the planes fit the index range, else every plane from its
+ * own base (see SoA::WideIndexKernel).
+ *
+ * Every layout gives the elements its kernels index from one base, IndexedElements(nA,
+ * nB), and Spline only takes the grids for which they fit (see Spline::FitsIndex):
+ * loadSpline and createSpline return nullptr for the others, the constructors require
+ * them (assert). A grid never loses knots to the index range.
+ */
+constexpr std::int64_t MaxIndex = std::numeric_limits<int>::max();
+
+/** True if the gathers address n elements with the indexes of index_v */
+constexpr bool fitsIndex(std::int64_t n) { return n <= MaxIndex; }
+
+/** True if the N points of the grid fit int */
+inline bool fitsPoints(std::int64_t nA, std::int64_t nB) { return fitsIndex(nA * nB); }
+
+// StencilPosition {{{1
+/* The position x of a point in a stencil of 4 knots v0..v3 on one axis, relative to the
+ * step of its central cell (v1 to v2), and the weights of the Catmull-Rom tangents at its
+ * ends: t0 * (v2 - v0) and t1 * (v3 - v1) per step of the central cell. The weights are
+ * the ratio of the central step to the distance of the neighbours of the knot, i.e. 1/2
+ * on a uniform axis. Thus the splines of a non-uniform axis reproduce linear fields and
+ * their derivatives by x are continuous.
+ */
+template <typename T> struct StencilPosition {
+    StencilPosition() = default;
+    StencilPosition(T x, T t0, T t1) : fX(x), fT0(t0), fT1(t1) {}
+    /** the broadcast of a scalar position, e.g. to the SimdArrays of the horizontal
+     * kernels */
+    template <typename U>
+    StencilPosition(const StencilPosition<U> &p) : fX(p.fX), fT0(p.fT0), fT1(p.fT1)
+    {
+    }
+
+    T fX;   // position relative to knot 1
+    T fT0;  // weight of the tangent at knot 1
+    T fT1;  // weight of the tangent at knot 2
+};
+
+// KnotAxis {{{1
+/* KnotAxis holds the knot positions of a non-uniform axis. The lookup of the cell of x
+ * is O(1) and branch-free: a uniform table of bins, which are at most as wide as the
+ * narrowest step (up to 16 bins per step), stores the first cell of every bin. Then x is
+ * compared with the ends of the next fNSteps cells, usually 1.
+ *
+ * The position in the stencil is relative to the step of its central cell, and the
+ * tangent weights of the stencils are the ones of the non-uniform Catmull-Rom spline (see
+ * StencilPosition).
+ */
+class KnotAxis
 {
 public:
-    Spline(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB);
+    KnotAxis() = default;
+    /** The knots of the axis, at least 4, finite and strictly increasing */
+    explicit KnotAxis(std::vector<float> knots);
+
+    /** true if the knots are at least 4, finite and strictly increasing */
+    static bool IsValid(const std::vector<float> &knots);
+    /** the knots, which have to be IsValid (assert) */
+    static const std::vector<float> &Checked(const std::vector<float> &knots)
+    {
+        assert(IsValid(knots));
+        return knots;
+    }
+
+    bool Empty() const { return fKnots.empty(); }
+    /** the bytes of the arrays */
+    std::size_t GetMapSize() const;
+    const Vc::vector<float> &Knots() const { return fKnots; }
 
-    /**  Filling of points */
-    template <typename F> void Fill(F &&func);
-    /**  Filling of points */
-    void Fill(int ind, float x, float y, float z);
-    /**  Filling of points */
-    void Fill(int ind, const float XYZ[]);
+    float Knot(int i) const { return fKnots[i]; }
+    float_v Knot(const index_v &i) const { return float_v(&fKnots[0], i); }
+
+    /** The first knot of the stencil and the position relative to its second knot */
+    std::pair<int, StencilPosition<float>> Position(float x) const;
+    std::pair<index_v, StencilPosition<float_v>> Position(const float_v &x) const;
+
+    /** The tangent weights {t0, t1} of the stencil with the first knot i */
+    Point2 Tangents(int i) const { return {{fTangent0[i], fTangent1[i]}}; }
+
+    /** The derivative of the position by x */
+    float Scale(float x) const { return fInvStep[Stencil(x) + 1]; }
+    float_v Scale(const float_v &x) const
+    {
+        return float_v(&fInvStep[0], Stencil(x) + 1);
+    }
+
+private:
+    int Stencil(float x) const;
+    index_v Stencil(const float_v &x) const;
+
+    Vc::vector<float> fKnots;
+    Vc::vector<float> fUpper;    // upper end of every cell, +inf for the last one
+    Vc::vector<float> fInvStep;  // inverse width of every cell
+    Vc::vector<float> fTangent0;  // tangent weight t0 of every stencil
+    Vc::vector<float> fTangent1;  // tangent weight t1 of every stencil
+    Vc::vector<int> fTable;      // the first cell of every bin
+    float fMin = 0.f;            // lower end of the table
+    float fTableScale = 0.f;     // inverse bin width
+    float fMaxBin = 0.f;         // N bins - 1
+    int fNSteps = 0;             // max N of knots inside of a bin
+};
+
+// Grid {{{1
+/* The grid of knots that all layouts share. The point index of Fill and GetAB is
+ * iA * fNB + iB for every layout, the layouts map it to their own order of the knots.
+ *
+ * The grid is uniform or has the knot positions of every axis (see KnotAxis). Both
+ * give the same stencil and position to the layouts. fStepA and fStepB of a non-uniform
+ * grid are the mean steps.
+ */
+class Grid
+{
+public:
+    /** A uniform grid of at least 4 knots per axis, the N points fit int (see
+     * fitsPoints) */
+    Grid(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB);
+    /** A non-uniform grid, the knots of every axis are at least 4, finite and strictly
+     * increasing (see KnotAxis::IsValid, asserted). A uniform axis is given by its evenly
+     * spaced knots. The N points fit int. */
+    Grid(std::vector<float> knotsA, std::vector<float> knotsB);
+    /** The grid of a map file, with the exact steps or knots of the writer. The N points
+     * of the header fit int, see loadSpline. */
+    explicit Grid(MapReader &reader);
 
     /**  Get A,B by the point index */
     std::pair<float, float> GetAB(int ind) const;
 
-    /** Calculate interpolated value at the given point(s) */
-    Point3 GetValue(Point2) const;
-    Point3 GetValue16(Point2 ab) const;
-    Point3 GetValueScalar(Point2) const;
-    Point3 GetValueAutovec(Point2 ab) const;
-    Point3V GetValue(const Point2V &) const;
-    Point3 GetValueAlice(Point2 ab) const;
+    /**  Get the position of the knot with index i on the A/B axis */
+    float KnotA(int i) const { return fUniform ? fMinA + i * fStepA : fKnotsA.Knot(i); }
+    float KnotB(int i) const { return fUniform ? fMinB + i * fStepB : fKnotsB.Knot(i); }
+    float_v KnotA(const index_v &i) const;
+    float_v KnotB(const index_v &i) const;
 
-    /**  Get size of the grid */
-    int GetMapSize() const;
+    bool IsUniform() const { return fUniform; }
+    /** the bytes of the knots of a non-uniform grid, 0 for a uniform one */
+    std::size_t GetMapSize() const { return fKnotsA.GetMapSize() + fKnotsB.GetMapSize(); }
+    /** the knots of a non-uniform grid */
+    const KnotAxis &KnotsA() const { return fKnotsA; }
+    const KnotAxis &KnotsB() const { return fKnotsB; }
 
-    /**  Get N of point on the grid */
-    int GetNPoints() const;
+    /** The first knot of the 4x4 stencil and the position relative to its second knot */
+    std::tuple<int, int, StencilPosition<float>, StencilPosition<float>> Position(
+        Point2 ab) const;
+    std::tuple<index_v, index_v, StencilPosition<float_v>, StencilPosition<float_v>>
+    Position(const Point2V &ab) const;
 
-private:
-    /** copy constructor prohibited */
-    Spline(const Spline &);
-    /** assignment operator prohibited */
-    Spline &operator=(const Spline &);
+    /** The tangent weights of the stencils with the first knot i, see StencilPosition */
+    Point2 TangentsA(int i) const;
+    Point2 TangentsB(int i) const;
 
-    /** spline 2-nd order, 3 points, da = a - point 1 */
-    static float GetSpline2(float *v, float da);
+    /** The derivatives of the position by A and B, i.e. the inverse step at the point */
+    Point2 Scale(Point2 ab) const;
+    Point2V Scale(const Point2V &ab) const;
 
     const int fNA;        // N points A axis
-    const int fNB;        // N points A axis
+    const int fNB;        // N points B axis
     const int fN;         // N points total
     const float fMinA;    // min A axis
     const float fMinB;    // min B axis
@@ -104,48 +244,689 @@ private:
     const float fStepB;   // step between points B axis
     const float fScaleA;  // scale A axis
     const float fScaleB;  // scale B axis
-    typedef Vc::SimdArray<float, 4> DataPoint;
-    Vc::vector<DataPoint> fXYZ;  // array of points, {X,Y,Z,0} values
+
+private:
+    /** the N points of nA x nB knots, which have to fit int */
+    static int Points(std::int64_t nA, std::int64_t nB)
+    {
+        assert(fitsPoints(nA, nB));
+        return int(nA * nB);
+    }
+
+    KnotAxis fKnotsA;  // knots of a non-uniform A axis
+    KnotAxis fKnotsB;  // knots of a non-uniform B axis
+    bool fUniform;
 };
 
-inline void Spline::Fill(int ind, float x, float y, float z)
+// FixedGrid {{{1
+/* A uniform grid of NA x NB knots fixed at compile time, see FixedSpline. The N points
+ * are constants, thus the kernels that take the grid type as a template parameter (the
+ * SoA ones) fold the stride arithmetic of the stencil, e.g. iA + iB * fNA into a shift
+ * for a power of two. The range of the axes is a runtime value (no float template
+ * parameters), and the kernels that take a Grid use the runtime members.
+ */
+template <int NA, int NB> class FixedGrid : public Grid
 {
-    fXYZ[ind][0] = x;
-    fXYZ[ind][1] = y;
-    fXYZ[ind][2] = z;
+    static_assert(NA >= 4 && NB >= 4, "the stencil needs 4 knots per axis");
+
+public:
+    FixedGrid(float minA, float maxA, float minB, float maxB)
+        : Grid(minA, maxA, NA, minB, maxB, NB)
+    {
+    }
+
+    /** The stencil of the uniform grid, see Grid::Position */
+    std::tuple<int, int, StencilPosition<float>, StencilPosition<float>> Position(
+        Point2 ab) const;
+    std::tuple<index_v, index_v, StencilPosition<float_v>, StencilPosition<float_v>>
+    Position(const Point2V &ab) const;
+
+    Point2 Scale(Point2) const { return {{fScaleA, fScaleB}}; }
+    Point2V Scale(const Point2V &) const;
+
+    static constexpr int fNA = NA;      // N points A axis
+    static constexpr int fNB = NB;      // N points B axis
+    static constexpr int fN = NA * NB;  // N points total
+};
+
+template <int NA, int NB> constexpr int FixedGrid<NA, NB>::fNA;
+template <int NA, int NB> constexpr int FixedGrid<NA, NB>::fNB;
+template <int NA, int NB> constexpr int FixedGrid<NA, NB>::fN;
+
+// LayoutScalar {{{1
+/** The type of the values a layout evaluates in: Layout::Scalar, float if it has none */
+template <typename Layout, typename = void> struct LayoutScalar {
+    typedef float type;
+};
+template <typename Layout>
+struct LayoutScalar<Layout, typename std::conditional<true, void,
+                                                      typename Layout::Scalar>::type> {
+    typedef typename Layout::Scalar type;
+};
+
+/** True if the gradient kernels of the layout scale to the A and B axes themselves:
+ * Layout::ScaledGradient, false if it has none */
+template <typename Layout, typename = void> struct LayoutScalesGradient {
+    static constexpr bool value = false;
+};
+template <typename Layout>
+struct LayoutScalesGradient<
+    Layout, typename std::conditional<true, void,
+                                      decltype(Layout::ScaledGradient)>::type> {
+    static constexpr bool value = Layout::ScaledGradient;
+};
+
+/** The values of float_v::Size points: Vc::simdize<std::array<T, N>> for float, and
+ * SimdArrays of float_v::Size (i.e. several double_v) for double */
+template <typename T, int N>
+using SimdValue = typename std::conditional<
+    std::is_same<T, float>::value, Vc::simdize<std::array<T, N>>,
+    Vc::simdize<std::array<T, N>, float_v::Size>>::type;
+
+// interpolation orders {{{1
+/* The kernel tags of the lower interpolation orders, see Spline::GetValue<Kernel>. The
+ * linear kernel interpolates the 2x2 knots of the cell of the point, the quadratic one
+ * the 3x3 knots centered on the first knot of the cell (GetSpline2). Both interpolate
+ * the knots, thus they are continuous, but not their derivatives. The edge cells
+ * interpolate (instead of extrapolating the cubic of their neighbor like the 4x4
+ * stencil), beyond them the polynomials of the edge cells extrapolate. The quadratic
+ * kernel interpolates in the knot index, i.e. with the weights of a uniform axis.
+ */
+struct LinearKernel {};
+struct QuadraticKernel {};
+
+/** The first knot and the position of the lower orders on an axis of n knots, from the
+ * first knot i of the 4x4 stencil and the position d relative to its knot i + 1 (see
+ * Grid::Position). Linear: position relative to the first knot. Quadratic: relative to
+ * the second knot. */
+inline std::pair<int, float> linearStencil(int i, float d, int n)
+{
+    const int cell = std::min(std::max(i + 1 + int(std::floor(d)), 0), n - 2);
+    return std::make_pair(cell, d + float(i + 1 - cell));
+}
+
+inline std::pair<index_v, float_v> linearStencil(const index_v &i, const float_v &d,
+                                                 int n)
+{
+    const index_v cell = Vc::min(
+        Vc::max(i + 1 + Vc::simd_cast<index_v>(Vc::floor(d)), index_v::Zero()),
+        index_v(n - 2));
+    return std::make_pair(cell, d + Vc::simd_cast<float_v>(i + 1 - cell));
 }
 
-inline void Spline::Fill(int ind, const float XYZ[])
+inline std::pair<int, float> quadraticStencil(int i, float d, int n)
 {
-    Fill(ind, XYZ[0], XYZ[1], XYZ[2]);
+    // the center is the first knot of the cell, but at least the 2nd of the axis
+    const int center = std::min(std::max(i + 1 + int(std::floor(d)), 1), n - 2);
+    return std::make_pair(center - 1, d + float(i + 1 - center));
 }
 
-template <typename F> inline void Spline::Fill(F &&func)
+inline std::pair<index_v, float_v> quadraticStencil(const index_v &i, const float_v &d,
+                                                    int n)
 {
-    for (int i = 0; i < GetNPoints(); i++) {
-        float a, b;
-        std::tie(a, b) = GetAB(i);
-        std::array<float, 3> xyz = func(a, b);
-        Fill(i, xyz[0], xyz[1], xyz[2]);
+    const index_v center = Vc::min(
+        Vc::max(i + 1 + Vc::simd_cast<index_v>(Vc::floor(d)), index_v(1)),
+        index_v(n - 2));
+    return std::make_pair(center - 1, d + Vc::simd_cast<float_v>(i + 1 - center));
+}
+
+// Spline {{{1
+/* Spline is the map interface of all layouts, the Layout policy owns the knots and
+ * implements the kernels. With Value = std::array<Scalar, Components> (Point3 for the
+ * layouts of {X,Y,Z} float knots) and ValueV = SimdValue<Scalar, Components>:
+ *
+ *   Layout(const Grid &, args...);  // args are the trailing constructor arguments
+ *   static constexpr int Components;   // values per knot
+ *   static constexpr bool Transposed;  // knots stored in the order a + b * fNA
+ *   void Fill(const Grid &, int ind, const Scalar values[]);
+ *   void Fill(const Grid &, const index_v &iA, const index_v &iB, ValueV values);
+ *   Value GetValue(const Grid &, Point2) const;
+ *   ValueV GetValue(const Grid &, const Point2V &) const;
+ *   std::tuple<Value, Value, Value> GetValueAndGradient(const Grid &, Point2) const;
+ *   std::tuple<ValueV, ValueV, ValueV> GetValueAndGradient(const Grid &,
+ *                                                          const Point2V &) const;
+ *   std::size_t GetMapSize() const;  // the bytes of all arrays of the layout
+ *   // the elements the kernels index from one base, see fitsIndex
+ *   static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB);
+ *
+ * and for the map files (see Spline::Write and loadSpline):
+ *
+ *   static const char *FileTag();       // the name of the layout in the file header
+ *   Layout(const Grid &, MapReader &);  // adopts the arrays of the file
+ *   void Write(MapWriter &) const;
+ *
+ * The gradient of the layouts is by da and db, Spline scales it to the A and B axes,
+ * unless the layout has a static constexpr bool ScaledGradient = true (see
+ * LayoutScalesGradient).
+ * The layouts get the stencil and the position in it from Grid::Position, thus they
+ * support non-uniform grids as well.
+ *
+ * A layout may have a Prefetch(const Grid &, const Point2V &) const that prefetches the
+ * knots the vector GetValue reads, see Spline::Prefetch.
+ *
+ * Additional kernels of a layout are overloads of GetValue with a kernel tag as first
+ * argument, e.g. GetValue<AoS4::ScalarKernel>(ab). The kernels of the lower
+ * interpolation orders, LinearKernel and QuadraticKernel, are scalar and horizontal. A
+ * layout with data derived from the knots also has UpdateCells(const Grid &, int beginA,
+ * int endA), see FillCells.
+ *
+ * Scalar is the type the layout evaluates in, its typedef Scalar (see LayoutScalar), the
+ * layouts without one evaluate in float. The input points and the grid are float for
+ * every Scalar, e.g. Spline<Planes<float, double>> evaluates float knots in double.
+ *
+ * G is the grid type, Grid or a FixedGrid (see FixedSpline). The layout kernels get the
+ * grid as a const G &, i.e. the kernels templated on the grid type see the constant N
+ * points of a FixedGrid.
+ */
+template <typename Layout, typename G = Grid> class Spline
+{
+    static_assert(std::is_base_of<Grid, G>::value, "the grid is a Grid");
+
+public:
+    typedef typename LayoutScalar<Layout>::type Scalar;
+    static constexpr int Components = Layout::Components;
+    typedef std::array<Scalar, Components> Value;
+    typedef SimdValue<Scalar, Components> ValueV;
+
+    /** A map on a uniform grid (see Grid), which has to be FitsIndex (see createSpline)
+     */
+    template <typename... Args>
+    Spline(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB,
+           Args &&... layoutArgs);
+    /** A map on a non-uniform grid, see Grid, the same */
+    template <typename... Args>
+    Spline(std::vector<float> knotsA, std::vector<float> knotsB, Args &&... layoutArgs);
+    /** A map on a copy of grid, e.g. a FixedGrid, which has to be FitsIndex */
+    template <typename... Args> explicit Spline(const G &grid, Args &&... layoutArgs);
+
+    /** True if the kernels of the layout index the grid of nA x nB knots with int and
+     * index_v, see fitsIndex. The maps of the other grids are not constructible. */
+    static bool FitsIndex(std::int64_t nA, std::int64_t nB)
+    {
+        return fitsPoints(nA, nB) && fitsIndex(Layout::IndexedElements(nA, nB));
+    }
+
+    /**  Filling of points, func(a, b) returns the Value of one knot */
+    template <typename F> auto Fill(F &&func) -> decltype(void(func(0.f, 0.f)));
+    /**  Filling of points, func(Point2V) returns the ValueV of float_v::Size knots */
+    template <typename F> auto Fill(F &&func) -> decltype(void(ValueV(func(Point2V()))));
+    /**  Same, with the rows of knots distributed over the workers of the pool, thus func
+     * is called concurrently */
+    template <typename F>
+    auto Fill(F &&func, ThreadPool &pool) -> decltype(void(ValueV(func(Point2V()))));
+    /**  Filling of points, only for layouts of 3 components */
+    void Fill(int ind, Scalar x, Scalar y, Scalar z);
+    /**  Filling of points, the Components values of the knot */
+    void Fill(int ind, const Scalar values[]);
+
+    /**  Get A,B by the point index */
+    std::pair<float, float> GetAB(int ind) const;
+
+    /** Calculate interpolated value at the given point(s) */
+    Value GetValue(Point2) const;
+    ValueV GetValue(const Point2V &) const;
+    /** Same with one of the additional kernels of the layout */
+    template <typename Kernel> Value GetValue(Point2) const;
+    template <typename Kernel> ValueV GetValue(const Point2V &) const;
+
+    /** Calculate interpolated value and its derivatives d/dA and d/dB at the given
+     * point(s), from one set of stencil loads */
+    std::tuple<Value, Value, Value> GetValueAndGradient(Point2) const;
+    std::tuple<ValueV, ValueV, ValueV> GetValueAndGradient(const Point2V &) const;
+
+    /** Prefetch the knots that GetValue(ab) reads, if the layout supports it */
+    void Prefetch(const Point2V &ab) const { PrefetchStencils(fLayout, fGrid, ab, 0); }
+
+    /** Calculate interpolated values for n points, AoS and SoA variants. The SoA variant
+     * is only for layouts of 3 components. */
+    void GetValues(const Point2 *ab, Value *values, std::size_t n) const;
+    void GetValues(const float *a, const float *b, Scalar *x, Scalar *y, Scalar *z,
+                   std::size_t n) const;
+    /** Same as above, with the points distributed over the workers of the pool */
+    void GetValues(const Point2 *ab, Value *values, std::size_t n,
+                   ThreadPool &pool) const;
+    void GetValues(const float *a, const float *b, Scalar *x, Scalar *y, Scalar *z,
+                   std::size_t n, ThreadPool &pool) const;
+
+    /** Get the bytes of the map: the arrays of the layout (its GetMapSize) and the knots
+     * of a non-uniform grid, i.e. the memory a placement of the map in a NUMA node or a
+     * cache level has to hold */
+    std::size_t GetMapSize() const;
+
+    /**  Get N of point on the grid */
+    int GetNPoints() const;
+
+    /** Write the map to a map file, false if that failed */
+    bool Write(const std::string &path) const;
+
+private:
+    template <typename L> friend std::unique_ptr<Spline<L>> loadSpline(MapReader &reader);
+
+    /** the map of a file, the layout adopts the mapped arrays */
+    explicit Spline(MapReader &reader)
+        : fGrid(reader), fLayout(fGrid, reader), fReadOnly(reader.ReadOnly())
+    {
     }
+
+    /** copy constructor prohibited */
+    Spline(const Spline &);
+    /** assignment operator prohibited */
+    Spline &operator=(const Spline &);
+
+    /** grid, which has to be FitsIndex, before the layout allocates its arrays */
+    static const G &Checked(const G &grid)
+    {
+        assert(FitsIndex(grid.fNA, grid.fNB));
+        return grid;
+    }
+
+    /** vector Fill of the knot rows [begin, end), a row is along the axis that the layout
+     * stores contiguously */
+    template <typename F> void FillRows(F &func, int begin, int end);
+    /** Before the first Fill of a map in a read-only file or buffer: replace the layout
+     * by a copy, which owns its arrays */
+    void Unshare();
+    int GetNRows() const { return Layout::Transposed ? fGrid.fNB : fGrid.fNA; }
+
+    /** Let the layout update the data it derives from the knots of the cell rows
+     * [begin, end) on the A axis */
+    template <typename L>
+    static auto FillCells(L &layout, const G &grid, int begin, int end, int)
+        -> decltype(layout.UpdateCells(grid, begin, end))
+    {
+        layout.UpdateCells(grid, begin, end);
+    }
+    template <typename L> static void FillCells(L &, const G &, int, int, long) {}
+
+    template <typename L>
+    static auto PrefetchStencils(const L &layout, const G &grid, const Point2V &ab,
+                                 int) -> decltype(layout.Prefetch(grid, ab))
+    {
+        layout.Prefetch(grid, ab);
+    }
+    template <typename L>
+    static void PrefetchStencils(const L &, const G &, const Point2V &, long)
+    {
+    }
+
+    const G fGrid;
+    Layout fLayout;  // the knots
+    bool fReadOnly;  // fLayout adopted the read-only arrays of a file or buffer
+};
+
+/** The map of a FixedGrid of NA x NB knots, e.g.
+ *
+ *   FixedSpline<SoA, 64, 128> map(FixedGrid<64, 128>(minA, maxA, minB, maxB));
+ */
+template <typename Layout, int NA, int NB>
+using FixedSpline = Spline<Layout, FixedGrid<NA, NB>>;
+
+/** The map on a uniform grid (see Spline), nullptr if the grid is not FitsIndex */
+template <typename Layout, typename... Args>
+std::unique_ptr<Spline<Layout>> createSpline(float minA, float maxA, int nBinsA,
+                                             float minB, float maxB, int nBinsB,
+                                             Args &&... layoutArgs);
+/** The map on a non-uniform grid, nullptr if the knots of an axis are not valid (see
+ * KnotAxis::IsValid) or if the grid is not FitsIndex */
+template <typename Layout, typename... Args>
+std::unique_ptr<Spline<Layout>> createSpline(std::vector<float> knotsA,
+                                             std::vector<float> knotsB,
+                                             Args &&... layoutArgs);
+
+/** Map the map file written by Spline<Layout>::Write. The map evaluates from the
+ * mapped pages, thus the processes mapping the same file share its knots. nullptr if the
+ * file is missing or broken (e.g. knots that are not strictly increasing), or if it was
+ * written by another layout. */
+template <typename Layout>
+std::unique_ptr<Spline<Layout>> loadSpline(const std::string &path);
+/** Same for a map file in the buffer of size bytes at data, aligned to MapFileAlignment,
+ * e.g. a POSIX shared memory segment that a loader filled with a map file. The map
+ * evaluates from the buffer, the caller keeps it valid (and mapped) as long as the map
+ * lives. The map never writes to the buffer, its first Fill copies the knots. */
+template <typename Layout>
+std::unique_ptr<Spline<Layout>> loadSpline(const void *data, std::size_t size);
+/** The map of the reader, see above */
+template <typename Layout> std::unique_ptr<Spline<Layout>> loadSpline(MapReader &reader);
+
+// stencil prefetch {{{1
+/** Prefetch the stencils of all lanes: the stencil of lane l are 4 rows of rowLength
+ * elements, the first at base[first[l]], the next ones rowStride elements apart */
+template <typename T>
+inline void prefetchStencils(const T *base, const index_v &first, int rowStride,
+                             int rowLength)
+{
+    for (std::size_t l = 0; l < index_v::Size; ++l) {
+        const T *row = base + first[l];
+        for (int r = 0; r < 4; ++r, row += rowStride) {
+            const char *begin = reinterpret_cast<const char *>(row);
+            const char *end = reinterpret_cast<const char *>(row + rowLength);
+            for (const char *p = begin; p < end; p += CacheLineSize) {
+                Vc::prefetchClose(p);
+            }
+            Vc::prefetchClose(end - 1);  // a row that straddles one more line
+        }
+    }
+}
+
+// AoS4 {{{1
+/* AoS4 stores {X,Y,Z,0} per knot in one SimdArray<float, 4>, in the order of the point
+ * index. The scalar kernels are in spline.cpp, the vector ones below (see AoS4 vector
+ * kernels).
+ */
+class AoS4
+{
+public:
+    /** additional kernels, see Spline::GetValue<Kernel> */
+    struct ScalarKernel {};
+    struct Float16Kernel {};
+    struct AutovecKernel {};
+    struct AliceKernel {};  // uniform grids, else the default kernel
+
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = false;
+
+    explicit AoS4(const Grid &grid);
+    AoS4(const Grid &grid, MapReader &reader);
+
+    static const char *FileTag() { return "AoS4"; }
+    void Write(MapWriter &writer) const;
+
+    /** the floats of the knots, indexed from the start of the array */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return 4 * nA * nB;
+    }
+
+    void Fill(const Grid &grid, int ind, const float XYZ[]);
+    /** The vector kernels take the grid type, thus the strides of a FixedGrid are
+     * constants */
+    template <typename G>
+    void Fill(const G &grid, const index_v &iA, const index_v &iB, Point3V xyz);
+
+    Point3 GetValue(const Grid &grid, Point2 ab) const;
+    template <typename G> Point3V GetValue(const G &grid, const Point2V &ab) const;
+    Point3 GetValue(ScalarKernel, const Grid &grid, Point2 ab) const;
+    Point3 GetValue(Float16Kernel, const Grid &grid, Point2 ab) const;
+    Point3 GetValue(AutovecKernel, const Grid &grid, Point2 ab) const;
+    Point3 GetValue(AliceKernel, const Grid &grid, Point2 ab) const;
+    Point3 GetValue(LinearKernel, const Grid &grid, Point2 ab) const;
+    template <typename G>
+    Point3V GetValue(LinearKernel, const G &grid, const Point2V &ab) const;
+    Point3 GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const;
+    template <typename G>
+    Point3V GetValue(QuadraticKernel, const G &grid, const Point2V &ab) const;
+
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(const Grid &grid,
+                                                           Point2 ab) const;
+    template <typename G>
+    std::tuple<Point3V, Point3V, Point3V> GetValueAndGradient(const G &grid,
+                                                              const Point2V &ab) const;
+
+    template <typename G> void Prefetch(const G &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    typedef Vc::SimdArray<float, 4> DataPoint;
+    KnotVector<DataPoint> fXYZ;  // array of points, {X,Y,Z,0} values
+};
+
+inline void AoS4::Fill(const Grid &, int ind, const float XYZ[])
+{
+    fXYZ[ind][0] = XYZ[0];
+    fXYZ[ind][1] = XYZ[1];
+    fXYZ[ind][2] = XYZ[2];
+}
+
+template <typename G>
+inline void AoS4::Fill(const G &grid, const index_v &iA, const index_v &iB, Point3V xyz)
+{
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    map[iA * grid.fNB + iB] = Vc::tie(xyz[0], xyz[1], xyz[2]);
 }
 
-inline std::pair<float, float> Spline::GetAB(int ind) const
+inline std::size_t AoS4::GetMapSize() const { return sizeof(DataPoint) * fXYZ.size(); }
+
+template <typename G>
+inline void AoS4::Prefetch(const G &grid, const Point2V &ab) const
 {
-    return std::make_pair(fMinA + (ind / fNA) * fStepA, fMinB + (ind % fNB) * fStepB);
+    const auto pos = grid.Position(ab);
+    prefetchStencils(&fXYZ[0], std::get<0>(pos) * grid.fNB + std::get<1>(pos), grid.fNB,
+                     4);
 }
 
-inline int Spline::GetMapSize() const { return 4 * sizeof(float) * fN; }
+inline void AoS4::Write(MapWriter &writer) const { writer.Write(fXYZ); }
 
-inline int Spline::GetNPoints() const { return fN; }
+// spline 1-st order, 2 points, da = a - point 0 {{{1
+template <typename T> static Vc_ALWAYS_INLINE T GetSpline1(T v0, T v1, T x)
+{
+    return (v1 - v0) * x + v0;
+}
 
-inline float Spline::GetSpline2(float *v, float x)
+// spline 2-nd order, 3 points, da = a - point 1 {{{1
+template <typename T> static Vc_ALWAYS_INLINE T GetSpline2(const T v[], T x)
 {
     return 0.5f * x * ((v[0] + v[2] - v[1] - v[1]) * x + v[2] - v[0]) + v[1];
 }
 
-inline std::tuple<int, int, float, float> evaluatePosition(Point2 ab, Point2 min,
-                                                           Point2 scale, int na, int nb)
+// spline 3-st order,  4 points, da = a - point 1 {{{1
+template <typename T> static Vc_ALWAYS_INLINE T GetSpline3(T v0, T v1, T v2, T v3, T x)
+{
+    const T dv = v2 - v1;
+    const T z0 = 0.5f * (v2 - v0);
+    const T z1 = 0.5f * (v3 - v1);
+    return (x * x) * ((z1 - dv) * (x - 1) + (z0 - dv) * (x - 2)) + (z0 * x + v1);
+}
+
+template <typename T> static Vc_ALWAYS_INLINE T GetSpline3(const T v[], T x)
+{
+    return GetSpline3(v[0], v[1], v[2], v[3], x);
+}
+
+/** the same with the tangent weights of the stencil, see StencilPosition */
+template <typename T>
+static Vc_ALWAYS_INLINE T GetSpline3(T v0, T v1, T v2, T v3, const StencilPosition<T> &p)
+{
+    const T &x = p.fX;
+    const T dv = v2 - v1;
+    const T z0 = p.fT0 * (v2 - v0);
+    const T z1 = p.fT1 * (v3 - v1);
+    return (x * x) * ((z1 - dv) * (x - 1) + (z0 - dv) * (x - 2)) + (z0 * x + v1);
+}
+
+template <typename T>
+static Vc_ALWAYS_INLINE T GetSpline3(const T v[], const StencilPosition<T> &p)
+{
+    return GetSpline3(v[0], v[1], v[2], v[3], p);
+}
+
+// derivative of GetSpline3 by x {{{1
+template <typename T>
+static Vc_ALWAYS_INLINE T GetSpline3Derivative(T v0, T v1, T v2, T v3, T x)
+{
+    const T dv = v2 - v1;
+    const T z0 = 0.5f * (v2 - v0);
+    const T z1 = 0.5f * (v3 - v1);
+    return x * ((z1 - dv) * (3.f * x - 2.f) + (z0 - dv) * (3.f * x - 4.f)) + z0;
+}
+
+template <typename T> static Vc_ALWAYS_INLINE T GetSpline3Derivative(const T v[], T x)
+{
+    return GetSpline3Derivative(v[0], v[1], v[2], v[3], x);
+}
+
+template <typename T>
+static Vc_ALWAYS_INLINE T GetSpline3Derivative(T v0, T v1, T v2, T v3,
+                                               const StencilPosition<T> &p)
+{
+    const T &x = p.fX;
+    const T dv = v2 - v1;
+    const T z0 = p.fT0 * (v2 - v0);
+    const T z1 = p.fT1 * (v3 - v1);
+    return x * ((z1 - dv) * (3.f * x - 2.f) + (z0 - dv) * (3.f * x - 4.f)) + z0;
+}
+
+template <typename T>
+static Vc_ALWAYS_INLINE T GetSpline3Derivative(const T v[], const StencilPosition<T> &p)
+{
+    return GetSpline3Derivative(v[0], v[1], v[2], v[3], p);
+}
+
+// value and gradient of a 4x4 stencil {{{1
+/** v[i][j] is the knot (iA + i, iB + j), returns {value, d/da, d/db} */
+template <typename T>
+static Vc_ALWAYS_INLINE std::array<T, 3> GetSpline3Gradient(const T v[4][4],
+                                                            const StencilPosition<T> &da,
+                                                            const StencilPosition<T> &db)
+{
+    T w[4], dw[4];
+    for (int i = 0; i < 4; i++) {
+        w[i] = GetSpline3(v[i], db);
+        dw[i] = GetSpline3Derivative(v[i], db);
+    }
+    return {{GetSpline3(w, da), GetSpline3Derivative(w, da), GetSpline3(dw, da)}};
+}
+
+/** Regroup {value, d/da, d/db} of each component to (value, d/da, d/db) */
+template <typename P, typename T, std::size_t N>
+static Vc_ALWAYS_INLINE std::tuple<P, P, P> makeGradient(const std::array<T, 3> (&g)[N])
+{
+    P xyz, dA, dB;
+    for (std::size_t c = 0; c < N; c++) {
+        xyz[c] = g[c][0];
+        dA[c] = g[c][1];
+        dB[c] = g[c][2];
+    }
+    return std::make_tuple(xyz, dA, dB);
+}
+
+// AoS4 vector kernels {{{1
+template <typename G>
+inline Point3V AoS4::GetValue(const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    float_v vx[4];
+    float_v vy[4];
+    float_v vz[4];
+    auto ind = iA * grid.fNB + iB;
+    if (all_of(ind == ind[0])) {
+        // all lanes in the same cell: broadcast the stencil instead of gathering it
+        const float *m = reinterpret_cast<const float *>(&fXYZ[ind[0]]);
+        for (int i = 0; i < 4; i++) {
+            vx[i] = GetSpline3<float_v>(m[0], m[4], m[8], m[12], db);
+            vy[i] = GetSpline3<float_v>(m[1], m[5], m[9], m[13], db);
+            vz[i] = GetSpline3<float_v>(m[2], m[6], m[10], m[14], db);
+            m += 4 * grid.fNB;
+        }
+    } else {
+        const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+        for (int i = 0; i < 4; i++) {
+            float_v x[4], y[4], z[4];
+            Vc::tie(x[0], y[0], z[0]) = map[ind];
+            Vc::tie(x[1], y[1], z[1]) = map[ind + 1];
+            Vc::tie(x[2], y[2], z[2]) = map[ind + 2];
+            Vc::tie(x[3], y[3], z[3]) = map[ind + 3];
+            vx[i] = GetSpline3<float_v>(x[0], x[1], x[2], x[3], db);
+            vy[i] = GetSpline3<float_v>(y[0], y[1], y[2], y[3], db);
+            vz[i] = GetSpline3<float_v>(z[0], z[1], z[2], z[3], db);
+            ind += grid.fNB;
+        }
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline3<float_v>(vx, da);
+    XYZ[1] = GetSpline3<float_v>(vy, da);
+    XYZ[2] = GetSpline3<float_v>(vz, da);
+    return XYZ;
+}
+
+template <typename G>
+inline Point3V AoS4::GetValue(LinearKernel, const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    index_v ind = a.first * grid.fNB + b.first;
+    float_v vx[2], vy[2], vz[2];
+    for (int i = 0; i < 2; i++) {
+        float_v x[2], y[2], z[2];
+        Vc::tie(x[0], y[0], z[0]) = map[ind];
+        Vc::tie(x[1], y[1], z[1]) = map[ind + 1];
+        vx[i] = GetSpline1(x[0], x[1], b.second);
+        vy[i] = GetSpline1(y[0], y[1], b.second);
+        vz[i] = GetSpline1(z[0], z[1], b.second);
+        ind += grid.fNB;
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline1(vx[0], vx[1], a.second);
+    XYZ[1] = GetSpline1(vy[0], vy[1], a.second);
+    XYZ[2] = GetSpline1(vz[0], vz[1], a.second);
+    return XYZ;
+}
+
+template <typename G>
+inline Point3V AoS4::GetValue(QuadraticKernel, const G &grid,
+                                     const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    index_v ind = a.first * grid.fNB + b.first;
+    float_v vx[3], vy[3], vz[3];
+    for (int i = 0; i < 3; i++) {
+        float_v x[3], y[3], z[3];
+        Vc::tie(x[0], y[0], z[0]) = map[ind];
+        Vc::tie(x[1], y[1], z[1]) = map[ind + 1];
+        Vc::tie(x[2], y[2], z[2]) = map[ind + 2];
+        vx[i] = GetSpline2(x, b.second);
+        vy[i] = GetSpline2(y, b.second);
+        vz[i] = GetSpline2(z, b.second);
+        ind += grid.fNB;
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline2(vx, a.second);
+    XYZ[1] = GetSpline2(vy, a.second);
+    XYZ[2] = GetSpline2(vz, a.second);
+    return XYZ;
+}
+
+template <typename G>
+inline std::tuple<Point3V, Point3V, Point3V> AoS4::GetValueAndGradient(
+    const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    float_v x[4][4], y[4][4], z[4][4];
+    auto ind = iA * grid.fNB + iB;
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            Vc::tie(x[i][j], y[i][j], z[i][j]) = map[ind + j];
+        }
+        ind += grid.fNB;
+    }
+    const std::array<float_v, 3> g[3] = {GetSpline3Gradient(x, da, db),
+                                         GetSpline3Gradient(y, da, db),
+                                         GetSpline3Gradient(z, da, db)};
+    return makeGradient<Point3V>(g);
+}
+
+// evaluatePosition {{{1
+/** the stencil and position of a uniform grid, i.e. with the tangent weights 1/2 */
+inline std::tuple<int, int, StencilPosition<float>, StencilPosition<float>>
+evaluatePosition(Point2 ab, Point2 min, Point2 scale, int na, int nb)
 {
     const float lA = (ab[0] - min[0]) * scale[0] - 1.f;
     const int iA = std::min(na - 4.f, std::max(lA, 0.f));
@@ -153,18 +934,14 @@ inline std::tuple<int, int, float, float> evaluatePosition(Point2 ab, Point2 min
     const float lB = (ab[1] - min[1]) * scale[1] - 1.f;
     const int iB = std::min(nb - 4.f, std::max(lB, 0.f));
 
-    const float da = lA - iA;
-    const float db = lB - iB;
+    const StencilPosition<float> da(lA - iA, 0.5f, 0.5f);
+    const StencilPosition<float> db(lB - iB, 0.5f, 0.5f);
 
     return std::make_tuple(iA, iB, da, db);
 }
 
-using Vc::float_v;
-typedef float_v::IndexType index_v;
-inline std::tuple<index_v, index_v, float_v, float_v> evaluatePosition(Point2V ab,
-                                                                       Point2 min,
-                                                                       Point2 scale,
-                                                                       int na, int nb)
+inline std::tuple<index_v, index_v, StencilPosition<float_v>, StencilPosition<float_v>>
+evaluatePosition(Point2V ab, Point2 min, Point2 scale, int na, int nb)
 {
     const float_v lA = (ab[0] - min[0]) * scale[0] - 1.f;
     const auto iA = static_cast<index_v>(std::min(na - 4.f, std::max(lA, 0.f)));
@@ -172,10 +949,731 @@ inline std::tuple<index_v, index_v, float_v, float_v> evaluatePosition(Point2V a
     const float_v lB = (ab[1] - min[1]) * scale[1] - 1.f;
     const auto iB = static_cast<index_v>(std::min(nb - 4.f, std::max(lB, 0.f)));
 
-    const float_v da = lA - Vc::simd_cast<float_v>(iA);
-    const float_v db = lB - Vc::simd_cast<float_v>(iB);
+    const StencilPosition<float_v> da(lA - Vc::simd_cast<float_v>(iA), 0.5f, 0.5f);
+    const StencilPosition<float_v> db(lB - Vc::simd_cast<float_v>(iB), 0.5f, 0.5f);
 
     return std::make_tuple(iA, iB, da, db);
 }
 
+// bulk evaluation {{{1
+/* The bulk functions evaluate n points via the horizontal GetValue(Point2V) of the map.
+ * The last, partial vector is filled up by repeating the last point (i.e. the loads
+ * never read past the end of the input) and only the valid lanes are stored, by masked
+ * stores or scatters.
+ *
+ * The stencil gathers of maps that do not fit the cache wait for memory. Therefore the
+ * loops are a pipeline: before evaluating the batch of float_v::Size points at i they
+ * prefetch the stencils of the batch distance batches ahead (Map::Prefetch), thus
+ * distance batches of loads are in flight. distance = 0 disables the prefetches. The
+ * default keeps 2 * 4 stencil rows per lane in flight, that are 64 cache lines for AVX,
+ * about the number of outstanding L2 misses of a core.
+ */
+constexpr std::size_t PrefetchDistance = 2;
+
+/** The batch of points at ab[i]. The wrapper is based at the batch, thus the indexes
+ * of the gather stay small for any n. */
+inline Point2V loadPoints(const Point2 *ab, std::size_t i)
+{
+    const auto in = Vc::make_interleave_wrapper<float_v>(ab + i);
+    Point2V p;
+    Vc::tie(p[0], p[1]) = in[index_v::IndexesFromZero()];
+    return p;
+}
+
+inline Point2V loadPoints(const float *a, const float *b, std::size_t i)
+{
+    Point2V p;
+    p[0] = float_v(a + i, Vc::Unaligned);
+    p[1] = float_v(b + i, Vc::Unaligned);
+    return p;
+}
+
+/** The prefetches before evaluating the batch at i of n points: the batch distance
+ * batches ahead, at i = 0 the batches up to it. load(j) returns the batch at j. */
+template <typename Map, typename Load>
+inline void prefetchAhead(const Map &map, const Load &load, std::size_t i, std::size_t n,
+                          std::size_t distance)
+{
+    if (distance == 0) {
+        return;
+    }
+    const std::size_t ahead = i + distance * float_v::Size;
+    for (std::size_t j = i == 0 ? float_v::Size : ahead;
+         j <= ahead && j + float_v::Size <= n; j += float_v::Size) {
+        map.Prefetch(load(j));
+    }
+}
+
+/** The lanes j < remaining of r to out[j], a masked scatter of every component */
+template <typename V, typename T, std::size_t N>
+inline void storeValid(const V &r, std::array<T, N> *out, int remaining)
+{
+    const index_v stride = index_v::IndexesFromZero() * int(N);
+    typedef typename std::decay<decltype(r[0])>::type C;
+    const auto valid = C::IndexesFromZero() < C(remaining);
+    for (std::size_t c = 0; c < N; ++c) {
+        r[c].scatter(&out[0][c], stride, valid);
+    }
+}
+
+template <typename Map>
+inline void evaluateBulk(const Map &map, const Point2 *ab, Point3 *xyz, std::size_t n,
+                         std::size_t distance = PrefetchDistance)
+{
+    const auto load = [ab](std::size_t j) { return loadPoints(ab, j); };
+    std::size_t i = 0;
+    for (; i + float_v::Size <= n; i += float_v::Size) {
+        prefetchAhead(map, load, i, n, distance);
+        auto out = Vc::make_interleave_wrapper<float_v>(xyz + i);
+        Point3V r = map.GetValue(load(i));
+        out[index_v::IndexesFromZero()] = Vc::tie(r[0], r[1], r[2]);
+    }
+    if (i < n) {
+        const int remaining = n - i;
+        const auto in = Vc::make_interleave_wrapper<float_v>(ab + i);
+        const index_v ind = Vc::min(index_v::IndexesFromZero(), index_v(remaining - 1));
+        Point2V p;
+        Vc::tie(p[0], p[1]) = in[ind];
+        storeValid(map.GetValue(p), xyz + i, remaining);
+    }
+}
+
+template <typename Map, typename T, std::size_t N>
+inline void evaluateBulk(const Map &map, const Point2 *ab, std::array<T, N> *values,
+                         std::size_t n, std::size_t distance = PrefetchDistance)
+{
+    const auto load = [ab](std::size_t j) { return loadPoints(ab, j); };
+    // the stride of the components in the output
+    const index_v stride = index_v::IndexesFromZero() * int(N);
+    std::size_t i = 0;
+    for (; i + float_v::Size <= n; i += float_v::Size) {
+        prefetchAhead(map, load, i, n, distance);
+        const auto r = map.GetValue(load(i));
+        for (std::size_t c = 0; c < N; ++c) {
+            r[c].scatter(&values[i][c], stride);
+        }
+    }
+    if (i < n) {
+        const int remaining = n - i;
+        const auto in = Vc::make_interleave_wrapper<float_v>(ab + i);
+        const index_v ind = Vc::min(index_v::IndexesFromZero(), index_v(remaining - 1));
+        Point2V p;
+        Vc::tie(p[0], p[1]) = in[ind];
+        storeValid(map.GetValue(p), values + i, remaining);
+    }
+}
+
+template <typename Map, typename T>
+inline void evaluateBulk(const Map &map, const float *a, const float *b, T *x, T *y,
+                         T *z, std::size_t n, std::size_t distance = PrefetchDistance)
+{
+    const auto load = [a, b](std::size_t j) { return loadPoints(a, b, j); };
+    std::size_t i = 0;
+    for (; i + float_v::Size <= n; i += float_v::Size) {
+        prefetchAhead(map, load, i, n, distance);
+        const auto r = map.GetValue(load(i));
+        r[0].store(x + i, Vc::Unaligned);
+        r[1].store(y + i, Vc::Unaligned);
+        r[2].store(z + i, Vc::Unaligned);
+    }
+    if (i < n) {
+        const int remaining = n - i;
+        const index_v ind = Vc::min(index_v::IndexesFromZero(), index_v(remaining - 1));
+        Point2V p;
+        p[0] = float_v(a + i, ind);
+        p[1] = float_v(b + i, ind);
+        const auto r = map.GetValue(p);
+        typedef typename std::decay<decltype(r[0])>::type V;
+        const auto valid = V::IndexesFromZero() < V(remaining);
+        r[0].store(x + i, valid, Vc::Unaligned);
+        r[1].store(y + i, valid, Vc::Unaligned);
+        r[2].store(z + i, valid, Vc::Unaligned);
+    }
+}
+
+// parallel bulk evaluation {{{1
+/* The maps are read-only after Fill, thus all workers evaluate from the same map. The
+ * chunks are a multiple of float_v::Size, such that only the very last chunk has a
+ * masked tail. The default of 1024 points keeps the input and output of one chunk
+ * (20 kB) in L1.
+ */
+constexpr std::size_t ParallelChunkSize = 1024;
+
+inline std::size_t parallelChunkSize()
+{
+    return (ParallelChunkSize + float_v::Size - 1) / float_v::Size * float_v::Size;
+}
+
+template <typename Map, typename Input, typename Value>
+inline void evaluateParallel(const Map &map, const Input *ab, Value *values,
+                             std::size_t n, ThreadPool &pool)
+{
+    pool.forEachChunk(n, parallelChunkSize(), [&](std::size_t begin, std::size_t end) {
+        evaluateBulk(map, ab + begin, values + begin, end - begin);
+    });
+}
+
+template <typename Map, typename T>
+inline void evaluateParallel(const Map &map, const float *a, const float *b, T *x, T *y,
+                             T *z, std::size_t n, ThreadPool &pool)
+{
+    pool.forEachChunk(n, parallelChunkSize(), [&](std::size_t begin, std::size_t end) {
+        evaluateBulk(map, a + begin, b + begin, x + begin, y + begin, z + begin,
+                     end - begin);
+    });
+}
+
+// Grid implementation {{{1
+inline Grid::Grid(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB)
+    : fNA(nBinsA < 4 ? 4 : nBinsA)
+    , fNB(nBinsB < 4 ? 4 : nBinsB)
+    , fN(Points(fNA, fNB))
+    , fMinA(minA)
+    , fMinB(minB)
+    , fStepA(((maxA <= minA ? minA + 1 : maxA) - minA) / (fNA - 1))
+    , fStepB(((maxB <= minB ? minB + 1 : maxB) - minB) / (fNB - 1))
+    , fScaleA(1.f / fStepA)
+    , fScaleB(1.f / fStepB)
+    , fUniform(true)
+{
+}
+
+inline Grid::Grid(std::vector<float> knotsA, std::vector<float> knotsB)
+    : fNA(KnotAxis::Checked(knotsA).size())
+    , fNB(KnotAxis::Checked(knotsB).size())
+    , fN(Points(knotsA.size(), knotsB.size()))
+    , fMinA(knotsA.front())
+    , fMinB(knotsB.front())
+    , fStepA((knotsA.back() - knotsA.front()) / (fNA - 1))
+    , fStepB((knotsB.back() - knotsB.front()) / (fNB - 1))
+    , fScaleA(1.f / fStepA)
+    , fScaleB(1.f / fStepB)
+    , fKnotsA(std::move(knotsA))
+    , fKnotsB(std::move(knotsB))
+    , fUniform(false)
+{
+}
+
+inline Grid::Grid(MapReader &reader)
+    : fNA(reader.Header().fNA)
+    , fNB(reader.Header().fNB)
+    , fN(fNA * fNB)
+    , fMinA(reader.Header().fMinA)
+    , fMinB(reader.Header().fMinB)
+    , fStepA(reader.Header().fStepA)
+    , fStepB(reader.Header().fStepB)
+    , fScaleA(1.f / fStepA)
+    , fScaleB(1.f / fStepB)
+    , fUniform(!reader.Header().fNonUniform)
+{
+    if (!fUniform) {
+        // the axes of missing or invalid knots stay empty, loadSpline rejects them
+        std::vector<float> knotsA(fNA), knotsB(fNB);
+        if (reader.Read(knotsA.data(), fNA) && reader.Read(knotsB.data(), fNB) &&
+            KnotAxis::IsValid(knotsA) && KnotAxis::IsValid(knotsB)) {
+            fKnotsA = KnotAxis(std::move(knotsA));
+            fKnotsB = KnotAxis(std::move(knotsB));
+        }
+    }
+}
+
+inline std::pair<float, float> Grid::GetAB(int ind) const
+{
+    return std::make_pair(KnotA(ind / fNB), KnotB(ind % fNB));
+}
+
+inline float_v Grid::KnotA(const index_v &i) const
+{
+    return fUniform ? fMinA + Vc::simd_cast<float_v>(i) * fStepA : fKnotsA.Knot(i);
+}
+
+inline float_v Grid::KnotB(const index_v &i) const
+{
+    return fUniform ? fMinB + Vc::simd_cast<float_v>(i) * fStepB : fKnotsB.Knot(i);
+}
+
+inline std::tuple<int, int, StencilPosition<float>, StencilPosition<float>>
+Grid::Position(Point2 ab) const
+{
+    if (fUniform) {
+        return evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    }
+    const auto a = fKnotsA.Position(ab[0]);
+    const auto b = fKnotsB.Position(ab[1]);
+    return std::make_tuple(a.first, b.first, a.second, b.second);
+}
+
+inline std::tuple<index_v, index_v, StencilPosition<float_v>, StencilPosition<float_v>>
+Grid::Position(const Point2V &ab) const
+{
+    if (fUniform) {
+        return evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    }
+    const auto a = fKnotsA.Position(ab[0]);
+    const auto b = fKnotsB.Position(ab[1]);
+    return std::make_tuple(a.first, b.first, a.second, b.second);
+}
+
+inline Point2 Grid::TangentsA(int i) const
+{
+    return fUniform ? Point2{{0.5f, 0.5f}} : fKnotsA.Tangents(i);
+}
+
+inline Point2 Grid::TangentsB(int i) const
+{
+    return fUniform ? Point2{{0.5f, 0.5f}} : fKnotsB.Tangents(i);
+}
+
+inline Point2 Grid::Scale(Point2 ab) const
+{
+    if (fUniform) {
+        return {{fScaleA, fScaleB}};
+    }
+    return {{fKnotsA.Scale(ab[0]), fKnotsB.Scale(ab[1])}};
+}
+
+inline Point2V Grid::Scale(const Point2V &ab) const
+{
+    Point2V scale;
+    scale[0] = fUniform ? float_v(fScaleA) : fKnotsA.Scale(ab[0]);
+    scale[1] = fUniform ? float_v(fScaleB) : fKnotsB.Scale(ab[1]);
+    return scale;
+}
+
+// FixedGrid implementation {{{1
+template <int NA, int NB>
+inline std::tuple<int, int, StencilPosition<float>, StencilPosition<float>>
+FixedGrid<NA, NB>::Position(Point2 ab) const
+{
+    return evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, NA, NB);
+}
+
+template <int NA, int NB>
+inline std::tuple<index_v, index_v, StencilPosition<float_v>, StencilPosition<float_v>>
+FixedGrid<NA, NB>::Position(const Point2V &ab) const
+{
+    return evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, NA, NB);
+}
+
+template <int NA, int NB>
+inline Point2V FixedGrid<NA, NB>::Scale(const Point2V &) const
+{
+    Point2V scale;
+    scale[0] = fScaleA;
+    scale[1] = fScaleB;
+    return scale;
+}
+
+// KnotAxis implementation {{{1
+inline KnotAxis::KnotAxis(std::vector<float> knots)
+    : fKnots(Checked(knots).begin(), knots.cend())
+    , fUpper(knots.size() - 1)
+    , fInvStep(knots.size() - 1)
+    , fTangent0(knots.size() - 3)
+    , fTangent1(knots.size() - 3)
+    , fMin(knots.front())
+{
+    const int n = knots.size();
+    float minStep = knots.back() - knots.front();
+    for (int k = 0; k + 1 < n; ++k) {
+        fUpper[k] = k + 2 < n ? knots[k + 1] : std::numeric_limits<float>::infinity();
+        fInvStep[k] = 1.f / (knots[k + 1] - knots[k]);
+        minStep = std::min(minStep, knots[k + 1] - knots[k]);
+    }
+    for (int i = 0; i + 3 < n; ++i) {
+        const float step = knots[i + 2] - knots[i + 1];
+        fTangent0[i] = step / (knots[i + 2] - knots[i]);
+        fTangent1[i] = step / (knots[i + 3] - knots[i + 1]);
+    }
+    const float range = knots.back() - knots.front();
+    const int nBins = std::max(1.f, std::min(16.f * (n - 1), std::ceil(range / minStep)));
+    fTableScale = nBins / range;
+    fMaxBin = nBins - 1;
+    // bin b starts with cell k if k knots (not counting the first) are in the bins < b,
+    // the bins are computed exactly like in Stencil
+    fTable.assign(nBins, 0);
+    std::vector<int> nKnots(nBins, 0);
+    for (int i = 1; i + 1 < n; ++i) {
+        const int bin = std::min(fMaxBin, std::max((knots[i] - fMin) * fTableScale, 0.f));
+        ++nKnots[bin];
+    }
+    for (int b = 1; b < nBins; ++b) {
+        fTable[b] = fTable[b - 1] + nKnots[b - 1];
+    }
+    fNSteps = *std::max_element(nKnots.begin(), nKnots.end());
+}
+
+inline bool KnotAxis::IsValid(const std::vector<float> &knots)
+{
+    if (knots.size() < 4 || !std::isfinite(knots.front()) ||
+        !std::isfinite(knots.back())) {
+        return false;
+    }
+    for (std::size_t k = 1; k < knots.size(); ++k) {
+        if (!(knots[k] > knots[k - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline std::size_t KnotAxis::GetMapSize() const
+{
+    return sizeof(float) * (fKnots.size() + fUpper.size() + fInvStep.size() +
+                            fTangent0.size() + fTangent1.size()) +
+           sizeof(int) * fTable.size();
+}
+
+inline int KnotAxis::Stencil(float x) const
+{
+    const int bin = std::min(fMaxBin, std::max((x - fMin) * fTableScale, 0.f));
+    int k = fTable[bin];
+    for (int s = 0; s < fNSteps; ++s) {
+        k += x >= fUpper[k];
+    }
+    return std::min(std::max(k - 1, 0), int(fKnots.size()) - 4);
+}
+
+inline index_v KnotAxis::Stencil(const float_v &x) const
+{
+    const auto bin =
+        static_cast<index_v>(std::min(fMaxBin, std::max((x - fMin) * fTableScale, 0.f)));
+    index_v k(&fTable[0], bin);
+    for (int s = 0; s < fNSteps; ++s) {
+        k += static_cast<index_v>(
+            Vc::iif(x >= float_v(&fUpper[0], k), float_v::One(), float_v::Zero()));
+    }
+    return Vc::min(Vc::max(k - 1, index_v::Zero()), index_v(int(fKnots.size()) - 4));
+}
+
+inline std::pair<int, StencilPosition<float>> KnotAxis::Position(float x) const
+{
+    const int i = Stencil(x);
+    return std::make_pair(i, StencilPosition<float>((x - fKnots[i + 1]) * fInvStep[i + 1],
+                                                    fTangent0[i], fTangent1[i]));
+}
+
+inline std::pair<index_v, StencilPosition<float_v>> KnotAxis::Position(
+    const float_v &x) const
+{
+    const index_v i = Stencil(x);
+    const index_v center = i + 1;
+    return std::make_pair(
+        i, StencilPosition<float_v>(
+               (x - float_v(&fKnots[0], center)) * float_v(&fInvStep[0], center),
+               float_v(&fTangent0[0], i), float_v(&fTangent1[0], i)));
+}
+
+// Spline implementation {{{1
+template <typename Layout, typename G>
+template <typename... Args>
+inline Spline<Layout, G>::Spline(float minA, float maxA, int nBinsA, float minB,
+                                 float maxB, int nBinsB, Args &&... layoutArgs)
+    : fGrid(minA, maxA, nBinsA, minB, maxB, nBinsB)
+    , fLayout(Checked(fGrid), std::forward<Args>(layoutArgs)...)
+    , fReadOnly(false)
+{
+}
+
+template <typename Layout, typename G>
+template <typename... Args>
+inline Spline<Layout, G>::Spline(std::vector<float> knotsA, std::vector<float> knotsB,
+                                 Args &&... layoutArgs)
+    : fGrid(std::move(knotsA), std::move(knotsB))
+    , fLayout(Checked(fGrid), std::forward<Args>(layoutArgs)...)
+    , fReadOnly(false)
+{
+}
+
+template <typename Layout, typename G>
+template <typename... Args>
+inline Spline<Layout, G>::Spline(const G &grid, Args &&... layoutArgs)
+    : fGrid(grid)
+    , fLayout(Checked(fGrid), std::forward<Args>(layoutArgs)...)
+    , fReadOnly(false)
+{
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::Fill(int ind, Scalar x, Scalar y, Scalar z)
+{
+    static_assert(Components == 3, "Fill(ind, values) fills the other layouts");
+    const Scalar XYZ[3] = {x, y, z};
+    Unshare();
+    fLayout.Fill(fGrid, ind, XYZ);
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::Fill(int ind, const Scalar values[])
+{
+    Unshare();
+    fLayout.Fill(fGrid, ind, values);
+}
+
+template <typename Layout, typename G>
+template <typename F>
+inline auto Spline<Layout, G>::Fill(F &&func) -> decltype(void(func(0.f, 0.f)))
+{
+    int i = 0;
+    for (int iA = 0; iA < fGrid.fNA; iA++) {
+        const float a = fGrid.KnotA(iA);
+        for (int iB = 0; iB < fGrid.fNB; iB++, i++) {
+            const Value values = func(a, fGrid.KnotB(iB));
+            Fill(i, values.data());
+        }
+    }
+}
+
+template <typename Layout, typename G>
+template <typename F>
+inline auto Spline<Layout, G>::Fill(F &&func)
+    -> decltype(void(ValueV(func(Point2V()))))
+{
+    Unshare();
+    FillRows(func, 0, GetNRows());
+    FillCells(fLayout, fGrid, 0, fGrid.fNA - 3, 0);
+}
+
+template <typename Layout, typename G>
+template <typename F>
+inline auto Spline<Layout, G>::Fill(F &&func, ThreadPool &pool)
+    -> decltype(void(ValueV(func(Point2V()))))
+{
+    Unshare();
+    // about 4096 knots per chunk
+    const int nKnots = fGrid.fN / GetNRows();
+    pool.forEachChunk(GetNRows(), std::max(1, 4096 / nKnots),
+                      [&](std::size_t begin, std::size_t end) {
+                          FillRows(func, begin, end);
+                      });
+    // the cells need the knots of the rows of other workers
+    pool.forEachChunk(fGrid.fNA - 3, std::max(1, 4096 / fGrid.fNB),
+                      [&](std::size_t begin, std::size_t end) {
+                          FillCells(fLayout, fGrid, begin, end, 0);
+                      });
+}
+
+template <typename Layout, typename G>
+template <typename F>
+inline void Spline<Layout, G>::FillRows(F &func, int begin, int end)
+{
+    const int n = fGrid.fN / GetNRows();
+    for (int row = begin; row < end; ++row) {
+        for (int i = 0; i < n; i += float_v::Size) {
+            // the lanes past the end repeat the last knot of the row
+            const index_v col = Vc::min(index_v::IndexesFromZero() + i, index_v(n - 1));
+            const index_v iA = Layout::Transposed ? col : index_v(row);
+            const index_v iB = Layout::Transposed ? index_v(row) : col;
+            Point2V ab;
+            ab[0] = fGrid.KnotA(iA);
+            ab[1] = fGrid.KnotB(iB);
+            fLayout.Fill(fGrid, iA, iB, func(ab));
+        }
+    }
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::Unshare()
+{
+    if (fReadOnly) {
+        // the copies of the KnotVectors allocate their own arrays (see KnotAllocator)
+        Layout copy(fLayout);
+        fLayout.~Layout();
+        ::new (static_cast<void *>(&fLayout)) Layout(std::move(copy));
+        fReadOnly = false;
+    }
+}
+
+template <typename Layout, typename G>
+inline std::pair<float, float> Spline<Layout, G>::GetAB(int ind) const
+{
+    return fGrid.GetAB(ind);
+}
+
+template <typename Layout, typename G>
+inline auto Spline<Layout, G>::GetValue(Point2 ab) const -> Value
+{
+    return fLayout.GetValue(fGrid, ab);
+}
+
+template <typename Layout, typename G>
+inline auto Spline<Layout, G>::GetValue(const Point2V &ab) const -> ValueV
+{
+    return fLayout.GetValue(fGrid, ab);
+}
+
+template <typename Layout, typename G>
+template <typename Kernel>
+inline auto Spline<Layout, G>::GetValue(Point2 ab) const -> Value
+{
+    return fLayout.GetValue(Kernel(), fGrid, ab);
+}
+
+template <typename Layout, typename G>
+template <typename Kernel>
+inline auto Spline<Layout, G>::GetValue(const Point2V &ab) const -> ValueV
+{
+    return fLayout.GetValue(Kernel(), fGrid, ab);
+}
+
+template <typename Layout, typename G>
+inline auto Spline<Layout, G>::GetValueAndGradient(Point2 ab) const
+    -> std::tuple<Value, Value, Value>
+{
+    Value v, dA, dB;
+    std::tie(v, dA, dB) = fLayout.GetValueAndGradient(fGrid, ab);
+    if (LayoutScalesGradient<Layout>::value) {
+        return std::make_tuple(v, dA, dB);
+    }
+    const Point2 scale = fGrid.Scale(ab);
+    for (int c = 0; c < Components; c++) {
+        dA[c] *= scale[0];
+        dB[c] *= scale[1];
+    }
+    return std::make_tuple(v, dA, dB);
+}
+
+template <typename Layout, typename G>
+inline auto Spline<Layout, G>::GetValueAndGradient(const Point2V &ab) const
+    -> std::tuple<ValueV, ValueV, ValueV>
+{
+    ValueV v, dA, dB;
+    std::tie(v, dA, dB) = fLayout.GetValueAndGradient(fGrid, ab);
+    if (LayoutScalesGradient<Layout>::value) {
+        return std::make_tuple(v, dA, dB);
+    }
+    const Point2V scale = fGrid.Scale(ab);
+    typedef typename std::decay<decltype(dA[0])>::type V;
+    for (int c = 0; c < Components; c++) {
+        dA[c] *= Vc::simd_cast<V>(scale[0]);
+        dB[c] *= Vc::simd_cast<V>(scale[1]);
+    }
+    return std::make_tuple(v, dA, dB);
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::GetValues(const Point2 *ab, Value *values,
+                                         std::size_t n) const
+{
+    evaluateBulk(*this, ab, values, n);
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::GetValues(const float *a, const float *b, Scalar *x,
+                                         Scalar *y, Scalar *z, std::size_t n) const
+{
+    static_assert(Components == 3, "the SoA output has 3 components");
+    evaluateBulk(*this, a, b, x, y, z, n);
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::GetValues(const Point2 *ab, Value *values,
+                                         std::size_t n, ThreadPool &pool) const
+{
+    evaluateParallel(*this, ab, values, n, pool);
+}
+
+template <typename Layout, typename G>
+inline void Spline<Layout, G>::GetValues(const float *a, const float *b, Scalar *x,
+                                         Scalar *y, Scalar *z, std::size_t n,
+                                         ThreadPool &pool) const
+{
+    static_assert(Components == 3, "the SoA output has 3 components");
+    evaluateParallel(*this, a, b, x, y, z, n, pool);
+}
+
+template <typename Layout, typename G>
+inline std::size_t Spline<Layout, G>::GetMapSize() const
+{
+    return fLayout.GetMapSize() + fGrid.GetMapSize();
+}
+
+template <typename Layout, typename G>
+inline int Spline<Layout, G>::GetNPoints() const
+{
+    return fGrid.fN;
+}
+
+template <typename Layout, typename G>
+inline bool Spline<Layout, G>::Write(const std::string &path) const
+{
+    MapFileHeader header = makeMapFileHeader(Layout::FileTag(), Components);
+    header.fNA = fGrid.fNA;
+    header.fNB = fGrid.fNB;
+    header.fMinA = fGrid.fMinA;
+    header.fMinB = fGrid.fMinB;
+    header.fStepA = fGrid.fStepA;
+    header.fStepB = fGrid.fStepB;
+    header.fNonUniform = !fGrid.IsUniform();
+    MapWriter writer(path, header);
+    if (!fGrid.IsUniform()) {
+        writer.Write(fGrid.KnotsA().Knots());
+        writer.Write(fGrid.KnotsB().Knots());
+    }
+    fLayout.Write(writer);
+    return writer.Close();
+}
+
+// createSpline {{{1
+template <typename Layout, typename... Args>
+inline std::unique_ptr<Spline<Layout>> createSpline(float minA, float maxA, int nBinsA,
+                                                    float minB, float maxB, int nBinsB,
+                                                    Args &&... layoutArgs)
+{
+    // the grid raises the bins to at least 4
+    if (!Spline<Layout>::FitsIndex(std::max(4, nBinsA), std::max(4, nBinsB))) {
+        return nullptr;
+    }
+    return std::unique_ptr<Spline<Layout>>(new Spline<Layout>(
+        minA, maxA, nBinsA, minB, maxB, nBinsB, std::forward<Args>(layoutArgs)...));
+}
+
+template <typename Layout, typename... Args>
+inline std::unique_ptr<Spline<Layout>> createSpline(std::vector<float> knotsA,
+                                                    std::vector<float> knotsB,
+                                                    Args &&... layoutArgs)
+{
+    if (!KnotAxis::IsValid(knotsA) || !KnotAxis::IsValid(knotsB) ||
+        !Spline<Layout>::FitsIndex(knotsA.size(), knotsB.size())) {
+        return nullptr;
+    }
+    return std::unique_ptr<Spline<Layout>>(new Spline<Layout>(
+        std::move(knotsA), std::move(knotsB), std::forward<Args>(layoutArgs)...));
+}
+
+// loadSpline {{{1
+template <typename Layout>
+inline std::unique_ptr<Spline<Layout>> loadSpline(const std::string &path)
+{
+    MapReader reader(path);
+    return loadSpline<Layout>(reader);
+}
+
+template <typename Layout>
+inline std::unique_ptr<Spline<Layout>> loadSpline(const void *data, std::size_t size)
+{
+    MapReader reader(data, size);
+    return loadSpline<Layout>(reader);
+}
+
+template <typename Layout>
+inline std::unique_ptr<Spline<Layout>> loadSpline(MapReader &reader)
+{
+    const MapFileHeader &header = reader.Header();
+    if (reader.Failed() || header.fComponents != Layout::Components ||
+        std::strncmp(header.fLayout, Layout::FileTag(), sizeof(header.fLayout)) != 0 ||
+        header.fNA < 4 || header.fNB < 4 ||
+        !Spline<Layout>::FitsIndex(header.fNA, header.fNB) || !(header.fStepA > 0.f) ||
+        !(header.fStepB > 0.f)) {
+        return nullptr;
+    }
+    std::unique_ptr<Spline<Layout>> map(new Spline<Layout>(reader));
+    // an array of the layout is missing or of another size, or the knots are invalid
+    if (reader.Failed() || (!map->fGrid.IsUniform() && map->fGrid.KnotsA().Empty())) {
+        return nullptr;
+    }
+    return map;
+}
+//}}}1
+
 #endif  // SPLINE_H_
@@ -52,131 +52,125 @@ This work is derived from a class in ALICE with the following copyright notice:
 //* ALICE Experiment at CERN, All rights reserved.                         *
 //* See cxx source for full Copyright notice                               *
 
-class Spline2
+/* SoA stores the X, Y and Z planes of the knots one after the other, every plane in
+ * the transposed order a + b * fNA.
+ */
+class SoA
 {
 public:
-    typedef std::array<float, 2> Point2;
-    typedef std::array<float, 3> Point3;
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = true;
 
-    typedef Vc::simdize<Point2> Point2V;
-    typedef Vc::simdize<Point3> Point3V;
+    /** The vector kernel that gathers every plane from its own base, the one GetValue
+     * uses if the planes exceed the index range (see fitsIndex) */
+    struct WideIndexKernel {
+    };
 
-    Spline2(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB);
+    explicit SoA(const Grid &grid);
+    SoA(const Grid &grid, MapReader &reader);
 
-    /**  Filling of points */
-    template <typename F> void Fill(F &&func);
-    /**  Filling of points */
-    void Fill(int ind, float x, float y, float z);
-    /**  Filling of points */
-    void Fill(int ind, const float XYZ[]);
+    static const char *FileTag() { return "SoA"; }
+    void Write(MapWriter &writer) const { writer.Write(fXYZ); }
 
-    /**  Get A,B by the point index */
-    std::pair<float, float> GetAB(int ind) const;
-
-    /** Calculate interpolated value at the given point(s) */
-    Point3 GetValue(Point2) const;
-    Point3V GetValue(Point2V ab) const;
-
-    /**  Get size of the grid */
-    int GetMapSize() const;
+    /** one plane, the base of the gathers of a plane (see WideIndexKernel) */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return nA * nB;
+    }
 
-    /**  Get N of point on the grid */
-    int GetNPoints() const;
+    /** The kernels take the grid type, thus the strides of a FixedGrid are constants */
+    template <typename G> void Fill(const G &grid, int ind, const float XYZ[]);
+    template <typename G>
+    void Fill(const G &grid, const index_v &iA, const index_v &iB, Point3V xyz);
+
+    template <typename G> Point3 GetValue(const G &grid, Point2 ab) const;
+    template <typename G> Point3V GetValue(const G &grid, const Point2V &ab) const;
+    template <typename G> Point3 GetValue(LinearKernel, const G &grid, Point2 ab) const;
+    template <typename G>
+    Point3V GetValue(LinearKernel, const G &grid, const Point2V &ab) const;
+    template <typename G>
+    Point3 GetValue(QuadraticKernel, const G &grid, Point2 ab) const;
+    template <typename G>
+    Point3V GetValue(QuadraticKernel, const G &grid, const Point2V &ab) const;
+    template <typename G>
+    Point3V GetValue(WideIndexKernel, const G &grid, const Point2V &ab) const;
+
+    template <typename G>
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(const G &grid,
+                                                           Point2 ab) const;
+    template <typename G>
+    std::tuple<Point3V, Point3V, Point3V> GetValueAndGradient(const G &grid,
+                                                              const Point2V &ab) const;
+
+    template <typename G> void Prefetch(const G &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
 
 private:
-    /** copy constructor prohibited */
-    Spline2(const Spline2 &);
-    /** assignment operator prohibited */
-    Spline2 &operator=(const Spline2 &);
-
-    /** spline 2-nd order, 3 points, da = a - point 1 */
-    static float GetSpline2(float *v, float da);
-
-    const int fNA;        // N points A axis
-    const int fNB;        // N points A axis
-    const int fN;         // N points total
-    const float fMinA;    // min A axis
-    const float fMinB;    // min B axis
-    const float fStepA;   // step between points A axis
-    const float fStepB;   // step between points B axis
-    const float fScaleA;  // scale A axis
-    const float fScaleB;  // scale B axis
-    Vc::vector<float, Vc::Allocator<float>> fXYZ;  // array of points, {X,Y,Z,0} values
-};
+    /** The 4x4 stencils of plane c at the first knots ind, v[i][j] of the knots iA + i,
+     * iB + j: one deinterleaving load per row, or gathers from the base of the plane */
+    template <typename G>
+    void LoadStencil(const G &grid, int c, const index_v &ind, float_v v[4][4],
+                     bool wide) const;
 
-inline void Spline2::Fill(int ind, float x, float y, float z)
-{
-    ind = ind / fNB + fNA * (ind % fNB);
-    fXYZ[ind] = x;
-    fXYZ[ind + fN] = y;
-    fXYZ[ind + 2 * fN] = z;
-}
-
-inline void Spline2::Fill(int ind, const float XYZ[])
-{
-    Fill(ind, XYZ[0], XYZ[1], XYZ[2]);
-}
+    KnotVector<float> fXYZ;  // planes of {X}, {Y}, {Z} values
+};
 
-template <typename F> inline void Spline2::Fill(F &&func)
+template <typename G>
+inline void SoA::Fill(const G &grid, int ind, const float XYZ[])
 {
-    for (int i = 0; i < GetNPoints(); i++) {
-        float a, b;
-        std::tie(a, b) = GetAB(i);
-        std::array<float, 3> xyz = func(a, b);
-        Fill(i, xyz[0], xyz[1], xyz[2]);
-    }
+    ind = ind / grid.fNB + grid.fNA * (ind % grid.fNB);
+    const std::size_t n = grid.fN;  // distance of the planes
+    fXYZ[ind] = XYZ[0];
+    fXYZ[ind + n] = XYZ[1];
+    fXYZ[ind + 2 * n] = XYZ[2];
 }
 
-inline std::pair<float, float> Spline2::GetAB(int ind) const
+template <typename G>
+inline void SoA::Fill(const G &grid, const index_v &iA, const index_v &iB,
+                      Point3V xyz)
 {
-    return std::make_pair(fMinA + (ind / fNA) * fStepA, fMinB + (ind % fNB) * fStepB);
+    const index_v ind = iA + iB * grid.fNA;
+    xyz[0].scatter(&fXYZ[0], ind);
+    xyz[1].scatter(&fXYZ[std::size_t(grid.fN)], ind);
+    xyz[2].scatter(&fXYZ[2 * std::size_t(grid.fN)], ind);
 }
 
-inline int Spline2::GetMapSize() const { return 4 * sizeof(float) * fN; }
-
-inline int Spline2::GetNPoints() const { return fN; }
-
-inline float Spline2::GetSpline2(float *v, float x)
-{
-    return 0.5f * x * ((v[0] + v[2] - v[1] - v[1]) * x + v[2] - v[0]) + v[1];
-}
-
-// spline 3-st order,  4 points, da = a - point 1 {{{1
-template <typename T> static Vc_ALWAYS_INLINE T GetSpline3(T v0, T v1, T v2, T v3, T x)
-{
-    const T dv = v2 - v1;
-    const T z0 = 0.5f * (v2 - v0);
-    const T z1 = 0.5f * (v3 - v1);
-    return (x * x) * ((z1 - dv) * (x - 1) + (z0 - dv) * (x - 2)) + (z0 * x + v1);
-}
+inline std::size_t SoA::GetMapSize() const { return sizeof(float) * fXYZ.size(); }
 
-template <typename T> static Vc_ALWAYS_INLINE T GetSpline3(const T v[], T x)
+template <typename G>
+inline void SoA::Prefetch(const G &grid, const Point2V &ab) const
 {
-    return GetSpline3(v[0], v[1], v[2], v[3], x);
+    const auto pos = grid.Position(ab);
+    const index_v ind = std::get<0>(pos) + std::get<1>(pos) * grid.fNA;
+    for (int c = 0; c < 3; ++c) {
+        prefetchStencils(&fXYZ[c * std::size_t(grid.fN)], ind, grid.fNA, 4);
+    }
 }
 
-inline Point3 Spline2::GetValue(Point2 ab) const  //{{{1
+template <typename G>
+inline Point3 SoA::GetValue(const G &grid, Point2 ab) const  //{{{1
 {
-    float da1, db1;
+    StencilPosition<float> da1, db1;
     int iA, iB;
-    std::tie(iA, iB, da1, db1) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
 
     typedef Vc::SimdArray<float, 4> float4;
     typedef Vc::SimdArray<float, 12> float12;
-    const float4 da = da1;
-    const float12 db = db1;
+    const StencilPosition<float4> da = da1;
+    const StencilPosition<float12> db = db1;
 
-    const float *m0 = &fXYZ[iA + iB * fNA];
-    const float *m1 = m0 + fNA;
-    const float *m2 = m1 + fNA;
-    const float *m3 = m2 + fNA;
+    const std::size_t n = grid.fN;  // distance of the planes
+    const float *m0 = &fXYZ[iA + iB * grid.fNA];
+    const float *m1 = m0 + grid.fNA;
+    const float *m2 = m1 + grid.fNA;
+    const float *m3 = m2 + grid.fNA;
 
     const float12 xyz = GetSpline3(
-        Vc::simd_cast<float12>(float4(m0), float4(m0 + fN), float4(m0 + 2 * fN)),
-        Vc::simd_cast<float12>(float4(m1), float4(m1 + fN), float4(m1 + 2 * fN)),
-        Vc::simd_cast<float12>(float4(m2), float4(m2 + fN), float4(m2 + 2 * fN)),
-        Vc::simd_cast<float12>(float4(m3), float4(m3 + fN), float4(m3 + 2 * fN)), db);
+        Vc::simd_cast<float12>(float4(m0), float4(m0 + n), float4(m0 + 2 * n)),
+        Vc::simd_cast<float12>(float4(m1), float4(m1 + n), float4(m1 + 2 * n)),
+        Vc::simd_cast<float12>(float4(m2), float4(m2 + n), float4(m2 + 2 * n)),
+        Vc::simd_cast<float12>(float4(m3), float4(m3 + n), float4(m3 + 2 * n)), db);
 
     float4 v[4];
     Vc::tie(v[0], v[1], v[2], v[3]) =
@@ -187,60 +181,212 @@ inline Point3 Spline2::GetValue(Point2 ab) const  //{{{1
     return {{res[0], res[1], res[2]}};
 }
 
-inline Spline2::Point3V Spline2::GetValue(Point2V ab) const  //{{{1
+template <typename G>
+inline Point3V SoA::GetValue(const G &grid, const Point2V &ab) const  //{{{1
 {
+    if (!fitsIndex(3 * std::int64_t(grid.fN))) {
+        return GetValue(WideIndexKernel(), grid, ab);
+    }
     index_v iA, iB;
-    float_v da, db;
-    std::tie(iA, iB, da, db) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
 
-    auto ind = iA + iB * fNA;
+    const index_v ind = iA + iB * grid.fNA;
     Point3V xyz;
 
-    {
-        float_v x[4][4];
-        Vc::tie(x[0][0], x[1][0], x[2][0], x[3][0]) = fXYZ[ind];
-        Vc::tie(x[0][1], x[1][1], x[2][1], x[3][1]) = fXYZ[ind + fNA];
-        Vc::tie(x[0][2], x[1][2], x[2][2], x[3][2]) = fXYZ[ind + 2 * fNA];
-        Vc::tie(x[0][3], x[1][3], x[2][3], x[3][3]) = fXYZ[ind + 3 * fNA];
-        xyz[0] = GetSpline3(GetSpline3(x[0], db), GetSpline3(x[1], db),
-                            GetSpline3(x[2], db), GetSpline3(x[3], db), da);
+    if (all_of(ind == ind[0])) {
+        // all lanes in the same cell: broadcast the stencil instead of gathering it
+        const float *m = &fXYZ[ind[0]];
+        for (int c = 0; c < 3; ++c) {
+            float_v v[4];
+            for (int i = 0; i < 4; ++i) {
+                v[i] = GetSpline3<float_v>(m[i], m[i + grid.fNA], m[i + 2 * grid.fNA],
+                                           m[i + 3 * grid.fNA], db);
+            }
+            xyz[c] = GetSpline3(v, da);
+            m += grid.fN;
+        }
+        return xyz;
     }
-    ind += fN;
-    {
-        float_v y[4][4];
-        Vc::tie(y[0][0], y[1][0], y[2][0], y[3][0]) = fXYZ[ind];
-        Vc::tie(y[0][1], y[1][1], y[2][1], y[3][1]) = fXYZ[ind + fNA];
-        Vc::tie(y[0][2], y[1][2], y[2][2], y[3][2]) = fXYZ[ind + 2 * fNA];
-        Vc::tie(y[0][3], y[1][3], y[2][3], y[3][3]) = fXYZ[ind + 3 * fNA];
-        xyz[1] = GetSpline3(GetSpline3(y[0], db), GetSpline3(y[1], db),
-                            GetSpline3(y[2], db), GetSpline3(y[3], db), da);
+
+    for (int c = 0; c < 3; ++c) {
+        float_v v[4][4];
+        LoadStencil(grid, c, ind, v, false);
+        xyz[c] = GetSpline3(GetSpline3(v[0], db), GetSpline3(v[1], db),
+                            GetSpline3(v[2], db), GetSpline3(v[3], db), da);
     }
-    ind += fN;
-    {
-        float_v z[4][4];
-        Vc::tie(z[0][0], z[1][0], z[2][0], z[3][0]) = fXYZ[ind];
-        Vc::tie(z[0][1], z[1][1], z[2][1], z[3][1]) = fXYZ[ind + fNA];
-        Vc::tie(z[0][2], z[1][2], z[2][2], z[3][2]) = fXYZ[ind + 2 * fNA];
-        Vc::tie(z[0][3], z[1][3], z[2][3], z[3][3]) = fXYZ[ind + 3 * fNA];
-        xyz[2] = GetSpline3(GetSpline3(z[0], db), GetSpline3(z[1], db),
-                            GetSpline3(z[2], db), GetSpline3(z[3], db), da);
+    return xyz;
+}
+
+template <typename G>
+inline Point3V SoA::GetValue(WideIndexKernel, const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    const index_v ind = iA + iB * grid.fNA;
+    Point3V xyz;
+    for (int c = 0; c < 3; ++c) {
+        float_v v[4][4];
+        LoadStencil(grid, c, ind, v, true);
+        xyz[c] = GetSpline3(GetSpline3(v[0], db), GetSpline3(v[1], db),
+                            GetSpline3(v[2], db), GetSpline3(v[3], db), da);
+    }
+    return xyz;
+}
+
+template <typename G>
+inline void SoA::LoadStencil(const G &grid, int c, const index_v &ind, float_v v[4][4],
+                             bool wide) const
+{
+    if (wide) {
+        const float *m = &fXYZ[c * std::size_t(grid.fN)];
+        for (int j = 0; j < 4; ++j) {
+            for (int i = 0; i < 4; ++i) {
+                v[i][j] = float_v(m + i, ind + j * grid.fNA);
+            }
+        }
+        return;
+    }
+    const index_v first = ind + c * grid.fN;
+    for (int j = 0; j < 4; ++j) {
+        Vc::tie(v[0][j], v[1][j], v[2][j], v[3][j]) = fXYZ[first + j * grid.fNA];
+    }
+}
+
+template <typename G>
+inline Point3 SoA::GetValue(LinearKernel, const G &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    Point3 xyz;
+    const float *m0 = &fXYZ[a.first + b.first * grid.fNA];
+    for (int c = 0; c < 3; ++c, m0 += grid.fN) {
+        const float *m1 = m0 + grid.fNA;
+        xyz[c] = GetSpline1(GetSpline1(m0[0], m0[1], a.second),
+                            GetSpline1(m1[0], m1[1], a.second), b.second);
+    }
+    return xyz;
+}
+
+template <typename G>
+inline Point3V SoA::GetValue(LinearKernel, const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const index_v ind0 = a.first + b.first * grid.fNA;
+    const index_v ind1 = ind0 + grid.fNA;
+    Point3V xyz;
+    for (int c = 0; c < 3; ++c) {
+        const float *m = &fXYZ[c * std::size_t(grid.fN)];
+        xyz[c] = GetSpline1(GetSpline1(float_v(m, ind0), float_v(m, ind0 + 1), a.second),
+                            GetSpline1(float_v(m, ind1), float_v(m, ind1 + 1), a.second),
+                            b.second);
+    }
+    return xyz;
+}
+
+template <typename G>
+inline Point3 SoA::GetValue(QuadraticKernel, const G &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    Point3 xyz;
+    const float *m = &fXYZ[a.first + b.first * grid.fNA];
+    for (int c = 0; c < 3; ++c, m += grid.fN) {
+        float v[3];
+        for (int j = 0; j < 3; ++j) {
+            v[j] = GetSpline2(m + j * grid.fNA, a.second);
+        }
+        xyz[c] = GetSpline2(v, b.second);
     }
     return xyz;
 }
 
-inline Spline2::Spline2(float minA, float maxA, int nBinsA, float minB,  //{{{1
-                        float maxB, int nBinsB)
-    : fNA(nBinsA < 4 ? 4 : nBinsA)
-    , fNB(nBinsB < 4 ? 4 : nBinsB)
-    , fN(fNA * fNB)
-    , fMinA(minA)
-    , fMinB(minB)
-    , fStepA(((maxA <= minA ? minA + 1 : maxA) - minA) / (fNA - 1))
-    , fStepB(((maxB <= minB ? minB + 1 : maxB) - minB) / (fNB - 1))
-    , fScaleA(1.f / fStepA)
-    , fScaleB(1.f / fStepB)
-    , fXYZ(3 * fN, 0.f)
+template <typename G>
+inline Point3V SoA::GetValue(QuadraticKernel, const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    const index_v ind = a.first + b.first * grid.fNA;
+    Point3V xyz;
+    for (int c = 0; c < 3; ++c) {
+        const float *m = &fXYZ[c * std::size_t(grid.fN)];
+        float_v v[3];
+        for (int j = 0; j < 3; ++j) {
+            const index_v row = ind + j * grid.fNA;
+            const float_v x[3] = {float_v(m, row), float_v(m, row + 1),
+                                  float_v(m, row + 2)};
+            v[j] = GetSpline2(x, a.second);
+        }
+        xyz[c] = GetSpline2(v, b.second);
+    }
+    return xyz;
+}
+
+template <typename G>
+inline std::tuple<Point3, Point3, Point3> SoA::GetValueAndGradient(  //{{{1
+    const G &grid, Point2 ab) const
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    std::array<float, 3> g[3];
+    const float *m = &fXYZ[iA + iB * grid.fNA];
+    for (int c = 0; c < 3; ++c) {
+        float v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = m[i + j * grid.fNA];
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+        m += grid.fN;
+    }
+    return makeGradient<Point3>(g);
+}
+
+template <typename G>
+inline std::tuple<Point3V, Point3V, Point3V> SoA::GetValueAndGradient(  //{{{1
+    const G &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    std::array<float_v, 3> g[3];
+    const index_v ind = iA + iB * grid.fNA;
+    const bool wide = !fitsIndex(3 * std::int64_t(grid.fN));
+    for (int c = 0; c < 3; ++c) {
+        float_v v[4][4];
+        LoadStencil(grid, c, ind, v, wide);
+        g[c] = GetSpline3Gradient(v, da, db);
+    }
+    return makeGradient<Point3V>(g);
+}
+
+inline SoA::SoA(const Grid &grid) : fXYZ(3 * std::size_t(grid.fN), 0.f) {}  //{{{1
+
+inline SoA::SoA(const Grid &grid, MapReader &reader)  //{{{1
+    : fXYZ(reader.Array<float>(3 * std::size_t(grid.fN)))
 {
 }
 //}}}1
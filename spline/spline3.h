@@ -52,97 +52,89 @@ This work is derived from a class in ALICE with the following copyright notice:
 //* ALICE Experiment at CERN, All rights reserved.                         *
 //* See cxx source for full Copyright notice                               *
 
-class Spline3
+/* AoS3 stores {X,Y,Z} per knot without padding, in the transposed order a + b * fNA.
+ */
+class AoS3
 {
 public:
-    Spline3(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB);
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = true;
 
-    /**  Filling of points */
-    template <typename F> void Fill(F &&func);
-    /**  Filling of points */
-    void Fill(int ind, float x, float y, float z);
-    /**  Filling of points */
-    void Fill(int ind, const float XYZ[]);
+    explicit AoS3(const Grid &grid);
+    AoS3(const Grid &grid, MapReader &reader);
 
-    /**  Get A,B by the point index */
-    std::pair<float, float> GetAB(int ind) const;
+    static const char *FileTag() { return "AoS3"; }
+    void Write(MapWriter &writer) const { writer.Write(fXYZ); }
 
-    /** Calculate interpolated value at the given point(s) */
-    Point3 GetValue(Point2) const;
-    Point3V GetValue(const Point2V &ab) const;
+    /** the floats of the knots, indexed from the start of the array */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return 3 * nA * nB;
+    }
+
+    void Fill(const Grid &grid, int ind, const float XYZ[]);
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, Point3V xyz);
+
+    Point3 GetValue(const Grid &grid, Point2 ab) const;
+    Point3V GetValue(const Grid &grid, const Point2V &ab) const;
+
+    Point3 GetValue(LinearKernel, const Grid &grid, Point2 ab) const;
+    Point3V GetValue(LinearKernel, const Grid &grid, const Point2V &ab) const;
+    Point3 GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const;
+    Point3V GetValue(QuadraticKernel, const Grid &grid, const Point2V &ab) const;
 
-    /**  Get size of the grid */
-    int GetMapSize() const;
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(const Grid &grid,
+                                                           Point2 ab) const;
+    std::tuple<Point3V, Point3V, Point3V> GetValueAndGradient(const Grid &grid,
+                                                              const Point2V &ab) const;
 
-    /**  Get N of point on the grid */
-    int GetNPoints() const;
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
 
 private:
-    /** copy constructor prohibited */
-    Spline3(const Spline3 &);
-    /** assignment operator prohibited */
-    Spline3 &operator=(const Spline3 &);
-
-    const int fNA;        // N points A axis
-    const int fNB;        // N points A axis
-    const int fN;         // N points total
-    const float fMinA;    // min A axis
-    const float fMinB;    // min B axis
-    const float fStepA;   // step between points A axis
-    const float fStepB;   // step between points B axis
-    const float fScaleA;  // scale A axis
-    const float fScaleB;  // scale B axis
-    Vc::vector<Point3> fXYZ;
+    KnotVector<Point3> fXYZ;  // array of points, {X,Y,Z} values
 };
 
-inline void Spline3::Fill(int ind, float x, float y, float z)
+inline void AoS3::Fill(const Grid &grid, int ind, const float XYZ[])
 {
-    ind = ind / fNB + fNA * (ind % fNB);
-    fXYZ[ind][0] = x;
-    fXYZ[ind][1] = y;
-    fXYZ[ind][2] = z;
+    ind = ind / grid.fNB + grid.fNA * (ind % grid.fNB);
+    fXYZ[ind][0] = XYZ[0];
+    fXYZ[ind][1] = XYZ[1];
+    fXYZ[ind][2] = XYZ[2];
 }
 
-inline void Spline3::Fill(int ind, const float XYZ[])
+inline void AoS3::Fill(const Grid &grid, const index_v &iA, const index_v &iB,
+                       Point3V xyz)
 {
-    Fill(ind, XYZ[0], XYZ[1], XYZ[2]);
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    map[iA + iB * grid.fNA] = Vc::tie(xyz[0], xyz[1], xyz[2]);
 }
 
-template <typename F> inline void Spline3::Fill(F &&func)
-{
-    for (int i = 0; i < GetNPoints(); i++) {
-        float a, b;
-        std::tie(a, b) = GetAB(i);
-        std::array<float, 3> xyz = func(a, b);
-        Fill(i, xyz[0], xyz[1], xyz[2]);
-    }
-}
+inline std::size_t AoS3::GetMapSize() const { return sizeof(Point3) * fXYZ.size(); }
 
-inline std::pair<float, float> Spline3::GetAB(int ind) const
+inline void AoS3::Prefetch(const Grid &grid, const Point2V &ab) const
 {
-    return std::make_pair(fMinA + (ind / fNA) * fStepA, fMinB + (ind % fNB) * fStepB);
+    const auto pos = grid.Position(ab);
+    prefetchStencils(&fXYZ[0], std::get<0>(pos) + std::get<1>(pos) * grid.fNA, grid.fNA,
+                     4);
 }
 
-inline int Spline3::GetMapSize() const { return 4 * sizeof(float) * fN; }
-
-inline int Spline3::GetNPoints() const { return fN; }
-
-inline Point3 Spline3::GetValue(Point2 ab) const  //{{{1
+inline Point3 AoS3::GetValue(const Grid &grid, Point2 ab) const  //{{{1
 {
-    float da1, db1;
+    StencilPosition<float> da1, db1;
     int iA, iB;
-    std::tie(iA, iB, da1, db1) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
 
     typedef Vc::SimdArray<float, 4> float4;
     typedef Vc::SimdArray<float, 12> float12;
-    const float4 da = da1;
-    const float12 db = db1;
+    const StencilPosition<float4> da = da1;
+    const StencilPosition<float12> db = db1;
 
-    const float *m0 = &fXYZ[iA + iB * fNA][0];
-    const float *m1 = m0 + fNA * 3;
-    const float *m2 = m1 + fNA * 3;
-    const float *m3 = m2 + fNA * 3;
+    const float *m0 = &fXYZ[iA + iB * grid.fNA][0];
+    const float *m1 = m0 + grid.fNA * 3;
+    const float *m2 = m1 + grid.fNA * 3;
+    const float *m3 = m2 + grid.fNA * 3;
 
     const float12 xyz = GetSpline3(float12(m0),  // x0 y0 z0 x1 y1 z1 x2 y2 z2 x3 y3 z3
                                    float12(m1), float12(m2), float12(m3), db);
@@ -156,27 +148,41 @@ inline Point3 Spline3::GetValue(Point2 ab) const  //{{{1
     return {{res[0], res[1], res[2]}};
 }
 
-Point3V Spline3::GetValue(const Point2V &ab) const  //{{{1
+inline Point3V AoS3::GetValue(const Grid &grid, const Point2V &ab) const  //{{{1
 {
     index_v iA, iB;
-    float_v da, db;
-    std::tie(iA, iB, da, db) =
-        evaluatePosition(ab, {{fMinA, fMinB}}, {{fScaleA, fScaleB}}, fNA, fNB);
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
 
     float_v vx[4];
     float_v vy[4];
     float_v vz[4];
-    auto ind = iA + iB * fNA;
-    for (int i = 0; i < 4; i++) {
-        float_v x[4], y[4], z[4];
-        Vc::tie(x[0], y[0], z[0]) = fXYZ[ind][0];
-        Vc::tie(x[1], y[1], z[1]) = fXYZ[ind + fNA][0];
-        Vc::tie(x[2], y[2], z[2]) = fXYZ[ind + 2 * fNA][0];
-        Vc::tie(x[3], y[3], z[3]) = fXYZ[ind + 3 * fNA][0];
-        vx[i] = GetSpline3<float_v>(x[0], x[1], x[2], x[3], db);
-        vy[i] = GetSpline3<float_v>(y[0], y[1], y[2], y[3], db);
-        vz[i] = GetSpline3<float_v>(z[0], z[1], z[2], z[3], db);
-        ind += 1;
+    auto ind = iA + iB * grid.fNA;
+    if (all_of(ind == ind[0])) {
+        // all lanes in the same cell: broadcast the stencil instead of gathering it
+        const int row = 3 * grid.fNA;  // distance of the knots along B in floats
+        for (int i = 0; i < 4; i++) {
+            const float *m = &fXYZ[ind[0] + i][0];
+            vx[i] = GetSpline3<float_v>(m[0], m[row], m[2 * row], m[3 * row], db);
+            ++m;
+            vy[i] = GetSpline3<float_v>(m[0], m[row], m[2 * row], m[3 * row], db);
+            ++m;
+            vz[i] = GetSpline3<float_v>(m[0], m[row], m[2 * row], m[3 * row], db);
+        }
+    } else {
+        // 3-way deinterleaving gathers of the packed {X,Y,Z}
+        const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+        for (int i = 0; i < 4; i++) {
+            float_v x[4], y[4], z[4];
+            Vc::tie(x[0], y[0], z[0]) = map[ind];
+            Vc::tie(x[1], y[1], z[1]) = map[ind + grid.fNA];
+            Vc::tie(x[2], y[2], z[2]) = map[ind + 2 * grid.fNA];
+            Vc::tie(x[3], y[3], z[3]) = map[ind + 3 * grid.fNA];
+            vx[i] = GetSpline3<float_v>(x[0], x[1], x[2], x[3], db);
+            vy[i] = GetSpline3<float_v>(y[0], y[1], y[2], y[3], db);
+            vz[i] = GetSpline3<float_v>(z[0], z[1], z[2], z[3], db);
+            ind += 1;
+        }
     }
     Point3V XYZ;
     XYZ[0] = GetSpline3<float_v>(vx, da);
@@ -185,18 +191,148 @@ Point3V Spline3::GetValue(const Point2V &ab) const  //{{{1
     return XYZ;
 }
 
-inline Spline3::Spline3(float minA, float maxA, int nBinsA, float minB,  //{{{1
-                        float maxB, int nBinsB)
-    : fNA(nBinsA < 4 ? 4 : nBinsA)
-    , fNB(nBinsB < 4 ? 4 : nBinsB)
-    , fN(fNA * fNB)
-    , fMinA(minA)
-    , fMinB(minB)
-    , fStepA(((maxA <= minA ? minA + 1 : maxA) - minA) / (fNA - 1))
-    , fStepB(((maxB <= minB ? minB + 1 : maxB) - minB) / (fNB - 1))
-    , fScaleA(1.f / fStepA)
-    , fScaleB(1.f / fStepB)
-    , fXYZ(fN)
+inline Point3 AoS3::GetValue(LinearKernel, const Grid &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const Point3 *m0 = &fXYZ[a.first + b.first * grid.fNA];
+    const Point3 *m1 = m0 + grid.fNA;
+    Point3 XYZ;
+    for (int c = 0; c < 3; ++c) {
+        XYZ[c] = GetSpline1(GetSpline1(m0[0][c], m1[0][c], b.second),
+                            GetSpline1(m0[1][c], m1[1][c], b.second), a.second);
+    }
+    return XYZ;
+}
+
+inline Point3V AoS3::GetValue(LinearKernel, const Grid &grid,  //{{{1
+                              const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    index_v ind = a.first + b.first * grid.fNA;
+    float_v vx[2], vy[2], vz[2];
+    for (int i = 0; i < 2; i++) {
+        float_v x[2], y[2], z[2];
+        Vc::tie(x[0], y[0], z[0]) = map[ind];
+        Vc::tie(x[1], y[1], z[1]) = map[ind + grid.fNA];
+        vx[i] = GetSpline1(x[0], x[1], b.second);
+        vy[i] = GetSpline1(y[0], y[1], b.second);
+        vz[i] = GetSpline1(z[0], z[1], b.second);
+        ind += 1;
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline1(vx[0], vx[1], a.second);
+    XYZ[1] = GetSpline1(vy[0], vy[1], a.second);
+    XYZ[2] = GetSpline1(vz[0], vz[1], a.second);
+    return XYZ;
+}
+
+inline Point3 AoS3::GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    const Point3 *m = &fXYZ[a.first + b.first * grid.fNA];
+    Point3 XYZ;
+    for (int c = 0; c < 3; ++c) {
+        float v[3];
+        for (int i = 0; i < 3; i++) {
+            const float x[3] = {m[i][c], m[i + grid.fNA][c], m[i + 2 * grid.fNA][c]};
+            v[i] = GetSpline2(x, b.second);
+        }
+        XYZ[c] = GetSpline2(v, a.second);
+    }
+    return XYZ;
+}
+
+inline Point3V AoS3::GetValue(QuadraticKernel, const Grid &grid,  //{{{1
+                              const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    index_v ind = a.first + b.first * grid.fNA;
+    float_v vx[3], vy[3], vz[3];
+    for (int i = 0; i < 3; i++) {
+        float_v x[3], y[3], z[3];
+        Vc::tie(x[0], y[0], z[0]) = map[ind];
+        Vc::tie(x[1], y[1], z[1]) = map[ind + grid.fNA];
+        Vc::tie(x[2], y[2], z[2]) = map[ind + 2 * grid.fNA];
+        vx[i] = GetSpline2(x, b.second);
+        vy[i] = GetSpline2(y, b.second);
+        vz[i] = GetSpline2(z, b.second);
+        ind += 1;
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline2(vx, a.second);
+    XYZ[1] = GetSpline2(vy, a.second);
+    XYZ[2] = GetSpline2(vz, a.second);
+    return XYZ;
+}
+
+inline std::tuple<Point3, Point3, Point3> AoS3::GetValueAndGradient(  //{{{1
+    const Grid &grid, Point2 ab) const
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    std::array<float, 3> g[3];
+    const Point3 *m = &fXYZ[iA + iB * grid.fNA];
+    for (int c = 0; c < 3; ++c) {
+        float v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = m[i + j * grid.fNA][c];
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+    }
+    return makeGradient<Point3>(g);
+}
+
+inline std::tuple<Point3V, Point3V, Point3V> AoS3::GetValueAndGradient(  //{{{1
+    const Grid &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    float_v x[4][4], y[4][4], z[4][4];
+    const auto ind = iA + iB * grid.fNA;
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            Vc::tie(x[i][j], y[i][j], z[i][j]) = map[ind + (i + j * grid.fNA)];
+        }
+    }
+    const std::array<float_v, 3> g[3] = {GetSpline3Gradient(x, da, db),
+                                         GetSpline3Gradient(y, da, db),
+                                         GetSpline3Gradient(z, da, db)};
+    return makeGradient<Point3V>(g);
+}
+
+inline AoS3::AoS3(const Grid &grid) : fXYZ(grid.fN) {}  //{{{1
+
+inline AoS3::AoS3(const Grid &grid, MapReader &reader)  //{{{1
+    : fXYZ(reader.Array<Point3>(grid.fN))
 {
 }
 //}}}1
@@ -0,0 +1,568 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE3D_H_
+#define SPLINE3D_H_
+
+#include <array>
+#include <cassert>
+#include <tuple>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+// Grid3D {{{1
+/** True if the N points of the grid fit int */
+inline bool fitsPoints(std::int64_t nA, std::int64_t nB, std::int64_t nC)
+{
+    return fitsIndex(nA * nB * nC);
+}
+
+/* The uniform grid of knots of the trivariate maps. The point index of Fill and GetABC is
+ * (iA * fNB + iB) * fNC + iC for every layout.
+ *
+ * At least 4 knots per axis, the N points fit int (see fitsPoints), as the 2D Grid.
+ */
+class Grid3D
+{
+public:
+    Grid3D(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB,
+           float minC, float maxC, int nBinsC);
+
+    /**  Get A,B,C by the point index */
+    std::tuple<float, float, float> GetABC(int ind) const;
+
+    /** First knot of the 4x4x4 stencil and the position relative to its second knot */
+    std::tuple<int, int, int, float, float, float> Position(Point3 abc) const;
+    std::tuple<index_v, index_v, index_v, float_v, float_v, float_v> Position(
+        const Point3V &abc) const;
+
+    const int fNA;        // N points A axis
+    const int fNB;        // N points B axis
+    const int fNC;        // N points C axis
+    const int fN;         // N points total
+    const float fMinA;    // min A axis
+    const float fMinB;    // min B axis
+    const float fMinC;    // min C axis
+    const float fStepA;   // step between points A axis
+    const float fStepB;   // step between points B axis
+    const float fStepC;   // step between points C axis
+    const float fScaleA;  // scale A axis
+    const float fScaleB;  // scale B axis
+    const float fScaleC;  // scale C axis
+
+private:
+    /** the N points of nA x nB x nC knots, which have to fit int */
+    static int Points(std::int64_t nA, std::int64_t nB, std::int64_t nC)
+    {
+        assert(fitsPoints(nA, nB, nC));
+        return int(nA * nB * nC);
+    }
+};
+
+// Spline3D {{{1
+/* Spline3D is the map interface of the trivariate layouts, with the 2D Spline interface
+ * minus the vector Fill and the gradient:
+ *
+ *   Layout(const Grid3D &, args...);  // args are the trailing constructor arguments
+ *   // the elements the kernels index from one base, see fitsIndex
+ *   static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB,
+ *                                       std::int64_t nC);
+ *   void Fill(const Grid3D &, int ind, const float XYZ[]);
+ *   Point3 GetValue(const Grid3D &, Point3) const;
+ *   Point3V GetValue(const Grid3D &, const Point3V &) const;
+ *   std::size_t GetMapSize() const;
+ */
+template <typename Layout> class Spline3D
+{
+public:
+    template <typename... Args>
+    Spline3D(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB,
+             float minC, float maxC, int nBinsC, Args &&... layoutArgs);
+
+    /** True if the kernels of the layout index the grid of nA x nB x nC knots with int
+     * and index_v, which the constructor requires (assert) */
+    static bool FitsIndex(std::int64_t nA, std::int64_t nB, std::int64_t nC)
+    {
+        return fitsPoints(nA, nB, nC) && fitsIndex(Layout::IndexedElements(nA, nB, nC));
+    }
+
+    /**  Filling of points, func(a, b, c) returns the {x, y, z} of one knot */
+    template <typename F> auto Fill(F &&func) -> decltype(void(func(0.f, 0.f, 0.f)));
+    /**  Filling of points */
+    void Fill(int ind, float x, float y, float z);
+    /**  Filling of points */
+    void Fill(int ind, const float XYZ[]);
+
+    /**  Get A,B,C by the point index */
+    std::tuple<float, float, float> GetABC(int ind) const;
+
+    /** Calculate interpolated value at the given point(s) */
+    Point3 GetValue(Point3 abc) const;
+    Point3V GetValue(const Point3V &abc) const;
+
+    /** Calculate interpolated values for n points */
+    void GetValues(const Point3 *abc, Point3 *xyz, std::size_t n) const;
+    /** Same as above, with the points distributed over the workers of the pool */
+    void GetValues(const Point3 *abc, Point3 *xyz, std::size_t n, ThreadPool &pool) const;
+
+    /**  Get the bytes of the knots */
+    std::size_t GetMapSize() const;
+
+    /**  Get N of point on the grid */
+    int GetNPoints() const;
+
+private:
+    /** copy constructor prohibited */
+    Spline3D(const Spline3D &);
+    /** assignment operator prohibited */
+    Spline3D &operator=(const Spline3D &);
+
+    /** grid, which has to be FitsIndex, before the layout allocates its arrays */
+    static const Grid3D &Checked(const Grid3D &grid)
+    {
+        assert(FitsIndex(grid.fNA, grid.fNB, grid.fNC));
+        return grid;
+    }
+
+    const Grid3D fGrid;
+    Layout fLayout;  // the knots
+};
+
+// AoS4Volume {{{1
+/* AoS4Volume stores {X,Y,Z,0} per knot in one SimdArray<float, 4>, in the order of the
+ * point index, i.e. the 4 knots along C of a stencil are adjacent.
+ */
+class AoS4Volume
+{
+public:
+    explicit AoS4Volume(const Grid3D &grid);
+
+    /** the floats of the knots, indexed from the start of the array */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB, std::int64_t nC)
+    {
+        return 4 * nA * nB * nC;
+    }
+
+    void Fill(const Grid3D &grid, int ind, const float XYZ[]);
+
+    Point3 GetValue(const Grid3D &grid, Point3 abc) const;
+    Point3V GetValue(const Grid3D &grid, const Point3V &abc) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    typedef Vc::SimdArray<float, 4> DataPoint;
+    Vc::vector<DataPoint> fXYZ;  // array of points, {X,Y,Z,0} values
+};
+
+// SoAVolume {{{1
+/* SoAVolume stores the X, Y and Z planes of the knots one after the other, every plane
+ * in the transposed order iA + (iB + iC * fNB) * fNA, i.e. the 4 knots along A of a
+ * stencil are adjacent.
+ */
+class SoAVolume
+{
+public:
+    explicit SoAVolume(const Grid3D &grid);
+
+    /** one plane, the base of the gathers of a plane (see SoA::WideIndexKernel) */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB, std::int64_t nC)
+    {
+        return nA * nB * nC;
+    }
+
+    void Fill(const Grid3D &grid, int ind, const float XYZ[]);
+
+    Point3 GetValue(const Grid3D &grid, Point3 abc) const;
+    Point3V GetValue(const Grid3D &grid, const Point3V &abc) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    Vc::vector<float, Vc::Allocator<float>> fXYZ;  // planes of {X}, {Y}, {Z} values
+};
+
+// spline 3-rd order in 3D, 4x4x4 points {{{1
+/** v[i][j][k] is the knot (iA + i, iB + j, iC + k), interpolates along C, B and then A */
+template <typename T>
+static Vc_ALWAYS_INLINE T GetSpline3(const T v[4][4][4], T da, T db, T dc)
+{
+    T w[4];
+    for (int i = 0; i < 4; i++) {
+        T u[4];
+        for (int j = 0; j < 4; j++) {
+            u[j] = GetSpline3(v[i][j], dc);
+        }
+        w[i] = GetSpline3(u, db);
+    }
+    return GetSpline3(w, da);
+}
+
+// evaluatePosition {{{1
+inline std::tuple<int, int, int, float, float, float> evaluatePosition(
+    Point3 abc, Point3 min, Point3 scale, int na, int nb, int nc)
+{
+    const float lA = (abc[0] - min[0]) * scale[0] - 1.f;
+    const int iA = std::min(na - 4.f, std::max(lA, 0.f));
+
+    const float lB = (abc[1] - min[1]) * scale[1] - 1.f;
+    const int iB = std::min(nb - 4.f, std::max(lB, 0.f));
+
+    const float lC = (abc[2] - min[2]) * scale[2] - 1.f;
+    const int iC = std::min(nc - 4.f, std::max(lC, 0.f));
+
+    return std::make_tuple(iA, iB, iC, lA - iA, lB - iB, lC - iC);
+}
+
+inline std::tuple<index_v, index_v, index_v, float_v, float_v, float_v> evaluatePosition(
+    const Point3V &abc, Point3 min, Point3 scale, int na, int nb, int nc)
+{
+    const float_v lA = (abc[0] - min[0]) * scale[0] - 1.f;
+    const auto iA = static_cast<index_v>(std::min(na - 4.f, std::max(lA, 0.f)));
+
+    const float_v lB = (abc[1] - min[1]) * scale[1] - 1.f;
+    const auto iB = static_cast<index_v>(std::min(nb - 4.f, std::max(lB, 0.f)));
+
+    const float_v lC = (abc[2] - min[2]) * scale[2] - 1.f;
+    const auto iC = static_cast<index_v>(std::min(nc - 4.f, std::max(lC, 0.f)));
+
+    return std::make_tuple(iA, iB, iC, lA - Vc::simd_cast<float_v>(iA),
+                           lB - Vc::simd_cast<float_v>(iB),
+                           lC - Vc::simd_cast<float_v>(iC));
+}
+
+// bulk evaluation {{{1
+/* as the evaluateBulk of Point2 input, see spline.h */
+template <typename Map>
+inline void evaluateBulk(const Map &map, const Point3 *abc, Point3 *xyz, std::size_t n)
+{
+    // the wrappers are based at the batch, thus the indexes stay small for any n
+    std::size_t i = 0;
+    for (; i + float_v::Size <= n; i += float_v::Size) {
+        const auto in = Vc::make_interleave_wrapper<float_v>(abc + i);
+        auto out = Vc::make_interleave_wrapper<float_v>(xyz + i);
+        const index_v ind = index_v::IndexesFromZero();
+        Point3V p;
+        Vc::tie(p[0], p[1], p[2]) = in[ind];
+        Point3V r = map.GetValue(p);
+        out[ind] = Vc::tie(r[0], r[1], r[2]);
+    }
+    if (i < n) {
+        const int remaining = n - i;
+        const auto in = Vc::make_interleave_wrapper<float_v>(abc + i);
+        const index_v ind = Vc::min(index_v::IndexesFromZero(), index_v(remaining - 1));
+        Point3V p;
+        Vc::tie(p[0], p[1], p[2]) = in[ind];
+        storeValid(map.GetValue(p), xyz + i, remaining);
+    }
+}
+
+// Grid3D implementation {{{1
+inline Grid3D::Grid3D(float minA, float maxA, int nBinsA, float minB, float maxB,
+                      int nBinsB, float minC, float maxC, int nBinsC)
+    : fNA(nBinsA < 4 ? 4 : nBinsA)
+    , fNB(nBinsB < 4 ? 4 : nBinsB)
+    , fNC(nBinsC < 4 ? 4 : nBinsC)
+    , fN(Points(fNA, fNB, fNC))
+    , fMinA(minA)
+    , fMinB(minB)
+    , fMinC(minC)
+    , fStepA(((maxA <= minA ? minA + 1 : maxA) - minA) / (fNA - 1))
+    , fStepB(((maxB <= minB ? minB + 1 : maxB) - minB) / (fNB - 1))
+    , fStepC(((maxC <= minC ? minC + 1 : maxC) - minC) / (fNC - 1))
+    , fScaleA(1.f / fStepA)
+    , fScaleB(1.f / fStepB)
+    , fScaleC(1.f / fStepC)
+{
+}
+
+inline std::tuple<float, float, float> Grid3D::GetABC(int ind) const
+{
+    const int iAB = ind / fNC;
+    return std::make_tuple(fMinA + (iAB / fNB) * fStepA, fMinB + (iAB % fNB) * fStepB,
+                           fMinC + (ind % fNC) * fStepC);
+}
+
+inline std::tuple<int, int, int, float, float, float> Grid3D::Position(Point3 abc) const
+{
+    return evaluatePosition(abc, {{fMinA, fMinB, fMinC}}, {{fScaleA, fScaleB, fScaleC}},
+                            fNA, fNB, fNC);
+}
+
+inline std::tuple<index_v, index_v, index_v, float_v, float_v, float_v> Grid3D::Position(
+    const Point3V &abc) const
+{
+    return evaluatePosition(abc, {{fMinA, fMinB, fMinC}}, {{fScaleA, fScaleB, fScaleC}},
+                            fNA, fNB, fNC);
+}
+
+// Spline3D implementation {{{1
+template <typename Layout>
+template <typename... Args>
+inline Spline3D<Layout>::Spline3D(float minA, float maxA, int nBinsA, float minB,
+                                  float maxB, int nBinsB, float minC, float maxC,
+                                  int nBinsC, Args &&... layoutArgs)
+    : fGrid(minA, maxA, nBinsA, minB, maxB, nBinsB, minC, maxC, nBinsC)
+    , fLayout(Checked(fGrid), std::forward<Args>(layoutArgs)...)
+{
+}
+
+template <typename Layout>
+inline void Spline3D<Layout>::Fill(int ind, float x, float y, float z)
+{
+    const float XYZ[3] = {x, y, z};
+    fLayout.Fill(fGrid, ind, XYZ);
+}
+
+template <typename Layout>
+inline void Spline3D<Layout>::Fill(int ind, const float XYZ[])
+{
+    fLayout.Fill(fGrid, ind, XYZ);
+}
+
+template <typename Layout>
+template <typename F>
+inline auto Spline3D<Layout>::Fill(F &&func) -> decltype(void(func(0.f, 0.f, 0.f)))
+{
+    int i = 0;
+    for (int iA = 0; iA < fGrid.fNA; iA++) {
+        const float a = fGrid.fMinA + iA * fGrid.fStepA;
+        for (int iB = 0; iB < fGrid.fNB; iB++) {
+            const float b = fGrid.fMinB + iB * fGrid.fStepB;
+            for (int iC = 0; iC < fGrid.fNC; iC++, i++) {
+                const Point3 xyz = func(a, b, fGrid.fMinC + iC * fGrid.fStepC);
+                Fill(i, xyz.data());
+            }
+        }
+    }
+}
+
+template <typename Layout>
+inline std::tuple<float, float, float> Spline3D<Layout>::GetABC(int ind) const
+{
+    return fGrid.GetABC(ind);
+}
+
+template <typename Layout> inline Point3 Spline3D<Layout>::GetValue(Point3 abc) const
+{
+    return fLayout.GetValue(fGrid, abc);
+}
+
+template <typename Layout>
+inline Point3V Spline3D<Layout>::GetValue(const Point3V &abc) const
+{
+    return fLayout.GetValue(fGrid, abc);
+}
+
+template <typename Layout>
+inline void Spline3D<Layout>::GetValues(const Point3 *abc, Point3 *xyz,
+                                        std::size_t n) const
+{
+    evaluateBulk(*this, abc, xyz, n);
+}
+
+template <typename Layout>
+inline void Spline3D<Layout>::GetValues(const Point3 *abc, Point3 *xyz, std::size_t n,
+                                        ThreadPool &pool) const
+{
+    evaluateParallel(*this, abc, xyz, n, pool);
+}
+
+template <typename Layout> inline std::size_t Spline3D<Layout>::GetMapSize() const
+{
+    return fLayout.GetMapSize();
+}
+
+template <typename Layout> inline int Spline3D<Layout>::GetNPoints() const
+{
+    return fGrid.fN;
+}
+
+// AoS4Volume implementation {{{1
+inline AoS4Volume::AoS4Volume(const Grid3D &grid) : fXYZ(grid.fN, DataPoint::Zero()) {}
+
+inline void AoS4Volume::Fill(const Grid3D &, int ind, const float XYZ[])
+{
+    fXYZ[ind][0] = XYZ[0];
+    fXYZ[ind][1] = XYZ[1];
+    fXYZ[ind][2] = XYZ[2];
+}
+
+inline std::size_t AoS4Volume::GetMapSize() const
+{
+    return sizeof(DataPoint) * fXYZ.size();
+}
+
+inline Point3 AoS4Volume::GetValue(const Grid3D &grid, Point3 abc) const
+{
+    float da, db, dc;
+    int iA, iB, iC;
+    std::tie(iA, iB, iC, da, db, dc) = grid.Position(abc);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    const float4 *m = &fXYZ[(iA * grid.fNB + iB) * grid.fNC + iC];
+    float4 v[4][4][4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            for (int k = 0; k < 4; k++) {
+                v[i][j][k] = m[(i * grid.fNB + j) * grid.fNC + k];
+            }
+        }
+    }
+    const float4 res = GetSpline3(v, float4(da), float4(db), float4(dc));
+    return {{res[0], res[1], res[2]}};
+}
+
+inline Point3V AoS4Volume::GetValue(const Grid3D &grid, const Point3V &abc) const
+{
+    index_v iA, iB, iC;
+    float_v da, db, dc;
+    std::tie(iA, iB, iC, da, db, dc) = grid.Position(abc);
+
+    float_v x[4][4][4], y[4][4][4], z[4][4][4];
+    const index_v ind = (iA * grid.fNB + iB) * grid.fNC + iC;
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            const index_v row = ind + (i * grid.fNB + j) * grid.fNC;
+            for (int k = 0; k < 4; k++) {
+                Vc::tie(x[i][j][k], y[i][j][k], z[i][j][k]) = map[row + k];
+            }
+        }
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline3(x, da, db, dc);
+    XYZ[1] = GetSpline3(y, da, db, dc);
+    XYZ[2] = GetSpline3(z, da, db, dc);
+    return XYZ;
+}
+
+// SoAVolume implementation {{{1
+inline SoAVolume::SoAVolume(const Grid3D &grid) : fXYZ(3 * std::size_t(grid.fN)) {}
+
+inline void SoAVolume::Fill(const Grid3D &grid, int ind, const float XYZ[])
+{
+    const int iC = ind % grid.fNC;
+    const int iAB = ind / grid.fNC;
+    ind = iAB / grid.fNB + (iAB % grid.fNB + iC * grid.fNB) * grid.fNA;
+    const std::size_t n = grid.fN;  // distance of the planes
+    fXYZ[ind] = XYZ[0];
+    fXYZ[ind + n] = XYZ[1];
+    fXYZ[ind + 2 * n] = XYZ[2];
+}
+
+inline std::size_t SoAVolume::GetMapSize() const { return sizeof(float) * fXYZ.size(); }
+
+inline Point3 SoAVolume::GetValue(const Grid3D &grid, Point3 abc) const
+{
+    float da1, db1, dc1;
+    int iA, iB, iC;
+    std::tie(iA, iB, iC, da1, db1, dc1) = grid.Position(abc);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    typedef Vc::SimdArray<float, 12> float12;
+    const float4 da = da1;
+    const float12 db = db1;
+    const float12 dc = dc1;
+
+    // the 4 knots along A of X, Y and Z in one float12, interpolated along C and B
+    const std::size_t n = grid.fN;  // distance of the planes
+    const float *m = &fXYZ[iA + (iB + iC * grid.fNB) * grid.fNA];
+    float12 w[4];
+    for (int j = 0; j < 4; j++) {
+        float12 u[4];
+        for (int k = 0; k < 4; k++) {
+            const float *r = m + (j + k * grid.fNB) * grid.fNA;
+            u[k] = Vc::simd_cast<float12>(float4(r), float4(r + n), float4(r + 2 * n));
+        }
+        w[j] = GetSpline3(u, dc);
+    }
+    const float12 xyz = GetSpline3(w, db);
+
+    float4 v[4];
+    Vc::tie(v[0], v[1], v[2], v[3]) =
+        Vc::transpose(Vc::simd_cast<float4, 0>(xyz), Vc::simd_cast<float4, 1>(xyz),
+                      Vc::simd_cast<float4, 2>(xyz), float4::Zero());
+
+    const float4 res = GetSpline3(v[0], v[1], v[2], v[3], da);
+    return {{res[0], res[1], res[2]}};
+}
+
+inline Point3V SoAVolume::GetValue(const Grid3D &grid, const Point3V &abc) const
+{
+    index_v iA, iB, iC;
+    float_v da, db, dc;
+    std::tie(iA, iB, iC, da, db, dc) = grid.Position(abc);
+
+    Point3V xyz;
+    const index_v ind = iA + (iB + iC * grid.fNB) * grid.fNA;
+    // the index vector reaches the 3 planes, or gathers from the base of every plane
+    const bool wide = !fitsIndex(3 * std::int64_t(grid.fN));
+    for (int c = 0; c < 3; ++c) {
+        // the 4 knots along A of each lane in one deinterleaving load
+        float_v v[4][4][4];
+        const float *m = &fXYZ[c * std::size_t(grid.fN)];
+        for (int j = 0; j < 4; j++) {
+            for (int k = 0; k < 4; k++) {
+                const index_v row = ind + (j + k * grid.fNB) * grid.fNA;
+                if (wide) {
+                    for (int i = 0; i < 4; ++i) {
+                        v[i][j][k] = float_v(m + i, row);
+                    }
+                } else {
+                    Vc::tie(v[0][j][k], v[1][j][k], v[2][j][k], v[3][j][k]) =
+                        fXYZ[row + c * grid.fN];
+                }
+            }
+        }
+        xyz[c] = GetSpline3(v, da, db, dc);
+    }
+    return xyz;
+}
+//}}}1
+
+#endif  // SPLINE3D_H_
+
+// vim: foldmethod=marker
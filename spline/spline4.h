@@ -0,0 +1,340 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE4_H_
+#define SPLINE4_H_
+
+#include <utility>
+#include <array>
+#include <tuple>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+/* Coefficients stores the 16 polynomial coefficients of the bicubic patch of every cell
+ * instead of the knots. Evaluation is a 2D Horner scheme on one contiguous block of 16
+ * {X,Y,Z,0} values. The knots are kept as well, such that Fill of a single knot can
+ * update the coefficients of the (up to 16) cells that depend on it.
+ */
+class Coefficients
+{
+public:
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = false;
+
+    explicit Coefficients(const Grid &grid);
+    /** the knots and the coefficients of the file */
+    Coefficients(const Grid &grid, MapReader &reader);
+
+    static const char *FileTag() { return "Coefficients"; }
+    void Write(MapWriter &writer) const;
+
+    /** the floats of the knots or, more for large grids, of the 16 coefficients
+     * of every cell */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return std::max(4 * nA * nB, 64 * (nA - 3) * (nB - 3));
+    }
+
+    void Fill(const Grid &grid, int ind, const float XYZ[]);
+    /** stores the knots only, UpdateCells computes the coefficients from them */
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, Point3V xyz);
+    /** Recompute the coefficients of the cells [beginA, endA) x [0, fNCellsB) */
+    void UpdateCells(const Grid &grid, int beginA, int endA);
+
+    Point3 GetValue(const Grid &grid, Point2 ab) const;
+    Point3V GetValue(const Grid &grid, const Point2V &ab) const;
+
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(const Grid &grid,
+                                                           Point2 ab) const;
+    std::tuple<Point3V, Point3V, Point3V> GetValueAndGradient(const Grid &grid,
+                                                              const Point2V &ab) const;
+
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    /** GetSpline3(v0, v1, v2, v3, p) == sum over q of p.fX^q * sum over k of M[q][k] *
+     * v_k, M of the tangent weights {p.fT0, p.fT1} of the cell (see Grid::TangentsA) */
+    typedef float Matrix[4][4];
+    static void M(Point2 tangents, Matrix &m);
+
+    const int fNCellsB;  // N cells B axis
+    typedef Vc::SimdArray<float, 4> DataPoint;
+    KnotVector<DataPoint> fXYZ;    // array of points, {X,Y,Z,0} values
+    KnotVector<DataPoint> fCoeff;  // 16 coefficients per cell, {X,Y,Z,0} values
+};
+
+inline void Coefficients::M(Point2 tangents, Matrix &m)
+{
+    const float t0 = tangents[0], t1 = tangents[1];
+    const Matrix t = {{0.f, 1.f, 0.f, 0.f},
+                      {-t0, 0.f, t0, 0.f},
+                      {2.f * t0, t1 - 3.f, 3.f - 2.f * t0, -t1},
+                      {-t0, 2.f - t1, t0 - 2.f, t1}};
+    std::copy(&t[0][0], &t[0][0] + 16, &m[0][0]);
+}
+
+inline void Coefficients::Fill(const Grid &grid, int ind, const float XYZ[])
+{
+    DataPoint xyz = DataPoint::Zero();
+    xyz[0] = XYZ[0];
+    xyz[1] = XYZ[1];
+    xyz[2] = XYZ[2];
+    const DataPoint delta = xyz - fXYZ[ind];
+    fXYZ[ind] = xyz;
+
+    // the coefficients are linear in the knots: add the change of this knot to every
+    // cell that has it in its 4x4 stencil
+    const int a = ind / grid.fNB;
+    const int b = ind % grid.fNB;
+    Matrix mA, mB;
+    for (int iA = std::max(0, a - 3); iA <= std::min(a, grid.fNA - 4); ++iA) {
+        M(grid.TangentsA(iA), mA);
+        for (int iB = std::max(0, b - 3); iB <= std::min(b, grid.fNB - 4); ++iB) {
+            M(grid.TangentsB(iB), mB);
+            DataPoint *c = &fCoeff[16 * (iA * fNCellsB + iB)];
+            const int k = a - iA;
+            const int l = b - iB;
+            for (int p = 0; p < 4; ++p) {
+                for (int q = 0; q < 4; ++q) {
+                    c[4 * p + q] += (mA[p][k] * mB[q][l]) * delta;
+                }
+            }
+        }
+    }
+}
+
+inline void Coefficients::Fill(const Grid &grid, const index_v &iA, const index_v &iB,
+                               Point3V xyz)
+{
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fXYZ[0]);
+    map[iA * grid.fNB + iB] = Vc::tie(xyz[0], xyz[1], xyz[2]);
+}
+
+inline void Coefficients::UpdateCells(const Grid &grid, int beginA, int endA)
+{
+    Matrix mA, mB;
+    for (int iA = beginA; iA < endA; ++iA) {
+        M(grid.TangentsA(iA), mA);
+        for (int iB = 0; iB < fNCellsB; ++iB) {
+            M(grid.TangentsB(iB), mB);
+            // t[k][q] = sum over l of MB[q][l] * knot(iA + k, iB + l)
+            DataPoint t[4][4];
+            for (int k = 0; k < 4; ++k) {
+                const DataPoint *v = &fXYZ[(iA + k) * grid.fNB + iB];
+                for (int q = 0; q < 4; ++q) {
+                    t[k][q] = mB[q][0] * v[0] + mB[q][1] * v[1] + mB[q][2] * v[2] +
+                              mB[q][3] * v[3];
+                }
+            }
+            DataPoint *c = &fCoeff[16 * (iA * fNCellsB + iB)];
+            for (int p = 0; p < 4; ++p) {
+                for (int q = 0; q < 4; ++q) {
+                    c[4 * p + q] = mA[p][0] * t[0][q] + mA[p][1] * t[1][q] +
+                                   mA[p][2] * t[2][q] + mA[p][3] * t[3][q];
+                }
+            }
+        }
+    }
+}
+
+inline std::size_t Coefficients::GetMapSize() const
+{
+    return sizeof(DataPoint) * (fXYZ.size() + fCoeff.size());
+}
+
+inline void Coefficients::Prefetch(const Grid &grid, const Point2V &ab) const
+{
+    // the 16 coefficients of the cell are one block, as 4 rows of 4
+    const auto pos = grid.Position(ab);
+    prefetchStencils(&fCoeff[0], (std::get<0>(pos) * fNCellsB + std::get<1>(pos)) * 16,
+                     4, 4);
+}
+
+// polynomial 3-rd order, c[0] + c[1] x + c[2] x^2 + c[3] x^3 {{{1
+template <typename T> static Vc_ALWAYS_INLINE T GetHorner3(T c0, T c1, T c2, T c3, T x)
+{
+    return ((c3 * x + c2) * x + c1) * x + c0;
+}
+
+template <typename T> static Vc_ALWAYS_INLINE T GetHorner3(const T c[], T x)
+{
+    return GetHorner3(c[0], c[1], c[2], c[3], x);
+}
+
+// derivative of GetHorner3 by x {{{1
+template <typename T> static Vc_ALWAYS_INLINE T GetHorner3Derivative(const T c[], T x)
+{
+    return (3.f * c[3] * x + 2.f * c[2]) * x + c[1];
+}
+
+inline Point3 Coefficients::GetValue(const Grid &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da1, db1;
+    int iA, iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    const float4 da = da1.fX;  // the coefficients include the tangent weights
+    const float4 db = db1.fX;
+
+    const float4 *c = &fCoeff[16 * (iA * fNCellsB + iB)];
+    const float4 res = GetHorner3(GetHorner3(c, db), GetHorner3(c + 4, db),
+                                  GetHorner3(c + 8, db), GetHorner3(c + 12, db), da);
+    return {{res[0], res[1], res[2]}};
+}
+
+inline Point3V Coefficients::GetValue(const Grid &grid, const Point2V &ab) const  //{{{1
+{
+    index_v iA, iB;
+    StencilPosition<float_v> pA, pB;
+    std::tie(iA, iB, pA, pB) = grid.Position(ab);
+    const float_v &da = pA.fX, &db = pB.fX;
+
+    float_v vx[4];
+    float_v vy[4];
+    float_v vz[4];
+    auto ind = (iA * fNCellsB + iB) * 16;
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fCoeff[0]);
+    for (int p = 0; p < 4; p++) {
+        float_v x[4], y[4], z[4];
+        Vc::tie(x[0], y[0], z[0]) = map[ind];
+        Vc::tie(x[1], y[1], z[1]) = map[ind + 1];
+        Vc::tie(x[2], y[2], z[2]) = map[ind + 2];
+        Vc::tie(x[3], y[3], z[3]) = map[ind + 3];
+        vx[p] = GetHorner3(x, db);
+        vy[p] = GetHorner3(y, db);
+        vz[p] = GetHorner3(z, db);
+        ind += 4;
+    }
+    Point3V XYZ;
+    XYZ[0] = GetHorner3(vx, da);
+    XYZ[1] = GetHorner3(vy, da);
+    XYZ[2] = GetHorner3(vz, da);
+    return XYZ;
+}
+
+inline std::tuple<Point3, Point3, Point3> Coefficients::GetValueAndGradient(  //{{{1
+    const Grid &grid, Point2 ab) const
+{
+    StencilPosition<float> da1, db1;
+    int iA, iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    const float4 da = da1.fX;  // the coefficients include the tangent weights
+    const float4 db = db1.fX;
+
+    const float4 *c = &fCoeff[16 * (iA * fNCellsB + iB)];
+    float4 w[4], dw[4];
+    for (int p = 0; p < 4; p++) {
+        w[p] = GetHorner3(c + 4 * p, db);
+        dw[p] = GetHorner3Derivative(c + 4 * p, db);
+    }
+    const float4 v = GetHorner3(w, da);
+    const float4 vA = GetHorner3Derivative(w, da);
+    const float4 vB = GetHorner3(dw, da);
+    return std::make_tuple(Point3{{v[0], v[1], v[2]}}, Point3{{vA[0], vA[1], vA[2]}},
+                           Point3{{vB[0], vB[1], vB[2]}});
+}
+
+inline std::tuple<Point3V, Point3V, Point3V> Coefficients::GetValueAndGradient(  //{{{1
+    const Grid &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> pA, pB;
+    std::tie(iA, iB, pA, pB) = grid.Position(ab);
+    const float_v &da = pA.fX, &db = pB.fX;
+
+    float_v w[3][4], dw[3][4];
+    auto ind = (iA * fNCellsB + iB) * 16;
+    const auto map = Vc::make_interleave_wrapper<float_v>(&fCoeff[0]);
+    for (int p = 0; p < 4; p++) {
+        float_v x[4], y[4], z[4];
+        Vc::tie(x[0], y[0], z[0]) = map[ind];
+        Vc::tie(x[1], y[1], z[1]) = map[ind + 1];
+        Vc::tie(x[2], y[2], z[2]) = map[ind + 2];
+        Vc::tie(x[3], y[3], z[3]) = map[ind + 3];
+        w[0][p] = GetHorner3(x, db);
+        w[1][p] = GetHorner3(y, db);
+        w[2][p] = GetHorner3(z, db);
+        dw[0][p] = GetHorner3Derivative(x, db);
+        dw[1][p] = GetHorner3Derivative(y, db);
+        dw[2][p] = GetHorner3Derivative(z, db);
+        ind += 4;
+    }
+    std::array<float_v, 3> g[3];
+    for (int c = 0; c < 3; c++) {
+        g[c] = {{GetHorner3(w[c], da), GetHorner3Derivative(w[c], da),
+                 GetHorner3(dw[c], da)}};
+    }
+    return makeGradient<Point3V>(g);
+}
+
+inline Coefficients::Coefficients(const Grid &grid)  //{{{1
+    : fNCellsB(grid.fNB - 3)
+    , fXYZ(grid.fN, DataPoint::Zero())
+    , fCoeff(16 * (grid.fNA - 3) * fNCellsB, DataPoint::Zero())
+{
+}
+
+inline Coefficients::Coefficients(const Grid &grid, MapReader &reader)  //{{{1
+    : fNCellsB(grid.fNB - 3)
+    , fXYZ(reader.Array<DataPoint>(grid.fN))
+    , fCoeff(reader.Array<DataPoint>(16 * (grid.fNA - 3) * fNCellsB))
+{
+}
+
+inline void Coefficients::Write(MapWriter &writer) const  //{{{1
+{
+    writer.Write(fXYZ);
+    writer.Write(fCoeff);
+}
+//}}}1
+
+#endif  // SPLINE4_H_
+
+// vim: foldmethod=marker
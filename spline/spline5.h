@@ -0,0 +1,306 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE5_H_
+#define SPLINE5_H_
+
+#include <utility>
+#include <array>
+#include <tuple>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline2.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+/* Morton stores the X, Y and Z planes like SoA, but in tiles of 16x16 knots. Inside a
+ * tile the knots are in Z-order (Morton order), thus every aligned 4x4 block of one
+ * component is a single cache line and a 4x4 stencil touches at most four of them. The
+ * X, Y and Z tiles of the same knots are adjacent, the tiles are row-major.
+ *
+ * The index of knot (a, b) is separable: fOffA[a] + fOffB[b].
+ */
+class Morton
+{
+public:
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = false;
+
+    explicit Morton(const Grid &grid);
+    /** the tiles of the file, the offsets are recomputed from the grid */
+    Morton(const Grid &grid, MapReader &reader);
+
+    static const char *FileTag() { return "Morton"; }
+    void Write(MapWriter &writer) const { writer.Write(fXYZ); }
+
+    /** the floats of the tiles, indexed from the start of the array */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return 3 * TileArea * ((nA + TileSize - 1) / TileSize) *
+               ((nB + TileSize - 1) / TileSize);
+    }
+
+    void Fill(const Grid &grid, int ind, const float XYZ[]);
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, Point3V xyz);
+
+    Point3 GetValue(const Grid &grid, Point2 ab) const;
+    Point3V GetValue(const Grid &grid, const Point2V &ab) const;
+
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(const Grid &grid,
+                                                           Point2 ab) const;
+    std::tuple<Point3V, Point3V, Point3V> GetValueAndGradient(const Grid &grid,
+                                                              const Point2V &ab) const;
+
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    enum {
+        TileBits = 4,
+        TileSize = 1 << TileBits,         // N points per tile and axis
+        TileArea = TileSize * TileSize,  // N points per tile and component
+    };
+
+    /** Morton code of one axis: bit i of x goes to bit 2i */
+    static int Spread(int x);
+    void InitOffsets(const Grid &grid);
+
+    const int fNTilesA;   // N tiles A axis
+    const int fNTilesB;   // N tiles B axis
+    Vc::vector<int> fOffA;  // offset of the knots with index a on the A axis
+    Vc::vector<int> fOffB;  // offset of the knots with index b on the B axis
+    KnotVector<float> fXYZ;  // tiles of {X}, {Y}, {Z} values
+};
+
+inline int Morton::Spread(int x)
+{
+    int r = 0;
+    for (int bit = 0; bit < TileBits; ++bit) {
+        r |= (x & (1 << bit)) << bit;
+    }
+    return r;
+}
+
+inline void Morton::Fill(const Grid &grid, int ind, const float XYZ[])
+{
+    ind = fOffA[ind / grid.fNB] + fOffB[ind % grid.fNB];
+    fXYZ[ind] = XYZ[0];
+    fXYZ[ind + TileArea] = XYZ[1];
+    fXYZ[ind + 2 * TileArea] = XYZ[2];
+}
+
+inline void Morton::Fill(const Grid &, const index_v &iA, const index_v &iB, Point3V xyz)
+{
+    const index_v ind = index_v(&fOffA[0], iA) + index_v(&fOffB[0], iB);
+    xyz[0].scatter(&fXYZ[0], ind);
+    xyz[1].scatter(&fXYZ[TileArea], ind);
+    xyz[2].scatter(&fXYZ[2 * TileArea], ind);
+}
+
+inline std::size_t Morton::GetMapSize() const { return sizeof(float) * fXYZ.size(); }
+
+inline void Morton::Prefetch(const Grid &grid, const Point2V &ab) const
+{
+    // the corners of the stencil are in the (up to) four 4x4 blocks it touches
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const index_v oA[2] = {index_v(&fOffA[0], iA), index_v(&fOffA[0], iA + 3)};
+    const index_v oB[2] = {index_v(&fOffB[0], iB), index_v(&fOffB[0], iB + 3)};
+    for (std::size_t l = 0; l < index_v::Size; ++l) {
+        for (int c = 0; c < 3; ++c) {
+            const float *m = &fXYZ[c * TileArea];
+            Vc::prefetchClose(m + oA[0][l] + oB[0][l]);
+            Vc::prefetchClose(m + oA[0][l] + oB[1][l]);
+            Vc::prefetchClose(m + oA[1][l] + oB[0][l]);
+            Vc::prefetchClose(m + oA[1][l] + oB[1][l]);
+        }
+    }
+}
+
+inline Point3 Morton::GetValue(const Grid &grid, Point2 ab) const  //{{{1
+{
+    StencilPosition<float> da1, db1;
+    int iA, iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    typedef Vc::SimdArray<float, 12> float12;
+    typedef Vc::SimdArray<int, 12> int12;
+    const StencilPosition<float4> da = da1;
+    const StencilPosition<float12> db = db1;
+
+    // lane 4 * component + row
+    int12 rows;
+    for (int i = 0; i < 4; ++i) {
+        const int o = fOffA[iA + i];
+        rows[i] = o;
+        rows[i + 4] = o + TileArea;
+        rows[i + 8] = o + 2 * TileArea;
+    }
+    const float *m = &fXYZ[0];
+    const int *oB = &fOffB[iB];
+    const float12 xyz =
+        GetSpline3(float12(m, rows + oB[0]), float12(m, rows + oB[1]),
+                   float12(m, rows + oB[2]), float12(m, rows + oB[3]), db);
+
+    float4 v[4];
+    Vc::tie(v[0], v[1], v[2], v[3]) =
+        Vc::transpose(Vc::simd_cast<float4, 0>(xyz), Vc::simd_cast<float4, 1>(xyz),
+                      Vc::simd_cast<float4, 2>(xyz), float4::Zero());
+
+    float4 res = GetSpline3(v[0], v[1], v[2], v[3], da);
+    return {{res[0], res[1], res[2]}};
+}
+
+inline Point3V Morton::GetValue(const Grid &grid, const Point2V &ab) const  //{{{1
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    index_v oA[4], oB[4];
+    for (int i = 0; i < 4; ++i) {
+        oA[i] = index_v(&fOffA[0], iA + i);
+        oB[i] = index_v(&fOffB[0], iB + i);
+    }
+
+    Point3V xyz;
+    const float *m = &fXYZ[0];
+    for (int c = 0; c < 3; ++c) {
+        float_v v[4];
+        for (int i = 0; i < 4; ++i) {
+            v[i] = GetSpline3(float_v(m, oA[i] + oB[0]), float_v(m, oA[i] + oB[1]),
+                              float_v(m, oA[i] + oB[2]), float_v(m, oA[i] + oB[3]), db);
+        }
+        xyz[c] = GetSpline3(v, da);
+        m += TileArea;
+    }
+    return xyz;
+}
+
+inline std::tuple<Point3, Point3, Point3> Morton::GetValueAndGradient(  //{{{1
+    const Grid &grid, Point2 ab) const
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    std::array<float, 3> g[3];
+    const float *m = &fXYZ[0];
+    for (int c = 0; c < 3; ++c) {
+        float v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = m[fOffA[iA + i] + fOffB[iB + j]];
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+        m += TileArea;
+    }
+    return makeGradient<Point3>(g);
+}
+
+inline std::tuple<Point3V, Point3V, Point3V> Morton::GetValueAndGradient(  //{{{1
+    const Grid &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    index_v oA[4], oB[4];
+    for (int i = 0; i < 4; ++i) {
+        oA[i] = index_v(&fOffA[0], iA + i);
+        oB[i] = index_v(&fOffB[0], iB + i);
+    }
+
+    std::array<float_v, 3> g[3];
+    const float *m = &fXYZ[0];
+    for (int c = 0; c < 3; ++c) {
+        float_v v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = float_v(m, oA[i] + oB[j]);
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+        m += TileArea;
+    }
+    return makeGradient<Point3V>(g);
+}
+
+inline Morton::Morton(const Grid &grid)  //{{{1
+    : fNTilesA((grid.fNA + TileSize - 1) / TileSize)
+    , fNTilesB((grid.fNB + TileSize - 1) / TileSize)
+    , fOffA(grid.fNA)
+    , fOffB(grid.fNB)
+    , fXYZ(3 * TileArea * std::size_t(fNTilesA) * fNTilesB, 0.f)
+{
+    InitOffsets(grid);
+}
+
+inline Morton::Morton(const Grid &grid, MapReader &reader)  //{{{1
+    : fNTilesA((grid.fNA + TileSize - 1) / TileSize)
+    , fNTilesB((grid.fNB + TileSize - 1) / TileSize)
+    , fOffA(grid.fNA)
+    , fOffB(grid.fNB)
+    , fXYZ(reader.Array<float>(3 * TileArea * std::size_t(fNTilesA) * fNTilesB))
+{
+    InitOffsets(grid);
+}
+
+inline void Morton::InitOffsets(const Grid &grid)  //{{{1
+{
+    // A gets the odd and B the even bits of the Morton code
+    for (int a = 0; a < grid.fNA; ++a) {
+        fOffA[a] = (a / TileSize) * fNTilesB * 3 * TileArea + 2 * Spread(a % TileSize);
+    }
+    for (int b = 0; b < grid.fNB; ++b) {
+        fOffB[b] = (b / TileSize) * 3 * TileArea + Spread(b % TileSize);
+    }
+}
+//}}}1
+
+#endif  // SPLINE5_H_
+
+// vim: foldmethod=marker
@@ -0,0 +1,493 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE6_H_
+#define SPLINE6_H_
+
+#include <utility>
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline2.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+/* Knot codecs for Quantized. A codec stores one component of a knot in 16 bits and widens
+ * it to float in the loads/gathers of the kernels. The value range of the map is
+ * handled by Quantized, the codecs only see values in [-Range(), Range()].
+ */
+// Int16Knot {{{1
+/** Fixed point: 16 bits, uniform absolute precision 1/32767 of the value range. */
+struct Int16Knot
+{
+    typedef short Storage;
+
+    static const char *Name() { return "Int16"; }
+    static float Range() { return 32767.f; }
+
+    static Storage Encode(float x)
+    {
+        return static_cast<Storage>(std::nearbyint(std::max(-32767.f, std::min(32767.f, x))));
+    }
+
+    static float Decode(Storage x) { return x; }
+
+    template <typename V> static Vc_ALWAYS_INLINE V Load(const Storage *m) { return V(m); }
+
+    template <typename V, typename I>
+    static Vc_ALWAYS_INLINE V Gather(const Storage *m, const I &ind)
+    {
+        return V(m, ind);
+    }
+};
+
+// HalfKnot {{{1
+/** IEEE 754 binary16: 11 significant bits, i.e. a relative precision of 2^-11. */
+struct HalfKnot
+{
+    typedef unsigned short Storage;
+
+    static const char *Name() { return "Half"; }
+    static float Range() { return 1.f; }
+
+    static Storage Encode(float x)
+    {
+        const Storage sign = std::signbit(x) ? 0x8000 : 0;
+        const float a = std::abs(x);
+        if (a == 0.f) {
+            return sign;
+        } else if (!(a < 65520.f)) {
+            return sign | 0x7bff;  // the largest finite half instead of inf or NaN
+        }
+        int e;
+        std::frexp(a, &e);
+        // value = m * 2^(E - 25), E = 0 is subnormal and m == 2048 carries into E
+        const int E = std::max(e + 14, 1);
+        const int m = std::nearbyint(std::ldexp(a, 25 - E));
+        return sign | (((E - 1) << 10) + m);
+    }
+
+    static float Decode(Storage x) { return Decode<Vc::SimdArray<float, 1>>(x)[0]; }
+
+    template <typename V> static Vc_ALWAYS_INLINE V Load(const Storage *m)
+    {
+        return Decode<V>(typename V::IndexType(m));
+    }
+
+    template <typename V, typename I>
+    static Vc_ALWAYS_INLINE V Gather(const Storage *m, const I &ind)
+    {
+        return Decode<V>(typename V::IndexType(m, ind));
+    }
+
+    /** No bit casts: the biased exponent looks up the power of two in a tiny table. */
+    template <typename V> static Vc_ALWAYS_INLINE V Decode(typename V::IndexType h)
+    {
+        const auto e = (h >> 10) & 31;
+        const auto m = (h & 1023) | (((e + 31) >> 5) << 10);  // implicit bit if e != 0
+        const V sign = V::One() - 2 * Vc::simd_cast<V>(h >> 15);
+        return sign * Vc::simd_cast<V>(m) * V(Pow2(), e);
+    }
+
+    /** 2^(max(e, 1) - 25) for the 5 bit biased exponent e */
+    static const float *Pow2()
+    {
+        struct Table {
+            float data[32];
+            Table()
+            {
+                for (int e = 0; e < 32; ++e) {
+                    data[e] = std::ldexp(1.f, std::max(e, 1) - 25);
+                }
+            }
+        };
+        static const Table table;
+        return table.data;
+    }
+};
+
+// Quantized {{{1
+/* Quantized stores the knots like AoS3 ({X,Y,Z} interleaved, transposed index), but
+ * with 16 bit per component, i.e. 6 instead of 16 (AoS4) or 12 (SoA/AoS3) bytes per
+ * knot. The value range [minXYZ, maxXYZ] of every component is mapped onto the range of
+ * the codec, values outside of it are clamped by Int16Knot. The spline weights add up to
+ * 1, thus the kernels interpolate the widened codec values and apply scale and offset
+ * once to the result.
+ */
+template <typename Knot> class Quantized
+{
+public:
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = true;
+
+    explicit Quantized(const Grid &grid, Point3 minXYZ = {{-1.f, -1.f, -1.f}},
+                       Point3 maxXYZ = {{1.f, 1.f, 1.f}});
+    /** the knots, scale and offset of the file */
+    Quantized(const Grid &grid, MapReader &reader);
+
+    static const char *FileTag() { return Knot::Name(); }
+    void Write(MapWriter &writer) const;
+
+    /** the codec values of the knots, indexed from the start of the array */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return 3 * nA * nB;
+    }
+
+    void Fill(const Grid &grid, int ind, const float XYZ[]);
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, Point3V xyz);
+
+    Point3 GetValue(const Grid &grid, Point2 ab) const;
+    Point3V GetValue(const Grid &grid, const Point2V &ab) const;
+
+    Point3 GetValue(LinearKernel, const Grid &grid, Point2 ab) const;
+    Point3V GetValue(LinearKernel, const Grid &grid, const Point2V &ab) const;
+    Point3 GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const;
+    Point3V GetValue(QuadraticKernel, const Grid &grid, const Point2V &ab) const;
+
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(const Grid &grid,
+                                                           Point2 ab) const;
+    std::tuple<Point3V, Point3V, Point3V> GetValueAndGradient(const Grid &grid,
+                                                              const Point2V &ab) const;
+
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    typedef typename Knot::Storage Storage;
+
+    Point3 fScale;  // value = fOffset + fScale * decoded knot, per component
+    Point3 fOffset;
+    KnotVector<Storage> fXYZ;  // array of points, {X,Y,Z} codec values
+};
+
+template <typename Knot>
+inline void Quantized<Knot>::Fill(const Grid &grid, int ind, const float XYZ[])
+{
+    ind = ind / grid.fNB + grid.fNA * (ind % grid.fNB);
+    fXYZ[3 * ind + 0] = Knot::Encode((XYZ[0] - fOffset[0]) / fScale[0]);
+    fXYZ[3 * ind + 1] = Knot::Encode((XYZ[1] - fOffset[1]) / fScale[1]);
+    fXYZ[3 * ind + 2] = Knot::Encode((XYZ[2] - fOffset[2]) / fScale[2]);
+}
+
+template <typename Knot>
+inline void Quantized<Knot>::Fill(const Grid &grid, const index_v &iA, const index_v &iB,
+                                  Point3V xyz)
+{
+    const index_v ind = (iA + iB * grid.fNA) * 3;
+    for (int c = 0; c < 3; ++c) {
+        const float_v v = (xyz[c] - fOffset[c]) / fScale[c];
+        for (std::size_t i = 0; i < float_v::Size; ++i) {
+            fXYZ[ind[i] + c] = Knot::Encode(v[i]);
+        }
+    }
+}
+
+template <typename Knot> inline std::size_t Quantized<Knot>::GetMapSize() const
+{
+    return sizeof(Storage) * fXYZ.size();
+}
+
+template <typename Knot>
+inline void Quantized<Knot>::Prefetch(const Grid &grid, const Point2V &ab) const
+{
+    const auto pos = grid.Position(ab);
+    prefetchStencils(&fXYZ[0], (std::get<0>(pos) + std::get<1>(pos) * grid.fNA) * 3,
+                     3 * grid.fNA, 3 * 4);
+}
+
+template <typename Knot>  //{{{1
+inline Point3 Quantized<Knot>::GetValue(const Grid &grid, Point2 ab) const
+{
+    StencilPosition<float> da1, db1;
+    int iA, iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+
+    typedef Vc::SimdArray<float, 4> float4;
+    typedef Vc::SimdArray<float, 12> float12;
+    const StencilPosition<float4> da = da1;
+    const StencilPosition<float12> db = db1;
+
+    const Storage *m0 = &fXYZ[3 * (iA + iB * grid.fNA)];
+    const Storage *m1 = m0 + grid.fNA * 3;
+    const Storage *m2 = m1 + grid.fNA * 3;
+    const Storage *m3 = m2 + grid.fNA * 3;
+
+    const float12 xyz =  // x0 y0 z0 x1 y1 z1 x2 y2 z2 x3 y3 z3
+        GetSpline3(Knot::template Load<float12>(m0), Knot::template Load<float12>(m1),
+                   Knot::template Load<float12>(m2), Knot::template Load<float12>(m3), db);
+
+    const float4 t0 = Vc::simd_cast<float4, 0>(xyz);  // x0 y0 z0 x1
+    const float4 t1 = Vc::simd_cast<float4, 1>(xyz);  // y1 z1 x2 y2
+    const float4 t2 = Vc::simd_cast<float4, 2>(xyz);  // z2 x3 y3 z3
+
+    const float4 res =
+        GetSpline3(t0, t0.shifted(3, t1), t1.shifted(2, t2), t2.shifted(1), da);
+    return {{res[0] * fScale[0] + fOffset[0], res[1] * fScale[1] + fOffset[1],
+             res[2] * fScale[2] + fOffset[2]}};
+}
+
+template <typename Knot>  //{{{1
+inline Point3V Quantized<Knot>::GetValue(const Grid &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    float_v vx[4];
+    float_v vy[4];
+    float_v vz[4];
+    const Storage *m = &fXYZ[0];
+    auto ind = (iA + iB * grid.fNA) * 3;
+    for (int i = 0; i < 4; i++) {
+        float_v x[4], y[4], z[4];
+        for (int j = 0; j < 4; j++) {
+            const auto k = ind + j * 3 * grid.fNA;
+            x[j] = Knot::template Gather<float_v>(m, k);
+            y[j] = Knot::template Gather<float_v>(m + 1, k);
+            z[j] = Knot::template Gather<float_v>(m + 2, k);
+        }
+        vx[i] = GetSpline3(x, db);
+        vy[i] = GetSpline3(y, db);
+        vz[i] = GetSpline3(z, db);
+        ind += 3;
+    }
+    Point3V XYZ;
+    XYZ[0] = GetSpline3(vx, da) * fScale[0] + fOffset[0];
+    XYZ[1] = GetSpline3(vy, da) * fScale[1] + fOffset[1];
+    XYZ[2] = GetSpline3(vz, da) * fScale[2] + fOffset[2];
+    return XYZ;
+}
+
+template <typename Knot>  //{{{1
+inline Point3 Quantized<Knot>::GetValue(LinearKernel, const Grid &grid, Point2 ab) const
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const Storage *m = &fXYZ[3 * (a.first + b.first * grid.fNA)];
+    Point3 XYZ;
+    for (int c = 0; c < 3; ++c) {
+        float v[2][2];
+        for (int i = 0; i < 2; ++i) {
+            for (int j = 0; j < 2; ++j) {
+                v[i][j] = Knot::Decode(m[3 * (i + j * grid.fNA) + c]);
+            }
+        }
+        const float r = GetSpline1(GetSpline1(v[0][0], v[0][1], b.second),
+                                   GetSpline1(v[1][0], v[1][1], b.second), a.second);
+        XYZ[c] = r * fScale[c] + fOffset[c];
+    }
+    return XYZ;
+}
+
+template <typename Knot>  //{{{1
+inline Point3V Quantized<Knot>::GetValue(LinearKernel, const Grid &grid,
+                                         const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    Point3V XYZ;
+    const Storage *m = &fXYZ[0];
+    const auto ind = (a.first + b.first * grid.fNA) * 3;
+    for (int c = 0; c < 3; ++c) {
+        float_v v[2][2];
+        for (int i = 0; i < 2; ++i) {
+            for (int j = 0; j < 2; ++j) {
+                const auto k = ind + 3 * (i + j * grid.fNA);
+                v[i][j] = Knot::template Gather<float_v>(m + c, k);
+            }
+        }
+        const float_v r = GetSpline1(GetSpline1(v[0][0], v[0][1], b.second),
+                                     GetSpline1(v[1][0], v[1][1], b.second), a.second);
+        XYZ[c] = r * fScale[c] + fOffset[c];
+    }
+    return XYZ;
+}
+
+template <typename Knot>  //{{{1
+inline Point3 Quantized<Knot>::GetValue(QuadraticKernel, const Grid &grid,
+                                        Point2 ab) const
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    const Storage *m = &fXYZ[3 * (a.first + b.first * grid.fNA)];
+    Point3 XYZ;
+    for (int c = 0; c < 3; ++c) {
+        float v[3];
+        for (int i = 0; i < 3; ++i) {
+            float x[3];
+            for (int j = 0; j < 3; ++j) {
+                x[j] = Knot::Decode(m[3 * (i + j * grid.fNA) + c]);
+            }
+            v[i] = GetSpline2(x, b.second);
+        }
+        XYZ[c] = GetSpline2(v, a.second) * fScale[c] + fOffset[c];
+    }
+    return XYZ;
+}
+
+template <typename Knot>  //{{{1
+inline Point3V Quantized<Knot>::GetValue(QuadraticKernel, const Grid &grid,
+                                         const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    Point3V XYZ;
+    const Storage *m = &fXYZ[0];
+    const auto ind = (a.first + b.first * grid.fNA) * 3;
+    for (int c = 0; c < 3; ++c) {
+        float_v v[3];
+        for (int i = 0; i < 3; ++i) {
+            float_v x[3];
+            for (int j = 0; j < 3; ++j) {
+                const auto k = ind + 3 * (i + j * grid.fNA);
+                x[j] = Knot::template Gather<float_v>(m + c, k);
+            }
+            v[i] = GetSpline2(x, b.second);
+        }
+        XYZ[c] = GetSpline2(v, a.second) * fScale[c] + fOffset[c];
+    }
+    return XYZ;
+}
+
+template <typename Knot>  //{{{1
+inline std::tuple<Point3, Point3, Point3> Quantized<Knot>::GetValueAndGradient(
+    const Grid &grid, Point2 ab) const
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    std::array<float, 3> g[3];
+    const Storage *m = &fXYZ[3 * (iA + iB * grid.fNA)];
+    for (int c = 0; c < 3; ++c) {
+        float v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = Knot::Decode(m[3 * (i + j * grid.fNA) + c]);
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+        g[c][0] = g[c][0] * fScale[c] + fOffset[c];
+        g[c][1] *= fScale[c];
+        g[c][2] *= fScale[c];
+    }
+    return makeGradient<Point3>(g);
+}
+
+template <typename Knot>  //{{{1
+inline std::tuple<Point3V, Point3V, Point3V> Quantized<Knot>::GetValueAndGradient(
+    const Grid &grid, const Point2V &ab) const
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    std::array<float_v, 3> g[3];
+    const Storage *m = &fXYZ[0];
+    const auto ind = (iA + iB * grid.fNA) * 3;
+    for (int c = 0; c < 3; ++c) {
+        float_v v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                const auto k = ind + 3 * (i + j * grid.fNA);
+                v[i][j] = Knot::template Gather<float_v>(m + c, k);
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+        g[c][0] = g[c][0] * fScale[c] + fOffset[c];
+        g[c][1] *= fScale[c];
+        g[c][2] *= fScale[c];
+    }
+    return makeGradient<Point3V>(g);
+}
+
+template <typename Knot>  //{{{1
+inline Quantized<Knot>::Quantized(const Grid &grid, Point3 minXYZ, Point3 maxXYZ)
+    : fXYZ(3 * std::size_t(grid.fN), 0)
+{
+    for (int i = 0; i < 3; ++i) {
+        const float range = maxXYZ[i] <= minXYZ[i] ? 1.f : maxXYZ[i] - minXYZ[i];
+        fScale[i] = 0.5f * range / Knot::Range();
+        fOffset[i] = minXYZ[i] + 0.5f * range;
+    }
+}
+
+template <typename Knot>  //{{{1
+inline Quantized<Knot>::Quantized(const Grid &grid, MapReader &reader)
+    : fXYZ(reader.Array<Storage>(3 * std::size_t(grid.fN)))
+{
+    reader.Read(&fScale, 1);
+    reader.Read(&fOffset, 1);
+}
+
+template <typename Knot>  //{{{1
+inline void Quantized<Knot>::Write(MapWriter &writer) const
+{
+    writer.Write(fXYZ);
+    writer.Write(&fScale, 1);
+    writer.Write(&fOffset, 1);
+}
+//}}}1
+
+#endif  // SPLINE6_H_
+
+// vim: foldmethod=marker
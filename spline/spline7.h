@@ -0,0 +1,385 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE7_H_
+#define SPLINE7_H_
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+/* Packed<N> stores the N components of a knot in one SimdArray, padded to the width of
+ * whole registers: 4 floats up to N = 4, 8 (one AVX register) up to N = 8 and multiples
+ * of 8 beyond. The scalar kernel evaluates all components of a knot at once. N = 1 is
+ * not padded, its scalar kernel vectorizes over the 4 knots of a stencil row instead.
+ * The vector kernel is horizontal, one point per lane, for every N.
+ */
+template <int N> class Packed
+{
+    static_assert(N > 0, "a knot has at least one component");
+
+public:
+    static constexpr int Components = N;
+    static constexpr bool Transposed = false;
+
+    typedef std::array<float, N> Value;
+    typedef Vc::simdize<Value> ValueV;
+
+    explicit Packed(const Grid &grid);
+    Packed(const Grid &grid, MapReader &reader);
+
+    /** Packed1, Packed3, ...: maps of another N do not load */
+    static const char *FileTag()
+    {
+        static const std::string tag = "Packed" + std::to_string(N);
+        return tag.c_str();
+    }
+    void Write(MapWriter &writer) const { writer.Write(fData); }
+
+    /** the floats of the knots, indexed from the start of the array */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return Width * nA * nB;
+    }
+
+    void Fill(const Grid &grid, int ind, const float values[]);
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, ValueV values);
+
+    Value GetValue(const Grid &grid, Point2 ab) const;
+    ValueV GetValue(const Grid &grid, const Point2V &ab) const;
+    Value GetValue(LinearKernel, const Grid &grid, Point2 ab) const;
+    ValueV GetValue(LinearKernel, const Grid &grid, const Point2V &ab) const;
+    Value GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const;
+    ValueV GetValue(QuadraticKernel, const Grid &grid, const Point2V &ab) const;
+
+    std::tuple<Value, Value, Value> GetValueAndGradient(const Grid &grid,
+                                                        Point2 ab) const;
+    std::tuple<ValueV, ValueV, ValueV> GetValueAndGradient(const Grid &grid,
+                                                           const Point2V &ab) const;
+
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    // floats per knot
+    static constexpr int Width = N == 1 ? 1 : N <= 4 ? 4 : (N + 7) / 8 * 8;
+    typedef Vc::SimdArray<float, Width> Knot;
+
+    Knot LoadKnot(int ind) const { return Knot(&fData[ind * Width]); }
+    static Value ToValue(const Knot &knot);
+
+    /** the scalar kernel of N = 1 and of the padded knots */
+    Value GetValue(const Grid &grid, Point2 ab, std::true_type) const;
+    Value GetValue(const Grid &grid, Point2 ab, std::false_type) const;
+
+    KnotVector<float> fData;  // array of knots, N values and 0 padding
+};
+
+template <int N>
+inline Packed<N>::Packed(const Grid &grid)  //{{{1
+    : fData(grid.fN * std::size_t(Width), 0.f)
+{
+}
+
+template <int N>
+inline Packed<N>::Packed(const Grid &grid, MapReader &reader)  //{{{1
+    : fData(reader.Array<float>(grid.fN * std::size_t(Width)))
+{
+}
+
+template <int N>
+inline void Packed<N>::Fill(const Grid &, int ind, const float values[])  //{{{1
+{
+    std::copy(values, values + N, &fData[ind * Width]);
+}
+
+template <int N>
+inline void Packed<N>::Fill(const Grid &grid, const index_v &iA, const index_v &iB,
+                            ValueV values)
+{
+    const index_v ind = (iA * grid.fNB + iB) * Width;
+    for (int c = 0; c < N; ++c) {
+        values[c].scatter(&fData[c], ind);
+    }
+}
+
+template <int N> inline std::size_t Packed<N>::GetMapSize() const  //{{{1
+{
+    return sizeof(float) * fData.size();
+}
+
+template <int N>
+inline void Packed<N>::Prefetch(const Grid &grid, const Point2V &ab) const  //{{{1
+{
+    const auto pos = grid.Position(ab);
+    prefetchStencils(&fData[0], (std::get<0>(pos) * grid.fNB + std::get<1>(pos)) * Width,
+                     grid.fNB * Width, 4 * Width);
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(const Grid &grid, Point2 ab) const -> Value  //{{{1
+{
+    return GetValue(grid, ab, std::integral_constant<bool, N == 1>());
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(const Grid &grid, Point2 ab, std::true_type) const
+    -> Value
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    // the 4 knots of a stencil row are contiguous: interpolate the rows along A first
+    typedef Vc::SimdArray<float, 4> float4;
+    const float *m0 = &fData[iA * grid.fNB + iB];
+    const float *m1 = m0 + grid.fNB;
+    const float *m2 = m1 + grid.fNB;
+    const float *m3 = m2 + grid.fNB;
+    const float4 v =
+        GetSpline3<float4>(float4(m0), float4(m1), float4(m2), float4(m3), da);
+    return {{GetSpline3(v[0], v[1], v[2], v[3], db)}};
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(const Grid &grid, Point2 ab, std::false_type) const
+    -> Value
+{
+    StencilPosition<float> da1, db1;
+    int iA, iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+    int ind = iA * grid.fNB + iB;
+
+    const StencilPosition<Knot> da = da1;
+    const StencilPosition<Knot> db = db1;
+
+    Knot v[4];
+    for (int i = 0; i < 4; i++) {
+        v[i] = GetSpline3(LoadKnot(ind), LoadKnot(ind + 1), LoadKnot(ind + 2),
+                          LoadKnot(ind + 3), db);
+        ind += grid.fNB;
+    }
+    return ToValue(GetSpline3(v, da));
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(const Grid &grid, const Point2V &ab) const  //{{{1
+    -> ValueV
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    const index_v ind = (iA * grid.fNB + iB) * Width;
+    const int row = grid.fNB * Width;  // distance of the stencil rows in floats
+    ValueV r;
+    for (int c = 0; c < N; ++c) {
+        const float *m = &fData[c];
+        float_v v[4];
+        for (int i = 0; i < 4; i++) {
+            const index_v k = ind + i * row;
+            v[i] = GetSpline3(float_v(m, k), float_v(m, k + Width),
+                              float_v(m, k + 2 * Width), float_v(m, k + 3 * Width), db);
+        }
+        r[c] = GetSpline3(v, da);
+    }
+    return r;
+}
+
+template <int N>
+inline auto Packed<N>::ToValue(const Knot &knot) -> Value  //{{{1
+{
+    Value r;
+    for (int c = 0; c < N; ++c) {
+        r[c] = knot[c];
+    }
+    return r;
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(LinearKernel, const Grid &grid, Point2 ab) const  //{{{1
+    -> Value
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const int ind = a.first * grid.fNB + b.first;
+    const Knot x = b.second;
+    return ToValue(GetSpline1(GetSpline1(LoadKnot(ind), LoadKnot(ind + 1), x),
+                              GetSpline1(LoadKnot(ind + grid.fNB),
+                                         LoadKnot(ind + grid.fNB + 1), x),
+                              Knot(a.second)));
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(LinearKernel, const Grid &grid, const Point2V &ab) const
+    -> ValueV
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = linearStencil(iA, da.fX, grid.fNA);
+    const auto b = linearStencil(iB, db.fX, grid.fNB);
+
+    const index_v ind0 = (a.first * grid.fNB + b.first) * Width;
+    const index_v ind1 = ind0 + grid.fNB * Width;
+    ValueV r;
+    for (int c = 0; c < N; ++c) {
+        const float *m = &fData[c];
+        r[c] = GetSpline1(
+            GetSpline1(float_v(m, ind0), float_v(m, ind0 + Width), b.second),
+            GetSpline1(float_v(m, ind1), float_v(m, ind1 + Width), b.second), a.second);
+    }
+    return r;
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(QuadraticKernel, const Grid &grid, Point2 ab) const
+    -> Value
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    int ind = a.first * grid.fNB + b.first;
+    const Knot x = b.second;
+    Knot v[3];
+    for (int i = 0; i < 3; i++) {
+        const Knot row[3] = {LoadKnot(ind), LoadKnot(ind + 1), LoadKnot(ind + 2)};
+        v[i] = GetSpline2(row, x);
+        ind += grid.fNB;
+    }
+    return ToValue(GetSpline2(v, Knot(a.second)));
+}
+
+template <int N>
+inline auto Packed<N>::GetValue(QuadraticKernel, const Grid &grid,
+                                const Point2V &ab) const -> ValueV
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const auto a = quadraticStencil(iA, da.fX, grid.fNA);
+    const auto b = quadraticStencil(iB, db.fX, grid.fNB);
+
+    const index_v ind = (a.first * grid.fNB + b.first) * Width;
+    const int row = grid.fNB * Width;  // distance of the stencil rows in floats
+    ValueV r;
+    for (int c = 0; c < N; ++c) {
+        const float *m = &fData[c];
+        float_v v[3];
+        for (int i = 0; i < 3; i++) {
+            const index_v k = ind + i * row;
+            const float_v x[3] = {float_v(m, k), float_v(m, k + Width),
+                                  float_v(m, k + 2 * Width)};
+            v[i] = GetSpline2(x, b.second);
+        }
+        r[c] = GetSpline2(v, a.second);
+    }
+    return r;
+}
+
+template <int N>
+inline auto Packed<N>::GetValueAndGradient(const Grid &grid, Point2 ab) const  //{{{1
+    -> std::tuple<Value, Value, Value>
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const int ind = iA * grid.fNB + iB;
+
+    Knot v[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            v[i][j] = LoadKnot(ind + i * grid.fNB + j);
+        }
+    }
+    const std::array<Knot, 3> g = GetSpline3Gradient<Knot>(v, da, db);
+    Value value, dA, dB;
+    for (int c = 0; c < N; ++c) {
+        value[c] = g[0][c];
+        dA[c] = g[1][c];
+        dB[c] = g[2][c];
+    }
+    return std::make_tuple(value, dA, dB);
+}
+
+template <int N>
+inline auto Packed<N>::GetValueAndGradient(const Grid &grid, const Point2V &ab) const
+    -> std::tuple<ValueV, ValueV, ValueV>
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    const index_v ind = (iA * grid.fNB + iB) * Width;
+    std::array<float_v, 3> g[N];
+    for (int c = 0; c < N; ++c) {
+        const float *m = &fData[c];
+        float_v v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = float_v(m, ind + (i * grid.fNB + j) * Width);
+            }
+        }
+        g[c] = GetSpline3Gradient(v, da, db);
+    }
+    return makeGradient<ValueV>(g);
+}
+//}}}1
+
+#endif  // SPLINE7_H_
+
+// vim: foldmethod=marker
@@ -0,0 +1,306 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE8_H_
+#define SPLINE8_H_
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+/* Planes<Knot, T> stores the X, Y and Z planes of the knots like SoA, with knots of type
+ * Knot, and evaluates in T: Planes<double> stores and evaluates double, the mixed
+ * Planes<float, double> keeps the float knots (and the memory traffic of SoA) and
+ * accumulates in double. Planes<float> is the float baseline of the same kernels.
+ *
+ * The position in the stencil is computed in T as well, from the float knot positions of
+ * the grid: (x - knot 1) / (knot 2 - knot 1), and so are the tangent weights (see
+ * StencilPosition) and the scale of the gradient, 1 / (knot 2 - knot 1), which the
+ * kernels apply themselves (ScaledGradient) instead of the float Grid::Scale.
+ *
+ * The vector kernel evaluates the float_v::Size points of a Point2V in
+ * SimdArray<T, float_v::Size>, i.e. in 2 double_v per float_v for T = double.
+ */
+template <typename K, typename T = K> class Planes
+{
+public:
+    typedef K Knot;
+    typedef T Scalar;
+    static constexpr int Components = 3;
+    static constexpr bool Transposed = true;
+    static constexpr bool ScaledGradient = true;
+
+    typedef std::array<T, 3> Value;
+    typedef SimdValue<T, 3> ValueV;
+
+    explicit Planes(const Grid &grid) : fXYZ(3 * std::size_t(grid.fN), Knot(0)) {}
+    Planes(const Grid &grid, MapReader &reader)
+        : fXYZ(reader.Array<Knot>(3 * std::size_t(grid.fN)))
+    {
+    }
+
+    static const char *FileTag()
+    {
+        return std::is_same<Knot, double>::value ? "Planes64" : "Planes32";
+    }
+    void Write(MapWriter &writer) const { writer.Write(fXYZ); }
+
+    /** one plane, the base of the gathers of a plane */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return nA * nB;
+    }
+
+    void Fill(const Grid &grid, int ind, const T XYZ[]);
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, ValueV xyz);
+
+    Value GetValue(const Grid &grid, Point2 ab) const;
+    ValueV GetValue(const Grid &grid, const Point2V &ab) const;
+
+    std::tuple<Value, Value, Value> GetValueAndGradient(const Grid &grid,
+                                                        Point2 ab) const;
+    std::tuple<ValueV, ValueV, ValueV> GetValueAndGradient(const Grid &grid,
+                                                           const Point2V &ab) const;
+
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const { return sizeof(Knot) * fXYZ.size(); }
+
+private:
+    typedef typename ValueV::value_type V;  // T of float_v::Size points
+    typedef typename std::conditional<std::is_same<Knot, float>::value, float_v,
+                                      Vc::SimdArray<Knot, float_v::Size>>::type KnotV;
+
+    /** The position of x in the stencil of the knots k0..k3, relative to k1 and k2 */
+    static StencilPosition<T> Offset(float x, float k0, float k1, float k2, float k3)
+    {
+        const T step = T(k2) - k1;
+        return {(T(x) - k1) / step, step / (T(k2) - k0), step / (T(k3) - k1)};
+    }
+    static StencilPosition<V> Offset(const float_v &x, const float_v &k0,
+                                     const float_v &k1, const float_v &k2,
+                                     const float_v &k3)
+    {
+        const V k = Vc::simd_cast<V>(k1), kEnd = Vc::simd_cast<V>(k2);
+        const V step = kEnd - k;
+        return {(Vc::simd_cast<V>(x) - k) / step, step / (kEnd - Vc::simd_cast<V>(k0)),
+                step / (Vc::simd_cast<V>(k3) - k)};
+    }
+
+    /** The inverse distance of the knots k1 and k2, the scale of the gradient */
+    static T InvStep(float k1, float k2) { return T(1) / (T(k2) - k1); }
+    static V InvStep(const float_v &k1, const float_v &k2)
+    {
+        return V(1) / (Vc::simd_cast<V>(k2) - Vc::simd_cast<V>(k1));
+    }
+
+    /** The 4x4 stencils of the component c at the points: v[i][j] is the knot
+     * (iA + i, iB + j) */
+    void Load(const Grid &grid, int c, int ind, T v[4][4]) const;
+    void Load(const Grid &grid, int c, const index_v &ind, V v[4][4]) const;
+
+    KnotVector<Knot> fXYZ;  // planes of {X}, {Y}, {Z} values
+};
+
+template <typename K, typename T>  //{{{1
+inline void Planes<K, T>::Fill(const Grid &grid, int ind, const T XYZ[])
+{
+    ind = ind / grid.fNB + grid.fNA * (ind % grid.fNB);
+    for (int c = 0; c < 3; ++c) {
+        fXYZ[ind + c * std::size_t(grid.fN)] = XYZ[c];
+    }
+}
+
+template <typename K, typename T>  //{{{1
+inline void Planes<K, T>::Fill(const Grid &grid, const index_v &iA, const index_v &iB,
+                               ValueV xyz)
+{
+    const index_v ind = iA + iB * grid.fNA;
+    for (int c = 0; c < 3; ++c) {
+        for (std::size_t l = 0; l < index_v::Size; ++l) {
+            fXYZ[ind[l] + c * std::size_t(grid.fN)] = xyz[c][l];
+        }
+    }
+}
+
+template <typename K, typename T>  //{{{1
+inline void Planes<K, T>::Prefetch(const Grid &grid, const Point2V &ab) const
+{
+    const auto pos = grid.Position(ab);
+    const index_v ind = std::get<0>(pos) + std::get<1>(pos) * grid.fNA;
+    for (int c = 0; c < 3; ++c) {
+        prefetchStencils(&fXYZ[c * std::size_t(grid.fN)], ind, grid.fNA, 4);
+    }
+}
+
+template <typename K, typename T>  //{{{1
+inline void Planes<K, T>::Load(const Grid &grid, int c, int ind, T v[4][4]) const
+{
+    const Knot *m = &fXYZ[ind + c * std::size_t(grid.fN)];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            v[i][j] = m[i + j * grid.fNA];
+        }
+    }
+}
+
+template <typename K, typename T>  //{{{1
+inline void Planes<K, T>::Load(const Grid &grid, int c, const index_v &ind,
+                               V v[4][4]) const
+{
+    const Knot *m = &fXYZ[c * std::size_t(grid.fN)];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            v[i][j] = Vc::simd_cast<V>(KnotV(m, ind + (i + j * grid.fNA)));
+        }
+    }
+}
+
+template <typename K, typename T>  //{{{1
+inline auto Planes<K, T>::GetValue(const Grid &grid, Point2 ab) const -> Value
+{
+    int iA, iB;
+    StencilPosition<float> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const StencilPosition<T> a = Offset(ab[0], grid.KnotA(iA), grid.KnotA(iA + 1),
+                                         grid.KnotA(iA + 2), grid.KnotA(iA + 3));
+    const StencilPosition<T> b = Offset(ab[1], grid.KnotB(iB), grid.KnotB(iB + 1),
+                                         grid.KnotB(iB + 2), grid.KnotB(iB + 3));
+
+    Value xyz;
+    for (int c = 0; c < 3; ++c) {
+        T v[4][4];
+        Load(grid, c, iA + iB * grid.fNA, v);
+        T w[4];
+        for (int i = 0; i < 4; ++i) {
+            w[i] = GetSpline3(v[i], b);
+        }
+        xyz[c] = GetSpline3(w, a);
+    }
+    return xyz;
+}
+
+template <typename K, typename T>  //{{{1
+inline auto Planes<K, T>::GetValue(const Grid &grid, const Point2V &ab) const -> ValueV
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const StencilPosition<V> a = Offset(ab[0], grid.KnotA(iA), grid.KnotA(iA + 1),
+                                         grid.KnotA(iA + 2), grid.KnotA(iA + 3));
+    const StencilPosition<V> b = Offset(ab[1], grid.KnotB(iB), grid.KnotB(iB + 1),
+                                         grid.KnotB(iB + 2), grid.KnotB(iB + 3));
+
+    ValueV xyz;
+    for (int c = 0; c < 3; ++c) {
+        V v[4][4];
+        Load(grid, c, iA + iB * grid.fNA, v);
+        V w[4];
+        for (int i = 0; i < 4; ++i) {
+            w[i] = GetSpline3(v[i], b);
+        }
+        xyz[c] = GetSpline3(w, a);
+    }
+    return xyz;
+}
+
+template <typename K, typename T>  //{{{1
+inline auto Planes<K, T>::GetValueAndGradient(const Grid &grid, Point2 ab) const
+    -> std::tuple<Value, Value, Value>
+{
+    int iA, iB;
+    StencilPosition<float> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const StencilPosition<T> a = Offset(ab[0], grid.KnotA(iA), grid.KnotA(iA + 1),
+                                         grid.KnotA(iA + 2), grid.KnotA(iA + 3));
+    const StencilPosition<T> b = Offset(ab[1], grid.KnotB(iB), grid.KnotB(iB + 1),
+                                         grid.KnotB(iB + 2), grid.KnotB(iB + 3));
+
+    const T scaleA = InvStep(grid.KnotA(iA + 1), grid.KnotA(iA + 2));
+    const T scaleB = InvStep(grid.KnotB(iB + 1), grid.KnotB(iB + 2));
+
+    std::array<T, 3> g[3];
+    for (int c = 0; c < 3; ++c) {
+        T v[4][4];
+        Load(grid, c, iA + iB * grid.fNA, v);
+        g[c] = GetSpline3Gradient(v, a, b);
+        g[c][1] *= scaleA;
+        g[c][2] *= scaleB;
+    }
+    return makeGradient<Value>(g);
+}
+
+template <typename K, typename T>  //{{{1
+inline auto Planes<K, T>::GetValueAndGradient(const Grid &grid, const Point2V &ab) const
+    -> std::tuple<ValueV, ValueV, ValueV>
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const StencilPosition<V> a = Offset(ab[0], grid.KnotA(iA), grid.KnotA(iA + 1),
+                                         grid.KnotA(iA + 2), grid.KnotA(iA + 3));
+    const StencilPosition<V> b = Offset(ab[1], grid.KnotB(iB), grid.KnotB(iB + 1),
+                                         grid.KnotB(iB + 2), grid.KnotB(iB + 3));
+
+    const V scaleA = InvStep(grid.KnotA(iA + 1), grid.KnotA(iA + 2));
+    const V scaleB = InvStep(grid.KnotB(iB + 1), grid.KnotB(iB + 2));
+
+    std::array<V, 3> g[3];
+    for (int c = 0; c < 3; ++c) {
+        V v[4][4];
+        Load(grid, c, iA + iB * grid.fNA, v);
+        g[c] = GetSpline3Gradient(v, a, b);
+        g[c][1] *= scaleA;
+        g[c][2] *= scaleB;
+    }
+    return makeGradient<ValueV>(g);
+}
+//}}}1
+
+#endif  // SPLINE8_H_
+
+// vim: foldmethod=marker
@@ -0,0 +1,268 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+
+This work is derived from a class in ALICE with the following copyright notice:
+    **************************************************************************
+    * This file is property of and copyright by the ALICE HLT Project        *
+    * ALICE Experiment at CERN, All rights reserved.                         *
+    *                                                                        *
+    * Primary Authors: Sergey Gorbunov <sergey.gorbunov@cern.ch>             *
+    *                  for The ALICE HLT Project.                            *
+    *                                                                        *
+    * Permission to use, copy, modify and distribute this software and its   *
+    * documentation strictly for non-commercial purposes is hereby granted   *
+    * without fee, provided that the above copyright notice appears in all   *
+    * copies and that both the copyright notice and this permission notice   *
+    * appear in the supporting documentation. The authors make no claims     *
+    * about the suitability of this software for any purpose. It is          *
+    * provided "as is" without express or implied warranty.                  *
+    **************************************************************************
+}}}*/
+
+#ifndef SPLINE9_H_
+#define SPLINE9_H_
+
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <Vc/Vc>
+#include <Vc/vector>
+#include "spline.h"
+
+//* This file is property of and copyright by the ALICE HLT Project        *
+//* ALICE Experiment at CERN, All rights reserved.                         *
+//* See cxx source for full Copyright notice                               *
+
+/* Group<M> holds M maps of {X,Y,Z} knots over one grid, e.g. the components and
+ * correction layers of a distortion, component c of map m is the component 3 * m + c of
+ * the values. The kernels compute the stencil and the position in it once for all maps
+ * and then evaluate the knot arrays of the maps one after the other, i.e. a point costs
+ * one Grid::Position and M stencils.
+ *
+ * Every map is an array of {X,Y,Z,0} knots in the order of the point index. The
+ * interleaved alternative, one stencil of all maps, is Packed<3 * M>.
+ */
+template <int M> class Group
+{
+    static_assert(M > 0, "a group has at least one map");
+
+public:
+    static constexpr int Components = 3 * M;
+    static constexpr bool Transposed = false;
+
+    typedef std::array<float, Components> Value;
+    typedef Vc::simdize<Value> ValueV;
+
+    explicit Group(const Grid &grid);
+    Group(const Grid &grid, MapReader &reader);
+
+    static const char *FileTag() { return "Group"; }
+    void Write(MapWriter &writer) const;
+
+    /** the floats of one of the maps, the base of its gathers */
+    static std::int64_t IndexedElements(std::int64_t nA, std::int64_t nB)
+    {
+        return 4 * nA * nB;
+    }
+
+    void Fill(const Grid &grid, int ind, const float values[]);
+    void Fill(const Grid &grid, const index_v &iA, const index_v &iB, ValueV values);
+
+    Value GetValue(const Grid &grid, Point2 ab) const;
+    ValueV GetValue(const Grid &grid, const Point2V &ab) const;
+
+    std::tuple<Value, Value, Value> GetValueAndGradient(const Grid &grid,
+                                                        Point2 ab) const;
+    std::tuple<ValueV, ValueV, ValueV> GetValueAndGradient(const Grid &grid,
+                                                           const Point2V &ab) const;
+
+    void Prefetch(const Grid &grid, const Point2V &ab) const;
+
+    std::size_t GetMapSize() const;
+
+private:
+    typedef Vc::SimdArray<float, 4> Knot;
+
+    Knot LoadKnot(int m, int ind) const { return Knot(&fXYZ[m][ind * 4]); }
+
+    std::array<KnotVector<float>, M> fXYZ;  // the maps, arrays of {X,Y,Z,0} knots
+};
+
+template <int M> inline Group<M>::Group(const Grid &grid)  //{{{1
+{
+    for (auto &map : fXYZ) {
+        map.assign(grid.fN * std::size_t(4), 0.f);
+    }
+}
+
+template <int M>
+inline Group<M>::Group(const Grid &grid, MapReader &reader)  //{{{1
+{
+    for (auto &map : fXYZ) {
+        map = reader.Array<float>(grid.fN * std::size_t(4));
+    }
+}
+
+template <int M> inline void Group<M>::Write(MapWriter &writer) const  //{{{1
+{
+    for (const auto &map : fXYZ) {
+        writer.Write(map);
+    }
+}
+
+template <int M>
+inline void Group<M>::Fill(const Grid &, int ind, const float values[])  //{{{1
+{
+    for (int m = 0; m < M; ++m) {
+        std::copy(values + 3 * m, values + 3 * m + 3, &fXYZ[m][ind * 4]);
+    }
+}
+
+template <int M>
+inline void Group<M>::Fill(const Grid &grid, const index_v &iA, const index_v &iB,
+                           ValueV values)
+{
+    const index_v ind = (iA * grid.fNB + iB) * 4;
+    for (int k = 0; k < Components; ++k) {
+        values[k].scatter(&fXYZ[k / 3][k % 3], ind);
+    }
+}
+
+template <int M> inline std::size_t Group<M>::GetMapSize() const  //{{{1
+{
+    return M * sizeof(float) * fXYZ[0].size();
+}
+
+template <int M>
+inline void Group<M>::Prefetch(const Grid &grid, const Point2V &ab) const  //{{{1
+{
+    const auto pos = grid.Position(ab);
+    const index_v ind = (std::get<0>(pos) * grid.fNB + std::get<1>(pos)) * 4;
+    for (const auto &map : fXYZ) {
+        prefetchStencils(&map[0], ind, grid.fNB * 4, 16);
+    }
+}
+
+template <int M>
+inline auto Group<M>::GetValue(const Grid &grid, Point2 ab) const -> Value  //{{{1
+{
+    StencilPosition<float> da1, db1;
+    int iA, iB;
+    std::tie(iA, iB, da1, db1) = grid.Position(ab);
+    const StencilPosition<Knot> da = da1;
+    const StencilPosition<Knot> db = db1;
+
+    Value r;
+    for (int m = 0; m < M; ++m) {
+        int ind = iA * grid.fNB + iB;
+        Knot v[4];
+        for (int i = 0; i < 4; i++) {
+            v[i] = GetSpline3(LoadKnot(m, ind), LoadKnot(m, ind + 1),
+                              LoadKnot(m, ind + 2), LoadKnot(m, ind + 3), db);
+            ind += grid.fNB;
+        }
+        const Knot res = GetSpline3(v, da);
+        for (int c = 0; c < 3; ++c) {
+            r[3 * m + c] = res[c];
+        }
+    }
+    return r;
+}
+
+template <int M>
+inline auto Group<M>::GetValue(const Grid &grid, const Point2V &ab) const  //{{{1
+    -> ValueV
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    const index_v ind = (iA * grid.fNB + iB) * 4;
+    const int row = grid.fNB * 4;  // distance of the stencil rows in floats
+    ValueV r;
+    for (int k = 0; k < Components; ++k) {
+        const float *m = &fXYZ[k / 3][k % 3];
+        float_v v[4];
+        for (int i = 0; i < 4; i++) {
+            const index_v j = ind + i * row;
+            v[i] = GetSpline3(float_v(m, j), float_v(m, j + 4), float_v(m, j + 8),
+                              float_v(m, j + 12), db);
+        }
+        r[k] = GetSpline3(v, da);
+    }
+    return r;
+}
+
+template <int M>
+inline auto Group<M>::GetValueAndGradient(const Grid &grid, Point2 ab) const  //{{{1
+    -> std::tuple<Value, Value, Value>
+{
+    StencilPosition<float> da, db;
+    int iA, iB;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+    const int ind = iA * grid.fNB + iB;
+
+    Value value, dA, dB;
+    for (int m = 0; m < M; ++m) {
+        Knot v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = LoadKnot(m, ind + i * grid.fNB + j);
+            }
+        }
+        const std::array<Knot, 3> g = GetSpline3Gradient<Knot>(v, da, db);
+        for (int c = 0; c < 3; ++c) {
+            value[3 * m + c] = g[0][c];
+            dA[3 * m + c] = g[1][c];
+            dB[3 * m + c] = g[2][c];
+        }
+    }
+    return std::make_tuple(value, dA, dB);
+}
+
+template <int M>
+inline auto Group<M>::GetValueAndGradient(const Grid &grid, const Point2V &ab) const
+    -> std::tuple<ValueV, ValueV, ValueV>
+{
+    index_v iA, iB;
+    StencilPosition<float_v> da, db;
+    std::tie(iA, iB, da, db) = grid.Position(ab);
+
+    const index_v ind = (iA * grid.fNB + iB) * 4;
+    std::array<float_v, 3> g[Components];
+    for (int k = 0; k < Components; ++k) {
+        const float *m = &fXYZ[k / 3][k % 3];
+        float_v v[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                v[i][j] = float_v(m, ind + (i * grid.fNB + j) * 4);
+            }
+        }
+        g[k] = GetSpline3Gradient(v, da, db);
+    }
+    return makeGradient<ValueV>(g);
+}
+//}}}1
+
+#endif  // SPLINE9_H_
+
+// vim: foldmethod=marker
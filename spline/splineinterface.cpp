@@ -0,0 +1,130 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#include "splineinterface.h"
+#include <algorithm>
+#include <Vc/Vc>
+#include <Vc/cpuid.h>
+
+/* This file must be compiled for the oldest CPU the binary runs on: it decides which of
+ * the copies of splinetarget.cpp may be called. */
+
+typedef std::unique_ptr<SplineInterface> (*SplineFactory)(SplineLayout, float, float, int,
+                                                          float, float, int);
+
+#define SPLINE_DECLARE_TARGET(name)                                                      \
+    namespace Target_##name                                                              \
+    {                                                                                    \
+    std::unique_ptr<SplineInterface> makeSpline(SplineLayout, float, float, int, float,  \
+                                                float, int);                             \
+    }
+SPLINE_DECLARE_TARGET(AVX2)
+SPLINE_DECLARE_TARGET(AVX)
+SPLINE_DECLARE_TARGET(SSE4_1)
+SPLINE_DECLARE_TARGET(SSE2)
+SPLINE_DECLARE_TARGET(Scalar)
+#undef SPLINE_DECLARE_TARGET
+
+namespace
+{
+struct Target {
+    const char *name;
+    bool (*supported)();
+    SplineFactory make;
+};
+
+// widest first. Vc 1 has no AVX-512 float_v, such CPUs get the AVX2 kernels.
+const Target Targets[] = {
+    {"AVX2",
+     [] {
+         Vc::CpuId::init();
+         return Vc::isImplementationSupported(Vc::AVX2Impl) && Vc::CpuId::hasFma() &&
+                Vc::CpuId::hasBmi2();
+     },
+     &Target_AVX2::makeSpline},
+    {"AVX", [] { return Vc::isImplementationSupported(Vc::AVXImpl); },
+     &Target_AVX::makeSpline},
+    {"SSE4_1", [] { return Vc::isImplementationSupported(Vc::SSE41Impl); },
+     &Target_SSE4_1::makeSpline},
+    {"SSE2", [] { return Vc::isImplementationSupported(Vc::SSE2Impl); },
+     &Target_SSE2::makeSpline},
+    {"Scalar", [] { return true; }, &Target_Scalar::makeSpline}};
+
+const Target &bestTarget()
+{
+    static const Target &best =
+        *std::find_if(std::begin(Targets), std::end(Targets),
+                      [](const Target &t) { return t.supported(); });
+    return best;
+}
+}  // unnamed namespace
+
+const char *splineLayoutName(SplineLayout layout)  //{{{1
+{
+    switch (layout) {
+    case SplineLayout::AoS4:         return "AoS4";
+    case SplineLayout::SoA:          return "SoA";
+    case SplineLayout::AoS3:         return "AoS3";
+    case SplineLayout::Coefficients: return "Coeff.";
+    case SplineLayout::Morton:       return "Morton";
+    case SplineLayout::Int16:        return "Int16";
+    case SplineLayout::Half:         return "Half";
+    }
+    return "<unknown>";
+}
+
+std::vector<std::string> supportedSplineTargets()  //{{{1
+{
+    std::vector<std::string> names;
+    for (const auto &t : Targets) {
+        if (t.supported()) {
+            names.emplace_back(t.name);
+        }
+    }
+    return names;
+}
+
+std::unique_ptr<SplineInterface> makeSpline(SplineLayout layout, float minA,  //{{{1
+                                            float maxA, int nBinsA, float minB,
+                                            float maxB, int nBinsB)
+{
+    return bestTarget().make(layout, minA, maxA, nBinsA, minB, maxB, nBinsB);
+}
+
+std::unique_ptr<SplineInterface> makeSpline(const std::string &target,  //{{{1
+                                            SplineLayout layout, float minA, float maxA,
+                                            int nBinsA, float minB, float maxB, int nBinsB)
+{
+    for (const auto &t : Targets) {
+        if (target == t.name) {
+            if (!t.supported()) {
+                break;
+            }
+            return t.make(layout, minA, maxA, nBinsA, minB, maxB, nBinsB);
+        }
+    }
+    return nullptr;
+}
+//}}}1
+
+// vim: foldmethod=marker
@@ -0,0 +1,122 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef SPLINEINTERFACE_H_
+#define SPLINEINTERFACE_H_
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "threadpool.h"
+
+typedef std::array<float, 2> Point2;
+typedef std::array<float, 3> Point3;
+
+/** The storage layout of a map, i.e. the class that implements the interface */
+enum class SplineLayout {
+    AoS4,          // Spline<AoS4>
+    SoA,           // Spline<SoA>
+    AoS3,          // Spline<AoS3>
+    Coefficients,  // Spline<Coefficients>
+    Morton,        // Spline<Morton>
+    Int16,         // Spline<Quantized<Int16Knot>>
+    Half           // Spline<Quantized<HalfKnot>>
+};
+
+/* SplineInterface hides the vector width of the kernels: the map classes are compiled
+ * once per target ISA (splinetarget.cpp) and makeSpline picks the widest target the CPU
+ * supports. Point2V depends on the target, thus only the scalar and the bulk functions
+ * are part of the interface.
+ */
+class SplineInterface
+{
+public:
+    virtual ~SplineInterface() {}
+
+    /**  Filling of points */
+    template <typename F> void Fill(F &&func);
+    /**  Filling of points */
+    virtual void Fill(int ind, const float XYZ[]) = 0;
+
+    /**  Get A,B by the point index */
+    virtual std::pair<float, float> GetAB(int ind) const = 0;
+
+    /** Calculate interpolated value at the given point */
+    virtual Point3 GetValue(Point2) const = 0;
+    /** Same, together with the derivatives d/dA and d/dB */
+    virtual std::tuple<Point3, Point3, Point3> GetValueAndGradient(Point2) const = 0;
+
+    /** Calculate interpolated values for n points, AoS and SoA variants */
+    virtual void GetValues(const Point2 *ab, Point3 *xyz, std::size_t n) const = 0;
+    virtual void GetValues(const float *a, const float *b, float *x, float *y, float *z,
+                           std::size_t n) const = 0;
+    /** Same as above, with the points distributed over the workers of the pool */
+    virtual void GetValues(const Point2 *ab, Point3 *xyz, std::size_t n,
+                           ThreadPool &pool) const = 0;
+    virtual void GetValues(const float *a, const float *b, float *x, float *y, float *z,
+                           std::size_t n, ThreadPool &pool) const = 0;
+
+    /**  Get the bytes of the map, see Spline::GetMapSize */
+    virtual std::size_t GetMapSize() const = 0;
+
+    /**  Get N of point on the grid */
+    virtual int GetNPoints() const = 0;
+
+    /**  Get the name of the target ISA of the kernels */
+    virtual const char *GetTarget() const = 0;
+};
+
+template <typename F> inline void SplineInterface::Fill(F &&func)
+{
+    for (int i = 0; i < GetNPoints(); i++) {
+        float a, b;
+        std::tie(a, b) = GetAB(i);
+        std::array<float, 3> xyz = func(a, b);
+        Fill(i, xyz.data());
+    }
+}
+
+/** Short name of the layout, e.g. for tables and profiles */
+const char *splineLayoutName(SplineLayout layout);
+
+/** Names of the compiled targets that the CPU supports, widest first */
+std::vector<std::string> supportedSplineTargets();
+
+/** Create a map with the kernels of the widest target that the CPU supports, nullptr if
+ * the grid is beyond the index range of the layout (see Spline::FitsIndex) */
+std::unique_ptr<SplineInterface> makeSpline(SplineLayout layout, float minA, float maxA,
+                                            int nBinsA, float minB, float maxB, int nBinsB);
+
+/** Create a map with the kernels of the given target, nullptr if it is not supported or
+ * the grid is beyond the index range */
+std::unique_ptr<SplineInterface> makeSpline(const std::string &target, SplineLayout layout,
+                                            float minA, float maxA, int nBinsA, float minB,
+                                            float maxB, int nBinsB);
+
+#endif  // SPLINEINTERFACE_H_
+
+// vim: foldmethod=marker
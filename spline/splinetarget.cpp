@@ -0,0 +1,165 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+/* This file is compiled once per target ISA by vc_compile_for_all_implementations (see
+ * CMakeLists.txt). Every copy puts the map classes and the definitions of spline.cpp into
+ * a namespace named after the target, thus everything they include has to be included
+ * before, outside of the namespace. The inline code those headers emit is not namespaced;
+ * CMakeLists.txt localizes it in the object file so that no other target uses it.
+ */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <Vc/Vc>
+#include <Vc/simdize>
+#include <Vc/vector>
+#include "cacheline.h"
+#include "threadpool.h"
+#include "mapfile.h"
+#include "splineinterface.h"
+
+#if defined Vc_IMPL_AVX2
+#define SPLINE_TARGET Target_AVX2
+#define SPLINE_TARGET_NAME "AVX2"
+#elif defined Vc_IMPL_AVX
+#define SPLINE_TARGET Target_AVX
+#define SPLINE_TARGET_NAME "AVX"
+#elif defined Vc_IMPL_SSE4_1
+#define SPLINE_TARGET Target_SSE4_1
+#define SPLINE_TARGET_NAME "SSE4_1"
+#elif defined Vc_IMPL_SSE2
+#define SPLINE_TARGET Target_SSE2
+#define SPLINE_TARGET_NAME "SSE2"
+#elif defined Vc_IMPL_Scalar
+#define SPLINE_TARGET Target_Scalar
+#define SPLINE_TARGET_NAME "Scalar"
+#else
+#error "splinetarget.cpp must be compiled for one of the targets of splineinterface.cpp"
+#endif
+
+namespace SPLINE_TARGET
+{
+#include "spline.h"
+#include "spline2.h"
+#include "spline3.h"
+#include "spline4.h"
+#include "spline5.h"
+#include "spline6.h"
+#include "spline.cpp"
+
+namespace
+{
+template <typename Map> class Adapter final : public SplineInterface  //{{{1
+{
+public:
+    Adapter(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB)
+        : fMap(minA, maxA, nBinsA, minB, maxB, nBinsB)
+    {
+    }
+
+    void Fill(int ind, const float XYZ[]) override { fMap.Fill(ind, XYZ); }
+    std::pair<float, float> GetAB(int ind) const override { return fMap.GetAB(ind); }
+    Point3 GetValue(Point2 ab) const override { return fMap.GetValue(ab); }
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(Point2 ab) const override
+    {
+        return fMap.GetValueAndGradient(ab);
+    }
+    void GetValues(const Point2 *ab, Point3 *xyz, std::size_t n) const override
+    {
+        fMap.GetValues(ab, xyz, n);
+    }
+    void GetValues(const float *a, const float *b, float *x, float *y, float *z,
+                   std::size_t n) const override
+    {
+        fMap.GetValues(a, b, x, y, z, n);
+    }
+    void GetValues(const Point2 *ab, Point3 *xyz, std::size_t n,
+                   ThreadPool &pool) const override
+    {
+        fMap.GetValues(ab, xyz, n, pool);
+    }
+    void GetValues(const float *a, const float *b, float *x, float *y, float *z,
+                   std::size_t n, ThreadPool &pool) const override
+    {
+        fMap.GetValues(a, b, x, y, z, n, pool);
+    }
+    std::size_t GetMapSize() const override { return fMap.GetMapSize(); }
+    int GetNPoints() const override { return fMap.GetNPoints(); }
+    const char *GetTarget() const override { return SPLINE_TARGET_NAME; }
+
+private:
+    Map fMap;
+};
+
+/** nullptr if the grid is not Map::FitsIndex, see createSpline */
+template <typename Map>
+std::unique_ptr<SplineInterface> make(float minA, float maxA, int nBinsA, float minB,
+                                      float maxB, int nBinsB)
+{
+    if (!Map::FitsIndex(std::max(4, nBinsA), std::max(4, nBinsB))) {
+        return nullptr;
+    }
+    return std::unique_ptr<SplineInterface>(
+        new Adapter<Map>(minA, maxA, nBinsA, minB, maxB, nBinsB));
+}
+}  // unnamed namespace
+
+std::unique_ptr<SplineInterface> makeSpline(SplineLayout layout, float minA,  //{{{1
+                                            float maxA, int nBinsA, float minB,
+                                            float maxB, int nBinsB)
+{
+    switch (layout) {
+    case SplineLayout::AoS4:
+        return make<Spline<AoS4>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    case SplineLayout::SoA:
+        return make<Spline<SoA>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    case SplineLayout::AoS3:
+        return make<Spline<AoS3>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    case SplineLayout::Coefficients:
+        return make<Spline<Coefficients>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    case SplineLayout::Morton:
+        return make<Spline<Morton>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    case SplineLayout::Int16:
+        return make<Spline<Quantized<Int16Knot>>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    case SplineLayout::Half:
+        return make<Spline<Quantized<HalfKnot>>>(minA, maxA, nBinsA, minB, maxB, nBinsB);
+    }
+    return nullptr;
+}
+//}}}1
+}  // namespace SPLINE_TARGET
+
+// vim: foldmethod=marker
@@ -0,0 +1,331 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "cacheline.h"
+
+/** The CPUs the process may run on, in ascending order (0 to
+ * hardware_concurrency - 1 where the affinity is unknown) */
+inline std::vector<int> availableCpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency());
+             ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/** The NUMA node of the cpu, from its link /sys/devices/system/cpu/cpuN/nodeK (Linux),
+ * 0 where it is unknown */
+inline int cpuNode(int cpu)
+{
+    int node = 0;
+#ifdef __linux__
+    const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    if (DIR *dir = opendir(path.c_str())) {
+        while (const dirent *entry = readdir(dir)) {
+            if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+                std::isdigit(static_cast<unsigned char>(entry->d_name[4]))) {
+                node = std::atoi(entry->d_name + 4);
+                break;
+            }
+        }
+        closedir(dir);
+    }
+#endif
+    return node;
+}
+
+/* The pool runs one job at a time: concurrent callers of forEachWorker and forEachChunk
+ * wait for each other. It is not reentrant, the job must not call into the same pool
+ * (asserted). An exception of the job on a worker is rethrown to the caller once all
+ * workers are done, the first one if several threw.
+ */
+class ThreadPool
+{
+public:
+    /** Start a pool of nThreads workers. The calling thread is worker 0, thus nThreads - 1
+     * threads are spawned. */
+    explicit ThreadPool(unsigned nThreads = std::thread::hardware_concurrency());
+    /** Same with cpus.size() workers, worker i > 0 pinned to cpus[i] (on Linux). With
+     * pinCaller the calling thread, worker 0, is pinned to cpus[0] as long as the pool
+     * lives, else it keeps its affinity. */
+    explicit ThreadPool(const std::vector<int> &cpus, bool pinCaller = false);
+    ~ThreadPool();
+
+    /**  Get N of workers, including the calling thread */
+    unsigned size() const { return fNThreads; }
+
+    /**  Get the CPU of worker id, -1 if the worker is not pinned */
+    int cpu(unsigned id) const
+    {
+        return fCpus.empty() || (id == 0 && !fPinCaller) ? -1 : fCpus[id];
+    }
+
+    /** Call fun(id) on every worker concurrently, with the id of the worker, and return
+     * when all are done */
+    template <typename F> void forEachWorker(F &&fun)
+    {
+        assert(!inJob());
+        std::lock_guard<std::mutex> lock(fCallMutex);
+        run(std::forward<F>(fun));
+    }
+
+    /** Call fun(begin, end) for all chunks of [0, n) and return when all are done.
+     * Every worker starts on its own contiguous range of chunks. A worker that is done
+     * with its range steals the remaining chunks of the other workers. */
+    template <typename F> void forEachChunk(std::size_t n, std::size_t chunkSize, F &&fun);
+
+private:
+    /** copy constructor prohibited */
+    ThreadPool(const ThreadPool &);
+    /** assignment operator prohibited */
+    ThreadPool &operator=(const ThreadPool &);
+
+    typedef std::function<void(unsigned)> Job;
+
+    /** the job on all workers, the caller holds fCallMutex */
+    void run(const Job &job);
+    /** the job on worker id, keeps its exception in fError */
+    void call(const Job &job, unsigned id);
+    /** true on the workers and the caller of the current job */
+    bool inJob() const;
+    void workerLoop(unsigned id);
+    void startWorkers();
+    /** Pin the calling thread to the cpu, false if that is not supported */
+    static bool pin(int cpu);
+
+    struct alignas(CacheLineSize) Range {  // no false sharing between ranges
+        std::atomic<std::size_t> next;
+        std::size_t end;
+    };
+
+    const unsigned fNThreads;
+    const std::vector<int> fCpus;   // of the workers, empty if not pinned
+    const bool fPinCaller;          // worker 0 is pinned to fCpus[0]
+    CacheLineArray<Range> fRanges;  // one range of chunks per worker
+    std::vector<std::thread> fThreads;
+    std::mutex fCallMutex;  // held by the caller of the current job
+    std::atomic<std::thread::id> fCaller{std::thread::id()};
+    std::mutex fMutex;
+    std::condition_variable fWakeup;
+    std::condition_variable fDone;
+    const Job *fJob = nullptr;
+    unsigned fGeneration = 0;
+    unsigned fPending = 0;
+    std::exception_ptr fError;  // the first exception of the current job
+    bool fStop = false;
+#ifdef __linux__
+    cpu_set_t fCallerAffinity;  // restored by the destructor with fPinCaller
+#endif
+};
+
+inline ThreadPool::ThreadPool(unsigned nThreads)  //{{{1
+    : fNThreads(std::max(1u, nThreads)), fPinCaller(false), fRanges(fNThreads)
+{
+    startWorkers();
+}
+
+inline ThreadPool::ThreadPool(const std::vector<int> &cpus, bool pinCaller)  //{{{1
+    : fNThreads(std::max<std::size_t>(1, cpus.size()))
+    , fCpus(cpus)
+    , fPinCaller(pinCaller && !cpus.empty())
+    , fRanges(fNThreads)
+{
+#ifdef __linux__
+    sched_getaffinity(0, sizeof(fCallerAffinity), &fCallerAffinity);
+#endif
+    if (fPinCaller) {
+        pin(fCpus[0]);
+    }
+    startWorkers();
+}
+
+inline ThreadPool::~ThreadPool()  //{{{1
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStop = true;
+    }
+    fWakeup.notify_all();
+    for (auto &t : fThreads) {
+        t.join();
+    }
+#ifdef __linux__
+    if (fPinCaller) {
+        sched_setaffinity(0, sizeof(fCallerAffinity), &fCallerAffinity);
+    }
+#endif
+}
+
+inline void ThreadPool::startWorkers()  //{{{1
+{
+    fThreads.reserve(fNThreads - 1);
+    for (unsigned id = 1; id < fNThreads; ++id) {
+        fThreads.emplace_back([this, id] {
+            if (!fCpus.empty()) {
+                pin(fCpus[id]);
+            }
+            workerLoop(id);
+        });
+    }
+}
+
+inline bool ThreadPool::pin(int cpu)  //{{{1
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+inline void ThreadPool::workerLoop(unsigned id)  //{{{1
+{
+    unsigned generation = 0;
+    for (;;) {
+        const Job *job;
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fWakeup.wait(lock, [&] { return fStop || fGeneration != generation; });
+            if (fStop) {
+                return;
+            }
+            generation = fGeneration;
+            job = fJob;
+        }
+        call(*job, id);
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            --fPending;
+        }
+        fDone.notify_one();
+    }
+}
+
+inline void ThreadPool::call(const Job &job, unsigned id)  //{{{1
+{
+    try {
+        job(id);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if (!fError) {
+            fError = std::current_exception();
+        }
+    }
+}
+
+inline bool ThreadPool::inJob() const  //{{{1
+{
+    const std::thread::id self = std::this_thread::get_id();
+    return fCaller.load() == self ||
+           std::any_of(fThreads.begin(), fThreads.end(),
+                       [&](const std::thread &t) { return t.get_id() == self; });
+}
+
+inline void ThreadPool::run(const Job &job)  //{{{1
+{
+    fCaller = std::this_thread::get_id();
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fJob = &job;
+        fPending = fNThreads - 1;
+        fError = nullptr;
+        ++fGeneration;
+    }
+    fWakeup.notify_all();
+    call(job, 0);
+    std::unique_lock<std::mutex> lock(fMutex);
+    fDone.wait(lock, [&] { return fPending == 0; });
+    fCaller = std::thread::id();
+    if (fError) {
+        const std::exception_ptr error = fError;
+        fError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename F>  //{{{1
+inline void ThreadPool::forEachChunk(std::size_t n, std::size_t chunkSize, F &&fun)
+{
+    assert(!inJob());
+    std::lock_guard<std::mutex> lock(fCallMutex);
+    const std::size_t nChunks = (n + chunkSize - 1) / chunkSize;
+    for (unsigned w = 0; w < fNThreads; ++w) {
+        fRanges[w].next.store(w * nChunks / fNThreads, std::memory_order_relaxed);
+        fRanges[w].end = (w + 1) * nChunks / fNThreads;
+    }
+    run([&](unsigned id) {
+        // the own range first, then steal from the neighbors
+        for (unsigned k = 0; k < fNThreads; ++k) {
+            Range &r = fRanges[(id + k) % fNThreads];
+            for (std::size_t c = r.next.fetch_add(1, std::memory_order_relaxed); c < r.end;
+                 c = r.next.fetch_add(1, std::memory_order_relaxed)) {
+                fun(c * chunkSize, std::min(n, (c + 1) * chunkSize));
+            }
+        }
+    });
+}
+//}}}1
+
+#endif  // THREADPOOL_H_
+
+// vim: foldmethod=marker
@@ -0,0 +1,180 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#include "tunedspline.h"
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <Vc/Vc>
+#include <Vc/cpuid.h>
+#include "../tsc.h"
+
+namespace
+{
+constexpr int TuningPoints = 10000;
+constexpr int TuningRepetitions = 10;
+
+std::string cpuModel()  //{{{1
+{
+    Vc::CpuId::init();
+    std::ostringstream s;
+    s << (Vc::CpuId::isIntel() ? "Intel" : Vc::CpuId::isAmd() ? "AMD" : "Unknown") << '-'
+      << unsigned(Vc::CpuId::processorFamily()) << '-'
+      << unsigned(Vc::CpuId::processorModel());
+    return s.str();
+}
+
+/* one line per tuning: <cpu> <target> <nBinsA> <nBinsB> <candidates> <layout> */
+std::string profileKey(int nBinsA, int nBinsB, const std::vector<SplineLayout> &candidates)
+{
+    std::ostringstream s;
+    s << cpuModel() << ' ' << supportedSplineTargets().front() << ' ' << nBinsA << ' '
+      << nBinsB << ' ';
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        s << (i == 0 ? "" : ",") << splineLayoutName(candidates[i]);
+    }
+    return s.str();
+}
+
+bool readProfile(const std::string &profile, const std::string &key,  //{{{1
+                 const std::vector<SplineLayout> &candidates, SplineLayout &layout)
+{
+    if (profile.empty()) {
+        return false;
+    }
+    bool found = false;
+    std::ifstream in(profile);
+    for (std::string line; std::getline(in, line);) {
+        if (line.size() > key.size() && line.compare(0, key.size(), key) == 0 &&
+            line[key.size()] == ' ') {
+            const std::string name = line.substr(key.size() + 1);
+            for (const auto l : candidates) {
+                if (name == splineLayoutName(l)) {
+                    layout = l;  // the last entry wins
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void writeProfile(const std::string &profile, const std::string &key,  //{{{1
+                  SplineLayout layout)
+{
+    if (!profile.empty()) {
+        std::ofstream(profile, std::ios::app) << key << ' ' << splineLayoutName(layout)
+                                              << '\n';
+    }
+}
+
+double cyclesPerPoint(const SplineInterface &map, const std::vector<Point2> &points,  //{{{1
+                      std::vector<Point3> &results)
+{
+    TimeStampCounter tsc;
+    map.GetValues(points.data(), results.data(), points.size());  // cache warm-up
+    unsigned long long best = std::numeric_limits<unsigned long long>::max();
+    for (int rep = 0; rep < TuningRepetitions; ++rep) {
+        tsc.start();
+        map.GetValues(points.data(), results.data(), points.size());
+        tsc.stop();
+        best = std::min(best, tsc.cycles());
+    }
+    return double(best) / points.size();
+}
+
+SplineLayout tune(float minA, float maxA, int nBinsA, float minB, float maxB,  //{{{1
+                  int nBinsB, const std::vector<SplineLayout> &candidates)
+{
+    std::default_random_engine randomEngine(1);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    std::uniform_real_distribution<float> uniformA(minA, maxA <= minA ? minA + 1 : maxA);
+    std::uniform_real_distribution<float> uniformB(minB, maxB <= minB ? minB + 1 : maxB);
+    std::vector<Point2> points(TuningPoints);
+    for (auto &p : points) {
+        p = {{uniformA(randomEngine), uniformB(randomEngine)}};
+    }
+    std::vector<Point3> results(TuningPoints);
+
+    SplineLayout best = candidates.front();
+    double bestCycles = std::numeric_limits<double>::max();
+    for (const auto layout : candidates) {
+        const auto map = makeSpline(layout, minA, maxA, nBinsA, minB, maxB, nBinsB);
+        if (!map) {  // beyond the index range of the layout
+            continue;
+        }
+        for (int i = 0; i < map->GetNPoints(); ++i) {
+            const float xyz[3] = {uniform(randomEngine), uniform(randomEngine),
+                                  uniform(randomEngine)};
+            map->Fill(i, xyz);
+        }
+        const double cycles = cyclesPerPoint(*map, points, results);
+        if (cycles < bestCycles) {
+            bestCycles = cycles;
+            best = layout;
+        }
+    }
+    return best;
+}
+}  // unnamed namespace
+
+TunedSpline::TunedSpline(float minA, float maxA, int nBinsA, float minB,  //{{{1
+                         float maxB, int nBinsB,
+                         const std::vector<SplineLayout> &candidates,
+                         const std::string &profile)
+    : fLayout(SplineLayout::SoA)
+{
+    if (!candidates.empty()) {
+        const std::string key = profileKey(nBinsA, nBinsB, candidates);
+        if (!readProfile(profile, key, candidates, fLayout)) {
+            fLayout = tune(minA, maxA, nBinsA, minB, maxB, nBinsB, candidates);
+            writeProfile(profile, key, fLayout);
+        }
+    }
+    fMap = makeSpline(fLayout, minA, maxA, nBinsA, minB, maxB, nBinsB);
+    if (!fMap) {  // no candidate fits the grid
+        fLayout = SplineLayout::SoA;
+        fMap = makeSpline(fLayout, minA, maxA, nBinsA, minB, maxB, nBinsB);
+    }
+}
+
+std::vector<SplineLayout> TunedSpline::FloatLayouts()  //{{{1
+{
+    return {SplineLayout::AoS4, SplineLayout::SoA, SplineLayout::AoS3,
+            SplineLayout::Coefficients, SplineLayout::Morton};
+}
+
+std::string TunedSpline::DefaultProfile()  //{{{1
+{
+    if (const char *env = std::getenv("SPLINE_PROFILE")) {
+        return env;
+    } else if (const char *home = std::getenv("HOME")) {
+        return std::string(home) + "/.spline-profile";
+    }
+    return "spline-profile";
+}
+//}}}1
+
+// vim: foldmethod=marker
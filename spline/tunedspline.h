@@ -0,0 +1,93 @@
+/*{{{
+    Copyright © 2015 Matthias Kretz <kretz@kde.org>
+
+    Permission to use, copy, modify, and distribute this software
+    and its documentation for any purpose and without fee is hereby
+    granted, provided that the above copyright notice appear in all
+    copies and that both that the copyright notice and this
+    permission notice and warranty disclaimer appear in supporting
+    documentation, and that the name of the author not be used in
+    advertising or publicity pertaining to distribution of the
+    software without specific, written prior permission.
+
+    The author disclaim all warranties with regard to this
+    software, including all implied warranties of merchantability
+    and fitness.  In no event shall the author be liable for any
+    special, indirect or consequential damages or any damages
+    whatsoever resulting from loss of use, data or profits, whether
+    in an action of contract, negligence or other tortious action,
+    arising out of or in connection with the use or performance of
+    this software.
+
+}}}*/
+
+#ifndef TUNEDSPLINE_H_
+#define TUNEDSPLINE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "splineinterface.h"
+
+/* TunedSpline owns a map of the layout that is fastest on this CPU for the given grid
+ * dimensions. The first construction for a CPU model, target ISA and grid size measures
+ * the bulk GetValues of every candidate layout on random points (TimeStampCounter, one
+ * warm-up run and the best of TuningRepetitions runs, like the Runner in main.cpp) and
+ * appends the winner to the profile file. Later constructions read it from there. An
+ * empty profile path disables the cache. The candidates beyond the index range of the
+ * grid are skipped (see Spline::FitsIndex), SoA if none fits, which the grid has to.
+ */
+class TunedSpline final : public SplineInterface
+{
+public:
+    TunedSpline(float minA, float maxA, int nBinsA, float minB, float maxB, int nBinsB,
+                const std::vector<SplineLayout> &candidates = FloatLayouts(),
+                const std::string &profile = DefaultProfile());
+
+    /** The layouts with float knots, i.e. without the reduced precision of Quantized */
+    static std::vector<SplineLayout> FloatLayouts();
+    /** $SPLINE_PROFILE if set, otherwise ~/.spline-profile */
+    static std::string DefaultProfile();
+
+    /**  Get the layout that won */
+    SplineLayout GetLayout() const { return fLayout; }
+
+    using SplineInterface::Fill;
+    void Fill(int ind, const float XYZ[]) override { fMap->Fill(ind, XYZ); }
+    std::pair<float, float> GetAB(int ind) const override { return fMap->GetAB(ind); }
+    Point3 GetValue(Point2 ab) const override { return fMap->GetValue(ab); }
+    std::tuple<Point3, Point3, Point3> GetValueAndGradient(Point2 ab) const override
+    {
+        return fMap->GetValueAndGradient(ab);
+    }
+    void GetValues(const Point2 *ab, Point3 *xyz, std::size_t n) const override
+    {
+        fMap->GetValues(ab, xyz, n);
+    }
+    void GetValues(const float *a, const float *b, float *x, float *y, float *z,
+                   std::size_t n) const override
+    {
+        fMap->GetValues(a, b, x, y, z, n);
+    }
+    void GetValues(const Point2 *ab, Point3 *xyz, std::size_t n,
+                   ThreadPool &pool) const override
+    {
+        fMap->GetValues(ab, xyz, n, pool);
+    }
+    void GetValues(const float *a, const float *b, float *x, float *y, float *z,
+                   std::size_t n, ThreadPool &pool) const override
+    {
+        fMap->GetValues(a, b, x, y, z, n, pool);
+    }
+    std::size_t GetMapSize() const override { return fMap->GetMapSize(); }
+    int GetNPoints() const override { return fMap->GetNPoints(); }
+    const char *GetTarget() const override { return fMap->GetTarget(); }
+
+private:
+    SplineLayout fLayout;                  // the fastest of the candidates
+    std::unique_ptr<SplineInterface> fMap;  // map of that layout
+};
+
+#endif  // TUNEDSPLINE_H_
+
+// vim: foldmethod=marker